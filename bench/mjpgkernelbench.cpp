@@ -0,0 +1,168 @@
+/**
+    CS-11 Format
+    File: mjpgkernelbench.cpp
+    Purpose: Times the resize and encode kernels over an image corpus and writes the results as csv
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <dirent.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "mjpgencoder.h"
+#include "mjpgworkers.h"
+
+#ifndef MJPGBENCH_CORPUS
+#define MJPGBENCH_CORPUS "bench/corpus"
+#endif
+
+//!One named encoder under test
+struct KernelBackend
+{
+    std::string name;
+    std::shared_ptr<MjpgEncoder> encoder;
+};
+
+//!Every jpg, png or ppm of a directory sorted by name so runs line up
+static std::vector<std::string> corpus(const std::string &directory)
+{
+    std::vector<std::string> files;
+    DIR *listing = opendir(directory.c_str());
+    if(!listing) return files;
+    while(dirent *entry = readdir(listing))
+    {
+        std::string name = entry->d_name;
+        std::string::size_type dot = name.rfind('.');
+        if(dot == std::string::npos) continue;
+        std::string extension = name.substr(dot);
+        if(extension == ".jpg" || extension == ".png" || extension == ".ppm") files.push_back(directory + "/" + name);
+    }
+    closedir(listing);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+//! Run a kernel until enough time went by
+/*!
+One untimed call first so buffers and thread pools are warm
+@return nanoseconds per call
+*/
+template<typename Kernel>
+static double measure(Kernel kernel, double minimum, int &runs)
+{
+    kernel();
+    runs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while(runs < 3 || elapsed < minimum)
+    {
+        kernel();
+        runs++;
+        elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return elapsed * 1000000.0 / runs;
+}
+
+//Usage: mjpgkernelbench [corpus directory] [ms per case] [csv file]
+//Writes one csv row per case (to stdout without a file) so two runs can be diffed between commits.
+//Throughput (MB/s) is of the raw BGR pixels a kernel consumes
+int main(int argc, char **argv)
+{
+    std::string directory = argc > 1 ? argv[1] : MJPGBENCH_CORPUS;
+    double minimum = argc > 2 ? atof(argv[2]) : 200.0;
+    std::ofstream file;
+    if(argc > 3) file.open(argv[3]);
+    std::ostream &out = file.is_open() ? file : std::cout;
+
+    std::vector<std::string> images = corpus(directory);
+    if(images.empty())
+    {
+        std::cerr << "No images in " << directory << std::endl;
+        return 1;
+    }
+
+    const int sizes[4][2] = { {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160} };
+    const char *sizenames[4] = { "480p", "720p", "1080p", "4k" };
+    const int qualities[6] = { 10, 30, 50, 75, 90, 95 };
+    const int modes[3] = { cv::INTER_NEAREST, cv::INTER_LINEAR, cv::INTER_AREA };
+    const char *modenames[3] = { "nearest", "linear", "area" };
+
+    MjpgEncoderTuning tuning;
+    MjpgWorkers stripworkers; //Outlives the strip encoder below
+    std::vector<KernelBackend> backends;
+    KernelBackend opencv = { "opencv", std::make_shared<MjpgOpenCvEncoder>(tuning) };
+    backends.push_back(opencv);
+#ifdef MJPGSERVER_TURBOJPEG
+    KernelBackend turbo = { "turbo", std::make_shared<MjpgTurboEncoder>(tuning) };
+    backends.push_back(turbo);
+    MjpgEncoderTuning fast;
+    fast.fastdct = true;
+    KernelBackend turbofast = { "turbo-fastdct", std::make_shared<MjpgTurboEncoder>(fast) };
+    backends.push_back(turbofast);
+#endif
+    int cores = std::max(2, (int) boost::thread::hardware_concurrency());
+    KernelBackend strips = { "strips", std::make_shared<MjpgStripEncoder>(MjpgEncoder::create(tuning), cores, stripworkers) };
+    backends.push_back(strips);
+
+    out << "kernel,image,backend,mode,size,width,height,quality,runs,ns_per_frame,mb_per_s,bytes" << std::endl;
+    for(size_t i = 0; i < images.size(); i++)
+    {
+        cv::Mat source = cv::imread(images[i]);
+        if(source.empty())
+        {
+            std::cerr << "Skipping unreadable " << images[i] << std::endl;
+            continue;
+        }
+        std::string image = images[i].substr(images[i].rfind('/') + 1);
+        double sourcemb = source.total() * source.elemSize() / 1048576.0;
+        for(int s = 0; s < 4; s++)
+        {
+            cv::Size size(sizes[s][0], sizes[s][1]);
+            cv::Mat sized;
+            for(int m = 0; m < 3; m++)
+            {
+                int runs = 0;
+                double ns = measure([&]() { cv::resize(source, sized, size, 0, 0, modes[m]); }, minimum, runs);
+                out << "resize," << image << ",," << modenames[m] << "," << sizenames[s] << "," << size.width << "," << size.height << ",," << runs << ",";
+                out << (long long) ns << "," << sourcemb / (ns / 1e9) << "," << sized.total() * sized.elemSize() << std::endl;
+            }
+            cv::resize(source, sized, size, 0, 0, cv::INTER_LINEAR); //What the server encodes
+            double sizedmb = sized.total() * sized.elemSize() / 1048576.0;
+            for(size_t b = 0; b < backends.size(); b++)
+            {
+                for(int q = 0; q < 6; q++)
+                {
+                    std::vector<unsigned char> jpeg;
+                    int runs = 0;
+                    MjpgEncoder *encoder = backends[b].encoder.get();
+                    double ns = measure([&]() { encoder->encode(sized, qualities[q], jpeg); }, minimum, runs);
+                    out << "encode," << image << "," << backends[b].name << ",," << sizenames[s] << "," << size.width << "," << size.height << ",";
+                    out << qualities[q] << "," << runs << "," << (long long) ns << "," << sizedmb / (ns / 1e9) << "," << jpeg.size() << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,372 @@
+/**
+    CS-11 Format
+    File: mjpgloadgen.cpp
+    Purpose: Opens many streams plus snapshot and REST traffic and reports what the clients saw
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+#include "mjpgmetrics.h"
+
+namespace asio = boost::asio;
+using boost::asio::ip::tcp;
+
+//!Everything the clients measured, shared by all of them
+struct LoadTotals
+{
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> broken{0};
+    std::atomic<uint64_t> snapshots{0};
+    std::atomic<uint64_t> rests{0};
+    std::atomic<uint64_t> failed{0};
+    //!Time between two frames of one stream (ns)
+    MjpgHistogram gaps;
+    //!Receive time minus X-Capture-Ts, only meaningful on the same host (ns)
+    MjpgHistogram latency;
+    //!Whole /jpg and REST request times (ns)
+    MjpgHistogram requests;
+};
+
+static long long nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//!Value of a part header field or -1
+static long long field(const std::string &headers, size_t end, const char *name)
+{
+    size_t at = headers.find(name);
+    if(at == std::string::npos || at > end) return -1;
+    return atoll(headers.c_str() + at + strlen(name));
+}
+
+//! One /mjpg viewer counting the parts it gets
+class LoadStream : public std::enable_shared_from_this<LoadStream>
+{
+public:
+    LoadStream(asio::io_service &loop, LoadTotals &totals) : socket(loop), totals(totals) {}
+
+    void start(const tcp::endpoint &server, const std::string &path)
+    {
+        this->request = "GET " + path + " HTTP/1.1\r\nHost: loadgen\r\n\r\n";
+        this->socket.async_connect(server, boost::bind(&LoadStream::onConnect, shared_from_this(), asio::placeholders::error));
+    }
+
+    void stop()
+    {
+        boost::system::error_code ignored;
+        this->socket.close(ignored);
+    }
+
+    //!Frames per second over the time the stream was receiving
+    double fps() const
+    {
+        if(this->frames < 2) return 0.0;
+        return (this->frames - 1) * 1000000.0 / (double) (this->last - this->first);
+    }
+
+    unsigned long frames = 0;
+
+private:
+    void onConnect(const boost::system::error_code &error)
+    {
+        if(error) { this->totals.failed++; return; }
+        asio::async_write(this->socket, asio::buffer(this->request),
+                          boost::bind(&LoadStream::onWrite, shared_from_this(), asio::placeholders::error));
+    }
+
+    void onWrite(const boost::system::error_code &error)
+    {
+        if(error) { this->totals.failed++; return; }
+        this->read();
+    }
+
+    void read()
+    {
+        this->socket.async_read_some(asio::buffer(this->chunk),
+                                     boost::bind(&LoadStream::onRead, shared_from_this(),
+                                                 asio::placeholders::error, asio::placeholders::bytes_transferred));
+    }
+
+    void onRead(const boost::system::error_code &error, size_t length)
+    {
+        if(error) return;
+        this->buffer.append(this->chunk, length);
+        this->totals.bytes += length;
+        if(this->parse()) this->read();
+    }
+
+    bool parse()
+    {
+        while(true)
+        {
+            size_t end = this->buffer.find("\r\n\r\n");
+            if(end == std::string::npos) return true;
+            if(!this->opened)
+            {
+                if(this->buffer.compare(0, 12, "HTTP/1.1 200") != 0)
+                {
+                    this->totals.failed++;
+                    return false;
+                }
+                this->opened = true;
+                this->buffer.erase(0, end + 4);
+                continue;
+            }
+            long long length = field(this->buffer, end, "Content-Length:");
+            if(length < 0)
+            {
+                this->totals.broken++;
+                return false;
+            }
+            if(this->buffer.size() < end + 4 + (size_t) length) return true;
+            long long now = nowMicros();
+            long long captured = field(this->buffer, end, "X-Capture-Ts:");
+            if(captured > 0 && now > captured) this->totals.latency.record((uint64_t) (now - captured) * 1000);
+            if(this->frames > 0) this->totals.gaps.record((uint64_t) (now - this->last) * 1000);
+            else this->first = now;
+            this->last = now;
+            this->frames++;
+            this->totals.frames++;
+            this->buffer.erase(0, end + 4 + (size_t) length); //The part's closing newline is left to lead the next one
+        }
+    }
+
+    tcp::socket socket;
+    LoadTotals &totals;
+    std::string request;
+    std::string buffer;
+    char chunk[65536];
+    bool opened = false;
+    long long first = 0;
+    long long last = 0;
+};
+
+//! One short lived request (a snapshot or a REST read) that records its time
+class LoadRequest : public std::enable_shared_from_this<LoadRequest>
+{
+public:
+    LoadRequest(asio::io_service &loop, LoadTotals &totals, std::atomic<uint64_t> &done)
+        : socket(loop), totals(totals), done(done) {}
+
+    void start(const tcp::endpoint &server, const std::string &path)
+    {
+        this->started = std::chrono::steady_clock::now();
+        this->request = "GET " + path + " HTTP/1.1\r\nHost: loadgen\r\nConnection: close\r\n\r\n";
+        this->socket.async_connect(server, boost::bind(&LoadRequest::onConnect, shared_from_this(), asio::placeholders::error));
+    }
+
+private:
+    void onConnect(const boost::system::error_code &error)
+    {
+        if(error) { this->totals.failed++; return; }
+        asio::async_write(this->socket, asio::buffer(this->request),
+                          boost::bind(&LoadRequest::onWrite, shared_from_this(), asio::placeholders::error));
+    }
+
+    void onWrite(const boost::system::error_code &error)
+    {
+        if(error) { this->totals.failed++; return; }
+        asio::async_read(this->socket, this->response, asio::transfer_all(),
+                         boost::bind(&LoadRequest::onRead, shared_from_this(), asio::placeholders::error));
+    }
+
+    void onRead(const boost::system::error_code &error)
+    {
+        std::string status(asio::buffers_begin(this->response.data()),
+                           asio::buffers_begin(this->response.data()) + std::min<size_t>(12, this->response.size()));
+        if((error && error != asio::error::eof) || status != "HTTP/1.1 200")
+        {
+            this->totals.failed++;
+            return;
+        }
+        this->totals.bytes += this->response.size();
+        this->totals.requests.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->started).count());
+        this->done++;
+    }
+
+    tcp::socket socket;
+    LoadTotals &totals;
+    std::atomic<uint64_t> &done;
+    std::string request;
+    asio::streambuf response;
+    std::chrono::steady_clock::time_point started;
+};
+
+//! Fires a request at a fixed rate, cycling through a list of paths
+class LoadTicker
+{
+public:
+    LoadTicker(asio::io_service &loop, LoadTotals &totals, std::atomic<uint64_t> &done, const tcp::endpoint &server,
+               const std::vector<std::string> &paths, int rate)
+        : loop(loop), timer(loop), totals(totals), done(done), server(server), paths(paths),
+          period(std::chrono::microseconds(1000000 / (rate > 0 ? rate : 1))), rate(rate) {}
+
+    void start()
+    {
+        if(this->rate <= 0) return;
+        this->next = std::chrono::steady_clock::now();
+        this->arm();
+    }
+
+private:
+    void arm()
+    {
+        this->next += this->period; //Absolute ticks so a slow server can't lower the offered rate
+        this->timer.expires_at(this->next);
+        this->timer.async_wait(boost::bind(&LoadTicker::onTick, this, asio::placeholders::error));
+    }
+
+    void onTick(const boost::system::error_code &error)
+    {
+        if(error) return;
+        std::make_shared<LoadRequest>(this->loop, this->totals, this->done)->start(this->server, this->paths[this->sent++ % this->paths.size()]);
+        this->arm();
+    }
+
+    asio::io_service &loop;
+    asio::steady_timer timer;
+    LoadTotals &totals;
+    std::atomic<uint64_t> &done;
+    tcp::endpoint server;
+    std::vector<std::string> paths;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point next;
+    int rate;
+    unsigned long sent = 0;
+};
+
+//!User plus system cpu time of a process in ms or -1
+static double processCpu(int pid)
+{
+    if(pid <= 0) return -1.0;
+    std::stringstream path;
+    path << "/proc/" << pid << "/stat";
+    std::ifstream stat(path.str().c_str());
+    std::string line;
+    if(!std::getline(stat, line)) return -1.0;
+    size_t name = line.rfind(')'); //The command name may hold spaces
+    if(name == std::string::npos) return -1.0;
+    std::stringstream fields(line.substr(name + 2));
+    std::string skip;
+    for(int i = 3; i < 14; i++) fields >> skip; //utime and stime are fields 14 and 15
+    double user = 0, system = 0;
+    fields >> user >> system;
+    return (user + system) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static std::string ms(uint64_t nanoseconds)
+{
+    std::stringstream text;
+    text << std::fixed << std::setprecision(2) << nanoseconds / 1000000.0;
+    return text.str();
+}
+
+//Usage: mjpgloadgen [host] [port] [streams] [seconds] [jpg/s] [rest/s] [server pid] [stream path]
+//The server pid is optional and only used to read its cpu time from /proc
+int main(int argc, char **argv)
+{
+    std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    std::string port = argc > 2 ? argv[2] : "8080";
+    int streams = argc > 3 ? atoi(argv[3]) : 8;
+    int seconds = argc > 4 ? atoi(argv[4]) : 10;
+    int snapshots = argc > 5 ? atoi(argv[5]) : 2;
+    int rests = argc > 6 ? atoi(argv[6]) : 2;
+    int pid = argc > 7 ? atoi(argv[7]) : 0;
+    std::string path = argc > 8 ? argv[8] : "/mjpg";
+
+    asio::io_service loop;
+    tcp::resolver resolver(loop);
+    tcp::endpoint server = *resolver.resolve(tcp::resolver::query(host, port));
+    LoadTotals totals;
+
+    std::vector<std::shared_ptr<LoadStream> > viewers;
+    for(int i = 0; i < streams; i++)
+    {
+        viewers.push_back(std::make_shared<LoadStream>(loop, totals));
+        viewers.back()->start(server, path);
+    }
+    std::vector<std::string> jpg(1, "/jpg");
+    std::vector<std::string> rest;
+    rest.push_back("/fps");
+    rest.push_back("/clients");
+    rest.push_back("/pipeline");
+    rest.push_back("/metrics");
+    LoadTicker snapshotter(loop, totals, totals.snapshots, server, jpg, snapshots);
+    LoadTicker rester(loop, totals, totals.rests, server, rest, rests);
+    snapshotter.start();
+    rester.start();
+
+    //Handlers of one client never overlap since each only has one operation pending
+    int threads = boost::thread::hardware_concurrency() > 1 ? 2 : 1;
+    boost::thread_group pool;
+    for(int i = 0; i < threads; i++)
+        pool.create_thread([&loop]() { loop.run(); });
+
+    double cpustart = processCpu(pid);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    boost::this_thread::sleep_for(boost::chrono::seconds(seconds));
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpuend = processCpu(pid);
+    uint64_t frames = totals.frames;
+    uint64_t bytes = totals.bytes;
+    loop.stop();
+    pool.join_all();
+
+    std::cout << "streams " << streams << " seconds " << elapsed << std::endl;
+    std::cout << "frames " << frames << " (" << frames / elapsed << "/s)  bytes " << bytes;
+    std::cout << " (" << bytes / elapsed / 1048576.0 << " MB/s)  broken " << totals.broken << "  failed " << totals.failed << std::endl;
+    double low = 0, high = 0, sum = 0;
+    for(size_t i = 0; i < viewers.size(); i++)
+    {
+        double fps = viewers[i]->fps();
+        if(i == 0 || fps < low) low = fps;
+        if(i == 0 || fps > high) high = fps;
+        sum += fps;
+    }
+    std::cout << "client fps min " << low << " avg " << (viewers.empty() ? 0 : sum / viewers.size()) << " max " << high << std::endl;
+    std::cout << "gap ms p50 " << ms(totals.gaps.percentile(50)) << " p99 " << ms(totals.gaps.percentile(99));
+    std::cout << " p999 " << ms(totals.gaps.percentile(99.9)) << std::endl;
+    std::cout << "capture to receive ms p50 " << ms(totals.latency.percentile(50)) << " p99 " << ms(totals.latency.percentile(99));
+    std::cout << " p999 " << ms(totals.latency.percentile(99.9)) << std::endl;
+    std::cout << "requests jpg " << totals.snapshots << " rest " << totals.rests << " ms p50 " << ms(totals.requests.percentile(50));
+    std::cout << " p99 " << ms(totals.requests.percentile(99)) << std::endl;
+    if(cpustart >= 0 && cpuend >= 0)
+    {
+        double cpu = cpuend - cpustart;
+        std::cout << "server cpu " << cpu / elapsed / 10.0 << "% ";
+        std::cout << (frames ? cpu / frames : 0.0) << " ms/frame" << std::endl;
+    }
+    for(size_t i = 0; i < viewers.size(); i++)
+        std::cout << "client " << i << " frames " << viewers[i]->frames << " fps " << viewers[i]->fps() << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+    CS-11 Format
+    File: mjpgshmfeed.cpp
+    Purpose: Feeds generated frames into a shared memory ring like an out of process vision pipeline would
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "mjpgshm.h"
+#include "mjpgsynthetic.h"
+
+//Usage: mjpgshmfeed [ring] [width] [height] [complexity] [fps] [bgr|gray|nv12|jpeg] [seconds]
+//Serve it with server.setShmAttach(ring), seconds 0 feeds until killed
+int main(int argc, char **argv)
+{
+    std::string name = argc > 1 ? argv[1] : "mjpgfeed";
+    int width = argc > 2 ? atoi(argv[2]) : 1280;
+    int height = argc > 3 ? atoi(argv[3]) : 720;
+    int complexity = argc > 4 ? atoi(argv[4]) : 20;
+    int fps = argc > 5 ? atoi(argv[5]) : 30;
+    std::string format = argc > 6 ? argv[6] : "bgr";
+    int seconds = argc > 7 ? atoi(argv[7]) : 0;
+    MjpgSyntheticSource generated(width, height, complexity);
+    generated.setRate(fps);
+    MjpgShmProducer ring(name, (size_t) width * height * 3);
+    if(!ring.ready()) return 1;
+    std::cout << "pid " << getpid() << " ring " << name << " frame " << width << "x" << height << " " << format << std::endl;
+
+    cv::Mat frame(height, width, CV_8UC3);
+    cv::Mat gray;
+    std::vector<unsigned char> jpeg;
+    unsigned long published = 0;
+    unsigned long limit = seconds > 0 && fps > 0 ? (unsigned long) seconds * fps : 0;
+    while(limit == 0 || generated.frames() < limit)
+    {
+        if(!generated.next(frame)) break;
+        bool sent = false;
+        if(format == "gray" || format == "nv12")
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        if(format == "gray")
+            sent = ring.publish(gray);
+        else if(format == "nv12")
+        {
+            //Luma from the gray frame, neutral chroma
+            unsigned char *payload = ring.claim();
+            if(payload)
+            {
+                for(int y = 0; y < height; y++) std::memcpy(payload + (size_t) y * width, gray.ptr(y), width);
+                std::memset(payload + (size_t) width * height, 128, (size_t) width * height / 2);
+                sent = ring.commit(MJPGSHM_NV12, width, height, width, (size_t) width * height * 3 / 2);
+            }
+        }
+        else if(format == "jpeg")
+        {
+            cv::imencode(".jpg", frame, jpeg);
+            sent = ring.publish(jpeg);
+        }
+        else
+            sent = ring.publish(frame);
+        if(sent) published++;
+        if(generated.frames() % 100 == 0)
+            std::cout << "published " << published << " dropped " << ring.dropped() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/**
+    CS-11 Format
+    File: mjpgstripbench.cpp
+    Purpose: Measures how strip encoding latency scales with the number of cores
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "mjpgencoder.h"
+#include "mjpgworkers.h"
+
+//Usage: mjpgstripbench [image] [quality] [frames] [cores]
+//Without an image a noisy 4K test frame is generated
+int main(int argc, char **argv)
+{
+    cv::Mat frame;
+    if(argc > 1) frame = cv::imread(argv[1]);
+    if(frame.empty())
+    {
+        frame = cv::Mat(2160, 3840, CV_8UC3);
+        for(int y = 0; y < frame.rows; y++)
+        {
+            unsigned char *row = frame.ptr(y);
+            for(int x = 0; x < frame.cols * 3; x++) row[x] = (unsigned char) ((x * 7 + y * 13 + rand() % 40) & 0xFF);
+        }
+    }
+    int quality = argc > 2 ? atoi(argv[2]) : 80;
+    int frames = argc > 3 ? atoi(argv[3]) : 30;
+    int cores = argc > 4 ? atoi(argv[4]) : boost::thread::hardware_concurrency();
+    if(cores < 1) cores = 1;
+
+    MjpgEncoderTuning tuning;
+    std::cout << "frame " << frame.cols << "x" << frame.rows << " quality " << quality << " frames " << frames << std::endl;
+    std::cout << "cores\tms/frame\tspeedup\tbytes" << std::endl;
+    double single = 0;
+    for(int used = 1; used <= cores; used++)
+    {
+        MjpgWorkers workers; //The caller encodes a strip too
+        workers.setThreads(std::max(1, used - 1));
+        MjpgStripEncoder encoder(MjpgEncoder::create(tuning), used, workers);
+        std::vector<unsigned char> out;
+        encoder.encode(frame, quality, out); //Warm up the pool and the buffers
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int i = 0; i < frames; i++) encoder.encode(frame, quality, out);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        if(used == 1) single = ms;
+        std::cout << used << "\t" << ms << "\t" << single / ms << "\t" << out.size() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+    CS-11 Format
+    File: mjpgsynthetic.cpp
+    Purpose: Serves generated or replayed frames so the server can be measured without a camera
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include "mjpgserver.h"
+#include "mjpgsynthetic.h"
+
+//Usage: mjpgsynthetic [port] [width] [height] [complexity] [fps] [video] [event loops] [asio|uring]
+//Complexity is the percent of noisy blocks (0 - 100), fps -1 hands frames out as fast as they're pulled
+int main(int argc, char **argv)
+{
+    int port = argc > 1 ? atoi(argv[1]) : 8080;
+    int width = argc > 2 ? atoi(argv[2]) : 1280;
+    int height = argc > 3 ? atoi(argv[3]) : 720;
+    int complexity = argc > 4 ? atoi(argv[4]) : 20;
+    int fps = argc > 5 ? atoi(argv[5]) : 30;
+    MjpgServer synthetic(port);
+    MjpgSyntheticSource generated(width, height, complexity);
+    if(argc > 6 && std::string(argv[6]) != "-" && !generated.openVideo(argv[6]))
+        std::cerr << "Couldn't open " << argv[6] << ", generating frames instead" << std::endl;
+    if(argc > 7) synthetic.setEventLoops(atoi(argv[7]));
+    if(argc > 8) synthetic.setIoUring(std::string(argv[8]) == "uring");
+    generated.setRate(fps);
+    std::cout << "pid " << getpid() << " port " << port << " frame " << width << "x" << height;
+    std::cout << " complexity " << complexity << " fps " << fps << std::endl;
+    synthetic.attach([&synthetic, &generated]() -> cv::Mat
+    {
+        cv::Mat frame = synthetic.acquireFrame(generated.getHeight(), generated.getWidth(), CV_8UC3);
+        if(!generated.next(frame)) return cv::Mat();
+        return frame;
+    });
+    synthetic.run();
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+    CS-11 Format
+    File: mjpgchange.cpp
+    Purpose: Sampled, vectorized frame differencing to skip encoding static scenes
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "mjpgchange.h"
+#include <cstring>
+#include <cstdlib>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+MjpgChangeDetector::MjpgChangeDetector(int rowstep, int tile)
+    : rowstep(rowstep < 1 ? 1 : rowstep), tile(tile < 1 ? 1 : tile) {}
+
+void MjpgChangeDetector::reset()
+{
+    this->type = -1;
+}
+
+uint64_t MjpgChangeDetector::sad(const unsigned char *a, const unsigned char *b, size_t length)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i total = _mm_setzero_si128();
+    for(; i + 16 <= length; i += 16)
+    {
+        __m128i left = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i right = _mm_loadu_si128((const __m128i*) (b + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(left, right)); //Two 64 bit sums of 8 differences each
+    }
+    uint64_t halves[2];
+    _mm_storeu_si128((__m128i*) halves, total);
+    sum = halves[0] + halves[1];
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t total = vdupq_n_u32(0);
+    for(; i + 16 <= length; i += 16)
+    {
+        uint8x16_t difference = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        total = vpadalq_u16(total, vpaddlq_u8(difference)); //Widened before it can overflow
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, total);
+    sum = (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i < length; i++) sum += (uint64_t) std::abs((int) a[i] - (int) b[i]);
+    return sum;
+}
+
+bool MjpgChangeDetector::changed(const cv::Mat &frame, int threshold)
+{
+    size_t rowbytes = (size_t) frame.cols * frame.elemSize();
+    size_t tilebytes = (size_t) this->tile * frame.elemSize();
+    size_t tiles = (rowbytes + tilebytes - 1) / tilebytes;
+    int sampled = (frame.rows + this->rowstep - 1) / this->rowstep;
+    bool fresh = frame.rows != this->rows || frame.cols != this->cols || frame.type() != this->type;
+    bool moved = fresh;
+    if(!fresh)
+    {
+        int band = this->tile / this->rowstep;
+        if(band < 1) band = 1;
+        this->sums.assign(tiles, 0);
+        size_t samples = 0;
+        for(int s = 0; s < sampled && !moved; s++)
+        {
+            const unsigned char *row = frame.ptr(s * this->rowstep);
+            const unsigned char *old = &this->reference[(size_t) s * rowbytes];
+            for(size_t t = 0; t < tiles; t++)
+            {
+                size_t start = t * tilebytes;
+                size_t length = (start + tilebytes > rowbytes) ? rowbytes - start : tilebytes;
+                this->sums[t] += MjpgChangeDetector::sad(row + start, old + start, length);
+            }
+            samples++;
+            if(samples == (size_t) band || s == sampled - 1)
+            {
+                //A band of tiles is done, any one of them over the threshold is enough
+                for(size_t t = 0; t < tiles && !moved; t++)
+                {
+                    size_t length = (t + 1 == tiles) ? rowbytes - t * tilebytes : tilebytes;
+                    if(this->sums[t] > (uint64_t) threshold * length * samples) moved = true;
+                }
+                this->sums.assign(tiles, 0);
+                samples = 0;
+            }
+        }
+    }
+    if(moved)
+    {
+        this->reference.resize((size_t) sampled * rowbytes);
+        for(int s = 0; s < sampled; s++)
+            std::memcpy(&this->reference[(size_t) s * rowbytes], frame.ptr(s * this->rowstep), rowbytes);
+        this->rows = frame.rows;
+        this->cols = frame.cols;
+        this->type = frame.type();
+    }
+    return moved;
+}
@@ -0,0 +1,79 @@
+/**
+    CS-11 Format
+    File: mjpgchange.h
+    Purpose: Sampled, vectorized frame differencing to skip encoding static scenes
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MJPGCHANGE_H_
+#define MJPGCHANGE_H_
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+
+//! Tells whether a frame differs from the last one that counted as changed
+/*!
+Only every rowstep-th row is compared, split into tiles of tile by
+rowstep pixels. A frame counts as changed once any tile's mean absolute
+difference per sample exceeds the threshold, so something small moving
+in a corner isn't averaged away by a static rest. The reference is only
+replaced by changed frames which keeps slow drift from slipping through
+frame by frame. Rows are compared with SSE2 or NEON sums of absolute
+differences where available
+*/
+class MjpgChangeDetector
+{
+public:
+    //! Create a detector
+    /*!
+    @param rowstep compare every rowstep-th row
+    @param tile tile width and height in pixels
+    */
+    MjpgChangeDetector(int rowstep = 4, int tile = 32);
+
+    //! Compare a frame to the reference, making it the reference if it changed
+    /*!
+    A frame of another size or type than the reference always changed
+
+    @param frame the pulled frame
+    @param threshold mean absolute difference (0 - 255) a tile may have and still be unchanged
+    @return true when the frame has to be encoded
+    */
+    bool changed(const cv::Mat &, int);
+
+    //! Forget the reference so the next frame counts as changed
+    void reset(void);
+
+    //! Sum of absolute differences of two byte runs
+    static uint64_t sad(const unsigned char *, const unsigned char *, size_t);
+
+private:
+    const int rowstep;
+    const int tile;
+    //!The sampled rows of the reference, packed
+    std::vector<unsigned char> reference;
+    int rows = 0;
+    int cols = 0;
+    int type = -1;
+    //!Per tile sums of the band being compared
+    std::vector<uint64_t> sums;
+};
+
+#endif  // MJPGCHANGE_H_
@@ -0,0 +1,168 @@
+/**
+    CS-11 Format
+    File: mjpgchannel.cpp
+    Purpose: Sequence numbered publication of encoded frames to waiting clients
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgchannel.h"
+#include <algorithm>
+#include <new>
+
+namespace
+{
+
+//Wake ups are posted from the publishing thread where asio has no handler memory to recycle,
+//their memory comes back here once they ran on the client's loop
+class WakeBlocks
+{
+public:
+    static const size_t size = 128;
+
+    void *take(size_t bytes)
+    {
+        if(bytes > size) return ::operator new(bytes);
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            if(!this->blocks.empty())
+            {
+                void *block = this->blocks.back();
+                this->blocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(size); //Only while more wake ups are in flight than ever before
+    }
+
+    void give(void *block, size_t bytes)
+    {
+        if(bytes > size)
+        {
+            ::operator delete(block);
+            return;
+        }
+        boost::mutex::scoped_lock l(this->mutex);
+        this->blocks.push_back(block);
+    }
+
+private:
+    boost::mutex mutex;
+    std::vector<void *> blocks;
+};
+
+WakeBlocks &wakeBlocks()
+{
+    static WakeBlocks *blocks = new WakeBlocks(); //Never destroyed, loops may still run wake ups at exit
+    return *blocks;
+}
+
+template<typename T>
+struct WakeAllocator
+{
+    typedef T value_type;
+
+    WakeAllocator() {}
+    template<typename U> WakeAllocator(const WakeAllocator<U> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(wakeBlocks().take(n * sizeof(T))); }
+    void deallocate(T *block, size_t n) { wakeBlocks().give(block, n * sizeof(T)); }
+
+    template<typename U> bool operator==(const WakeAllocator<U> &) const { return true; }
+    template<typename U> bool operator!=(const WakeAllocator<U> &) const { return false; }
+};
+
+//Runs a parked client's handler on its loop, keeping the client alive until then
+struct Wake
+{
+    std::shared_ptr<void> alive;
+    MjpgChannel::handler callback;
+    MjpgFramePtr frame;
+
+    typedef WakeAllocator<Wake> allocator_type;
+    allocator_type get_allocator() const { return allocator_type(); }
+
+    void operator()() const { this->callback(this->frame); }
+};
+
+}
+
+void MjpgChannel::publish(std::shared_ptr<MjpgFrame> frame)
+{
+    boost::mutex::scoped_lock p(this->publishing);
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        frame->seq = ++this->seq;
+        frame->published = std::chrono::steady_clock::now();
+        this->current = frame;
+        this->woken.swap(this->waiters); //Everyone parked wanted exactly this frame
+    }
+    MjpgFramePtr published = frame;
+    for(size_t i = 0; i < this->woken.size(); i++)
+    {
+        std::shared_ptr<void> alive = this->woken[i].owner.lock();
+        if(!alive) continue; //Client left while waiting
+        Wake wake = { alive, this->woken[i].callback, published };
+        this->woken[i].loop->post(wake);
+    }
+    this->woken.clear(); //Keeps its capacity for the waiters of the next frame
+}
+
+MjpgFramePtr MjpgChannel::latest()
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    return this->current;
+}
+
+unsigned long MjpgChannel::sequence()
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    return this->seq;
+}
+
+void MjpgChannel::wait(std::weak_ptr<void> owner, boost::asio::io_service &loop, unsigned long seq, handler callback)
+{
+    MjpgFramePtr ready;
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        if(this->current && this->current->seq > seq)
+        {
+            ready = this->current;
+        }
+        else
+        {
+            if(this->waiters.size() >= this->prunemark) //Forget clients that hung up while parked
+            {
+                for(size_t i = 0; i < this->waiters.size();)
+                {
+                    if(this->waiters[i].owner.expired())
+                    {
+                        this->waiters[i] = this->waiters.back();
+                        this->waiters.pop_back();
+                    }
+                    else i++;
+                }
+                this->prunemark = std::max<size_t>(64, this->waiters.size() * 2);
+            }
+            waiter parked = { owner, &loop, callback };
+            this->waiters.push_back(parked);
+            return;
+        }
+    }
+    std::shared_ptr<void> alive = owner.lock();
+    if(!alive) return;
+    Wake wake = { alive, callback, ready };
+    loop.post(wake);
+}
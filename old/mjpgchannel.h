@@ -0,0 +1,102 @@
+/**
+    CS-11 Format
+    File: mjpgchannel.h
+    Purpose: Sequence numbered publication of encoded frames to waiting clients
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGCHANNEL_H_
+#define MJPGCHANNEL_H_
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/mutex.hpp>
+#include "mjpgframe.h"
+
+//! Publishes encoded frames to every client exactly when they exist
+/*!
+Each published frame is stamped with the next sequence number. A client
+that has sent frame N asks for anything newer than N, if a newer frame is
+already out it gets it right away otherwise it is parked until the next
+publish. Handlers are always posted to the event loop that owns the
+client so they never run on the publishing thread. The posted wake ups
+reuse memory of earlier ones and a handler small enough for
+std::function to hold in place (a lambda capturing only the client)
+isn't allocated either, so publishing to a steady set of clients doesn't
+allocate.
+*/
+class MjpgChannel
+{
+public:
+    //!Called on the client's loop with the newest frame
+    typedef std::function<void(MjpgFramePtr)> handler;
+
+    //! Stamp (sequence and time) and publish a freshly encoded frame
+    /*!
+    Wakes every parked client. The frame must not be touched after this
+
+    @param frame the sealed frame to hand out
+    */
+    void publish(std::shared_ptr<MjpgFrame>);
+
+    //! Get the most recently published frame
+    /*!
+    @return the newest frame or an empty pointer if nothing was published yet
+    */
+    MjpgFramePtr latest(void);
+
+    //! Get the sequence of the most recently published frame
+    /*!
+    @return the sequence or 0 if nothing was published yet
+    */
+    unsigned long sequence(void);
+
+    //! Wait for a frame newer than the one already sent
+    /*!
+    The channel only holds a weak reference to the owner while it is parked
+    so a client that hangs up doesn't pile up while the source is stalled.
+    If the owner is still alive it is kept alive until the handler has run
+
+    @param owner the client that is waiting
+    @param loop the event loop the handler must run on
+    @param seq the sequence number of the last frame the client got (0 for none)
+    @param callback runs with the first frame whose sequence is greater than seq
+    */
+    void wait(std::weak_ptr<void>, boost::asio::io_service &, unsigned long, handler);
+
+private:
+    struct waiter
+    {
+        std::weak_ptr<void> owner;
+        boost::asio::io_service *loop;
+        handler callback;
+    };
+
+    boost::mutex mutex;
+    MjpgFramePtr current;
+    unsigned long seq = 0;
+    std::vector<waiter> waiters;
+    //!Waiters being woken, kept around so publishing doesn't allocate
+    std::vector<waiter> woken;
+    boost::mutex publishing;
+    size_t prunemark = 64;
+};
+
+#endif  // MJPGCHANNEL_H_
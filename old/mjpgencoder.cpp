@@ -0,0 +1,343 @@
+/**
+    CS-11 Format
+    File: mjpgencoder.cpp
+    Purpose: Jpeg encoder backends used to turn pulled mats into stream frames
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgencoder.h"
+#include "mjpgworkers.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <exception>
+
+#ifdef MJPGSERVER_TURBOJPEG
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+
+#ifndef JCS_EXTENSIONS
+#error "MJPGSERVER_TURBOJPEG needs the libjpeg-turbo jpeglib.h (BGR input extensions)"
+#endif
+#endif
+
+MjpgEncoderPtr MjpgEncoder::create(const MjpgEncoderTuning &tuning)
+{
+#ifdef MJPGSERVER_TURBOJPEG
+    return std::make_shared<MjpgTurboEncoder>(tuning);
+#else
+    return std::make_shared<MjpgOpenCvEncoder>(tuning);
+#endif
+}
+
+void MjpgOpenCvEncoder::encode(const cv::Mat &image, int quality, std::vector<unsigned char> &out)
+{
+    thread_local std::vector<int> compression_params; //Built once per thread instead of every frame
+    compression_params.clear();
+    if(quality > -1) //If specified quality then do so
+    {
+        compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
+        compression_params.push_back(quality);
+    }
+    if(this->tuning.optimize)
+    {
+        compression_params.push_back(cv::IMWRITE_JPEG_OPTIMIZE);
+        compression_params.push_back(1);
+    }
+    cv::imencode(".jpg", image, out, compression_params);
+}
+
+namespace
+{
+    //!Height of the largest jpeg MCU (2x2 chroma subsampling)
+    const int mcuheight = 16;
+
+    //!Where the pieces of an encoded strip start
+    struct stripbounds
+    {
+        size_t sof = 0;
+        size_t sos = 0;
+        size_t data = 0;
+        size_t end = 0;
+        //!MCU size from the largest sampling factors
+        int mcuwidth = 8;
+        int mcuheight = 8;
+    };
+
+    //! Find the frame header, scan header and entropy data of a jpeg
+    bool findbounds(const std::vector<unsigned char> &jpeg, stripbounds &bounds)
+    {
+        size_t at = 2; //Skip SOI
+        while(at + 4 <= jpeg.size())
+        {
+            if(jpeg[at] != 0xFF) return false;
+            unsigned char marker = jpeg[at + 1];
+            size_t length = (jpeg[at + 2] << 8) | jpeg[at + 3];
+            if(marker == 0xC0 || marker == 0xC1)
+            {
+                bounds.sof = at;
+                for(size_t c = 0; c < jpeg[at + 9] && at + 12 + c * 3 < jpeg.size(); c++)
+                {
+                    unsigned char sampling = jpeg[at + 11 + c * 3];
+                    bounds.mcuwidth = std::max(bounds.mcuwidth, (sampling >> 4) * 8);
+                    bounds.mcuheight = std::max(bounds.mcuheight, (sampling & 0x0F) * 8);
+                }
+            }
+            if(marker == 0xDA)
+            {
+                bounds.sos = at;
+                bounds.data = at + 2 + length;
+                bounds.end = jpeg.size() - 2; //Everything up to EOI
+                if(jpeg[bounds.end] != 0xFF || jpeg[bounds.end + 1] != 0xD9) return false;
+                return bounds.sof > 0 && bounds.data <= bounds.end;
+            }
+            at += 2 + length;
+        }
+        return false;
+    }
+
+    //!One frame being encoded in strips, shared with the tasks encoding them
+    struct stripframe
+    {
+        MjpgEncoder *encoder = nullptr;
+        const cv::Mat *image = nullptr;
+        int quality = -1;
+        //!MCU rows per strip
+        int perstrip = 0;
+        std::vector<std::vector<unsigned char> > *parts = nullptr;
+        //!Strips not encoded yet, guarded by latch
+        int pending = 0;
+        std::exception_ptr failed;
+        boost::mutex latch;
+        //!Signalled when pending drops to 0
+        boost::condition_variable finished;
+    };
+}
+
+MjpgStripEncoder::MjpgStripEncoder(std::shared_ptr<MjpgEncoder> inner, int strips, MjpgWorkers &workers)
+    : inner(inner), strips(strips), workers(workers) {}
+
+void MjpgStripEncoder::encode(const cv::Mat &image, int quality, std::vector<unsigned char> &out)
+{
+    this->encode(image, quality, this->strips, out);
+}
+
+void MjpgStripEncoder::encodeStrip(void *owner, void *, size_t index)
+{
+    stripframe *frame = static_cast<stripframe *>(owner);
+    try
+    {
+        int top = (int) index * frame->perstrip * mcuheight;
+        int bottom = std::min(frame->image->rows, top + frame->perstrip * mcuheight);
+        frame->encoder->encode(frame->image->rowRange(top, bottom), frame->quality, (*frame->parts)[index]);
+    }
+    catch(...)
+    {
+        boost::mutex::scoped_lock l(frame->latch);
+        if(!frame->failed) frame->failed = std::current_exception();
+    }
+    boost::mutex::scoped_lock l(frame->latch);
+    if(--frame->pending == 0) frame->finished.notify_one(); //Still under the latch, the frame lives on the caller's stack
+}
+
+void MjpgStripEncoder::encode(const cv::Mat &image, int quality, int strips, std::vector<unsigned char> &out)
+{
+    int mcurows = (image.rows + mcuheight - 1) / mcuheight;
+    int blockcols = (image.cols + 7) / 8;
+    if(strips > mcurows) strips = mcurows;
+    int perstrip = strips > 1 ? (mcurows + strips - 1) / strips : mcurows;
+    if(perstrip * (mcuheight / 8) * blockcols > 0xFFFF) perstrip = 0xFFFF / ((mcuheight / 8) * blockcols); //The restart interval is only 16 bits
+    if(strips < 2 || perstrip < 1)
+    {
+        this->inner->encode(image, quality, out);
+        return;
+    }
+    strips = (mcurows + perstrip - 1) / perstrip;
+
+    thread_local std::vector<std::vector<unsigned char> > parts; //Reused so strips don't allocate
+    if((int) parts.size() < strips) parts.resize(strips);
+    stripframe frame;
+    frame.encoder = this->inner.get();
+    frame.image = &image;
+    frame.quality = quality;
+    frame.perstrip = perstrip;
+    frame.parts = &parts;
+    frame.pending = strips;
+    for(int i = 1; i < strips; i++) this->workers.post(&MjpgStripEncoder::encodeStrip, &frame, nullptr, i);
+    MjpgStripEncoder::encodeStrip(&frame, nullptr, 0);
+    //Strips nobody picked up yet are encoded here, a pool thread waiting like this one can't stall them
+    while(this->workers.help(&frame)) {}
+    {
+        boost::mutex::scoped_lock l(frame.latch);
+        while(frame.pending > 0) frame.finished.wait(l); //The strips point into parts so wait for all
+    }
+    if(frame.failed) std::rethrow_exception(frame.failed);
+
+    std::vector<stripbounds> bounds(strips);
+    size_t total = 0;
+    for(int i = 0; i < strips; i++)
+    {
+        if(!findbounds(parts[i], bounds[i])) throw std::runtime_error("strip encoder got an unexpected jpeg layout");
+        total += bounds[i].end - bounds[i].data + 2;
+    }
+
+    //First strip's headers with the full height, then every strip's entropy data split by restart markers
+    const std::vector<unsigned char> &first = parts[0];
+    unsigned interval = (perstrip * mcuheight / bounds[0].mcuheight) * ((image.cols + bounds[0].mcuwidth - 1) / bounds[0].mcuwidth);
+    const unsigned char dri[6] = {0xFF, 0xDD, 0x00, 0x04, (unsigned char) (interval >> 8), (unsigned char) (interval & 0xFF)};
+    out.clear();
+    out.reserve(bounds[0].data + sizeof(dri) + total);
+    out.insert(out.end(), first.begin(), first.begin() + bounds[0].sos);
+    out[bounds[0].sof + 5] = (unsigned char) (image.rows >> 8);
+    out[bounds[0].sof + 6] = (unsigned char) (image.rows & 0xFF);
+    out.insert(out.end(), dri, dri + sizeof(dri));
+    out.insert(out.end(), first.begin() + bounds[0].sos, first.begin() + bounds[0].end);
+    for(int i = 1; i < strips; i++)
+    {
+        out.push_back(0xFF);
+        out.push_back((unsigned char) (0xD0 + ((i - 1) & 7)));
+        out.insert(out.end(), parts[i].begin() + bounds[i].data, parts[i].begin() + bounds[i].end);
+    }
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+}
+
+#ifdef MJPGSERVER_TURBOJPEG
+namespace
+{
+    //!Bytes written aside once the caller's vector is full
+    static const size_t turbospill = 65536;
+
+    //!One compressor per encode thread, reused for every frame it encodes
+    struct turbostate
+    {
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr jerr;
+        jpeg_destination_mgr dest;
+        std::jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+        std::vector<unsigned char> *out = nullptr;
+        size_t lastsize = 0;
+        //!Left uninitialized, growing the vector instead would zero fill what's about to be overwritten
+        std::unique_ptr<unsigned char[]> spill;
+        //!Whether the vector's bytes are used up and output goes to spill
+        bool spilling = false;
+
+        turbostate() : spill(new unsigned char[turbospill])
+        {
+            this->cinfo.err = jpeg_std_error(&this->jerr);
+            this->jerr.error_exit = &turbostate::fail;
+            jpeg_create_compress(&this->cinfo);
+            this->cinfo.client_data = this;
+            this->dest.init_destination = &turbostate::start;
+            this->dest.empty_output_buffer = &turbostate::grow;
+            this->dest.term_destination = &turbostate::finish;
+            this->cinfo.dest = &this->dest;
+        }
+
+        ~turbostate()
+        {
+            jpeg_destroy_compress(&this->cinfo);
+        }
+
+        static void fail(j_common_ptr cinfo)
+        {
+            turbostate *state = static_cast<turbostate*>(cinfo->client_data);
+            (*cinfo->err->format_message)(cinfo, state->message);
+            std::longjmp(state->jump, 1);
+        }
+
+        static void start(j_compress_ptr cinfo)
+        {
+            turbostate *state = static_cast<turbostate*>(cinfo->client_data);
+            //Room for a bit more than the last frame so appending the spill never reallocates in the common case
+            size_t guess = state->lastsize + state->lastsize / 4;
+            if(guess < turbospill) guess = turbospill;
+            state->out->reserve(guess);
+            //A recycled vector's bytes are overwritten in place, only what doesn't fit goes through the spill
+            state->spilling = state->out->empty();
+            state->dest.next_output_byte = state->spilling ? state->spill.get() : state->out->data();
+            state->dest.free_in_buffer = state->spilling ? turbospill : state->out->size();
+        }
+
+        static boolean grow(j_compress_ptr cinfo)
+        {
+            turbostate *state = static_cast<turbostate*>(cinfo->client_data);
+            if(state->spilling) state->out->insert(state->out->end(), state->spill.get(), state->spill.get() + turbospill);
+            state->spilling = true;
+            state->dest.next_output_byte = state->spill.get();
+            state->dest.free_in_buffer = turbospill;
+            return TRUE;
+        }
+
+        static void finish(j_compress_ptr cinfo)
+        {
+            turbostate *state = static_cast<turbostate*>(cinfo->client_data);
+            if(state->spilling)
+                state->out->insert(state->out->end(), state->spill.get(), state->spill.get() + (turbospill - state->dest.free_in_buffer));
+            else
+                state->out->resize(state->out->size() - state->dest.free_in_buffer); //Shrinking never fills
+            state->lastsize = state->out->size();
+        }
+    };
+}
+
+void MjpgTurboEncoder::encode(const cv::Mat &image, int quality, std::vector<unsigned char> &out)
+{
+    thread_local turbostate state;
+    jpeg_compress_struct &cinfo = state.cinfo;
+    JSAMPROW rows[16];
+
+    if(image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3 && image.channels() != 4))
+        throw std::invalid_argument("jpeg encoder needs an 8 bit gray, BGR or BGRA mat");
+
+    state.out = &out;
+    if(setjmp(state.jump))
+    {
+        jpeg_abort_compress(&cinfo); //Leaves the compressor ready for the next frame
+        throw std::runtime_error(state.message);
+    }
+
+    cinfo.image_width = image.cols;
+    cinfo.image_height = image.rows;
+    cinfo.input_components = image.channels();
+    cinfo.in_color_space = image.channels() == 1 ? JCS_GRAYSCALE : (image.channels() == 3 ? JCS_EXT_BGR : JCS_EXT_BGRA);
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality > -1 ? quality : 95, TRUE); //95 is what imencode defaults to
+    cinfo.dct_method = this->tuning.fastdct ? JDCT_IFAST : JDCT_ISLOW;
+    cinfo.optimize_coding = this->tuning.optimize ? TRUE : FALSE;
+    if(image.channels() > 1)
+    {
+        cinfo.comp_info[0].h_samp_factor = this->tuning.subsampling == 444 ? 1 : 2;
+        cinfo.comp_info[0].v_samp_factor = this->tuning.subsampling == 420 ? 2 : 1;
+    }
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while(cinfo.next_scanline < cinfo.image_height)
+    {
+        JDIMENSION batch = 0;
+        while(batch < 16 && cinfo.next_scanline + batch < cinfo.image_height)
+        {
+            rows[batch] = const_cast<JSAMPROW>(image.ptr(cinfo.next_scanline + batch));
+            batch++;
+        }
+        jpeg_write_scanlines(&cinfo, rows, batch);
+    }
+    jpeg_finish_compress(&cinfo);
+}
+#endif
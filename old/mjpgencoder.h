@@ -0,0 +1,157 @@
+/**
+    CS-11 Format
+    File: mjpgencoder.h
+    Purpose: Jpeg encoder backends used to turn pulled mats into stream frames
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGENCODER_H_
+#define MJPGENCODER_H_
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <opencv2/core/core.hpp>
+
+class MjpgWorkers;
+
+//! Knobs that trade jpeg size and quality against encode time
+struct MjpgEncoderTuning
+{
+    //!Chroma subsampling as 444, 422 or 420
+    int subsampling = 420;
+
+    //!Use the faster but less accurate integer DCT
+    bool fastdct = false;
+
+    //!Compute optimal huffman tables (smaller frames, slower encode)
+    bool optimize = false;
+};
+
+//! Turns a BGR (or gray) mat into jpeg bytes
+/*!
+Encoders are shared by every encode thread so implementations keep any
+per call state thread local. The output vector is reused as is, so a
+caller that hands in the same vector again doesn't allocate
+*/
+class MjpgEncoder
+{
+public:
+    virtual ~MjpgEncoder() {}
+
+    //! Encode a frame
+    /*!
+    @param image BGR, BGRA or gray 8 bit mat
+    @param quality jpeg quality between 0 - 100 or -1 for the default
+    @param out replaced with the encoded jpeg
+    */
+    virtual void encode(const cv::Mat &, int, std::vector<unsigned char> &) = 0;
+
+    //! Create the encoder the library was built with
+    /*!
+    That is libjpeg-turbo when built with MJPGSERVER_TURBOJPEG and
+    cv::imencode otherwise
+
+    @param tuning the encoder knobs to use
+    @return a new encoder
+    */
+    static std::shared_ptr<MjpgEncoder> create(const MjpgEncoderTuning &);
+};
+
+//! Encodes through cv::imencode
+/*!
+Only the optimize knob is honoured since that is all imencode exposes
+*/
+class MjpgOpenCvEncoder : public MjpgEncoder
+{
+public:
+    MjpgOpenCvEncoder(const MjpgEncoderTuning &tuning) : tuning(tuning) {}
+    void encode(const cv::Mat &, int, std::vector<unsigned char> &);
+private:
+    const MjpgEncoderTuning tuning;
+};
+
+#ifdef MJPGSERVER_TURBOJPEG
+//! Encodes straight through libjpeg-turbo
+/*!
+Every encode thread keeps its own compressor alive between frames and
+the jpeg is written directly over the bytes the caller's (recycled)
+vector already holds, whatever doesn't fit is appended from a per thread
+spill buffer. The vector's capacity is reserved from the size of the
+last frame and its bytes are never zero filled first, so a steady stream
+of frames doesn't allocate or clear memory inside the encoder at all
+*/
+class MjpgTurboEncoder : public MjpgEncoder
+{
+public:
+    MjpgTurboEncoder(const MjpgEncoderTuning &tuning) : tuning(tuning) {}
+    void encode(const cv::Mat &, int, std::vector<unsigned char> &);
+private:
+    const MjpgEncoderTuning tuning;
+};
+#endif
+
+//! Encodes horizontal strips of a frame in parallel
+/*!
+The frame is cut into strips of whole 16 pixel MCU rows and every strip
+is encoded by the wrapped encoder on the shared encode threads, the
+caller encodes the first one and any still queued when it's done. The strips are
+then stitched into a single baseline jpeg: the header of the first strip
+with its height patched, a restart interval of one strip and an RSTn
+marker between consecutive strips. Restart markers reset the DC
+predictors so a decoder sees exactly what one big encode would produce.
+The wrapped encoder must use the standard huffman tables so leave
+optimize off for it
+*/
+class MjpgStripEncoder : public MjpgEncoder
+{
+public:
+    //! Wrap an encoder
+    /*!
+    @param inner encoder used for every strip
+    @param strips strips per frame used by the plain encode
+    @param workers threads the strips are encoded on, must outlive the encoder
+    */
+    MjpgStripEncoder(std::shared_ptr<MjpgEncoder>, int, MjpgWorkers &);
+
+    void encode(const cv::Mat &, int, std::vector<unsigned char> &);
+
+    //! Encode a frame in a given amount of strips
+    /*!
+    Falls back to a single plain encode when the frame is too small to
+    split or strips is below 2
+
+    @param image BGR, BGRA or gray 8 bit mat
+    @param quality jpeg quality between 0 - 100 or -1 for the default
+    @param strips how many strips to encode in parallel
+    @param out replaced with the encoded jpeg
+    */
+    void encode(const cv::Mat &, int, int, std::vector<unsigned char> &);
+
+private:
+    //!Encodes one strip of the frame passed as owner on an encode thread
+    static void encodeStrip(void *, void *, size_t);
+
+    const std::shared_ptr<MjpgEncoder> inner;
+    const int strips;
+    MjpgWorkers &workers;
+};
+
+//!Shared handle to the encoder in use
+typedef std::shared_ptr<MjpgEncoder> MjpgEncoderPtr;
+
+#endif  // MJPGENCODER_H_
@@ -0,0 +1,148 @@
+/**
+    CS-11 Format
+    File: mjpgframe.h
+    Purpose: Immutable encoded frame shared between the pull loop and every client
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGFRAME_H_
+#define MJPGFRAME_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <boost/array.hpp>
+#include <boost/asio/buffer.hpp>
+
+//! A single encoded jpeg ready to be written to any number of clients
+/*!
+The pull loop encodes every frame exactly once into one of these and then
+publishes it behind a shared pointer. Clients never copy the image, they
+only hold a reference while the socket write is in flight and hand the
+kernel a scatter/gather list of { header, send stamp, jpeg, trailer }.
+Once published a frame must never be modified since other threads may be
+reading it.
+
+Every part carries monotonic clock timestamps in microseconds so a client
+can tell where its latency comes from: X-Seq (capture order, the same for
+every rendition of a frame), X-Capture-Ts, X-Encode-Ts and the per client
+X-Send-Ts written just before the part goes to the socket.
+*/
+class MjpgFrame
+{
+public:
+    //!Encoded jpeg bytes
+    std::vector<unsigned char> jpeg;
+
+    //!Pre-serialized multipart part header (boundary, type and length)
+    std::string header;
+
+    //!Publication order stamped by the channel, newer frames are larger
+    unsigned long seq = 0;
+
+    //!When the channel published the frame
+    std::chrono::steady_clock::time_point published;
+
+    //!Capture order of the source frame, shared by all its renditions
+    unsigned long captureseq = 0;
+
+    //!When the source frame was captured
+    std::chrono::steady_clock::time_point captured;
+
+    //!When encoding finished
+    std::chrono::steady_clock::time_point encoded;
+
+    //!An earlier frame whose jpeg goes out again instead of a copy, this one's own jpeg is unused then
+    std::shared_ptr<const MjpgFrame> reuses;
+
+    //! Get the frame whose jpeg this one sends
+    /*!
+    @return the reused frame or this one
+    */
+    const MjpgFrame &content() const
+    {
+        return this->reuses ? *this->reuses : *this;
+    }
+
+    //! Get a timestamp as the microseconds sent in the part headers
+    /*!
+    @param point a steady (monotonic) clock time
+    @return microseconds since the clock's epoch
+    */
+    static long long micros(std::chrono::steady_clock::time_point point)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(point.time_since_epoch()).count();
+    }
+
+    //! Write the per client send stamp that completes a part header
+    /*!
+    @param out at least 48 bytes
+    @param sent when the part is handed to the socket
+    @return the stamp's length
+    */
+    static size_t stamp(char *out, std::chrono::steady_clock::time_point sent)
+    {
+        return (size_t) snprintf(out, 48, "X-Send-Ts: %lld\r\n\r\n", MjpgFrame::micros(sent));
+    }
+
+    //! Build the multipart part header for the current jpeg
+    /*!
+    Must be called after the jpeg has been encoded and stamped and before
+    the frame is published so every client can reuse the same header
+    bytes. The header is left open, each client ends it with its stamp()
+
+    @param boundary the multipart boundary the stream was opened with
+    */
+    void seal(const std::string &boundary)
+    {
+        //Appended in place so a recycled frame reuses the header's capacity
+        char fields[128];
+        snprintf(fields, sizeof(fields), "%lu\r\nX-Seq: %lu\r\nX-Capture-Ts: %lld\r\nX-Encode-Ts: %lld\r\n",
+                 (unsigned long) this->content().jpeg.size(), this->captureseq,
+                 MjpgFrame::micros(this->captured), MjpgFrame::micros(this->encoded));
+        this->header.assign(boundary);
+        this->header.append("\r\nContent-Type: image/jpeg\r\nContent-Length: ");
+        this->header.append(fields);
+    }
+
+    //! Get the frame as a multipart part buffer sequence
+    /*!
+    The returned buffers point straight into this frame so the frame
+    must be kept alive until the write using them has completed
+
+    @param stamp the client's send stamp closing the header
+    @return the header, stamp, jpeg and closing newline as a gather list
+    */
+    boost::array<boost::asio::const_buffer, 4> buffers(boost::asio::const_buffer stamp) const
+    {
+        boost::array<boost::asio::const_buffer, 4> parts = {{
+            boost::asio::buffer(this->header),
+            stamp,
+            boost::asio::buffer(this->content().jpeg),
+            boost::asio::buffer("\r\n", 2)
+        }};
+        return parts;
+    }
+};
+
+//!Shared read only handle to a published frame
+typedef std::shared_ptr<const MjpgFrame> MjpgFramePtr;
+
+#endif  // MJPGFRAME_H_
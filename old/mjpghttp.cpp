@@ -0,0 +1,190 @@
+/**
+    CS-11 Format
+    File: mjpghttp.cpp
+    Purpose: Incremental HTTP/1.1 request parser working in place on a fixed connection buffer
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpghttp.h"
+#include <cstring>
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace
+{
+    //! Strip spaces and tabs from both ends
+    boost::string_ref trim(boost::string_ref text)
+    {
+        while(!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while(!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+        return text;
+    }
+
+    //! Split off everything up to the first separator
+    boost::string_ref token(boost::string_ref &text, char separator)
+    {
+        size_t at = text.find(separator);
+        boost::string_ref first = text.substr(0, at);
+        text = at == boost::string_ref::npos ? boost::string_ref() : text.substr(at + 1);
+        return first;
+    }
+
+    //! Check a comma separated header value for a token regardless of case
+    bool hastoken(boost::string_ref value, const char *wanted)
+    {
+        while(!value.empty())
+        {
+            if(boost::algorithm::iequals(trim(token(value, ',')), wanted)) return true;
+        }
+        return false;
+    }
+}
+
+boost::string_ref MjpgHttpRequest::header(boost::string_ref name) const
+{
+    for(size_t i = 0; i < this->headercount; i++)
+    {
+        if(boost::algorithm::iequals(this->headers[i].name, name)) return this->headers[i].value;
+    }
+    return boost::string_ref();
+}
+
+MjpgHttpParser::MjpgHttpParser(size_t capacity) : buffer(capacity > 64 ? capacity : 64) {}
+
+boost::asio::mutable_buffers_1 MjpgHttpParser::prepare()
+{
+    return boost::asio::buffer(this->buffer.data() + this->used, this->buffer.size() - this->used);
+}
+
+MjpgHttpParser::result MjpgHttpParser::commit(size_t bytes)
+{
+    this->used += bytes;
+    return this->parse();
+}
+
+MjpgHttpParser::result MjpgHttpParser::parse()
+{
+    if(this->length > 0) return complete;
+    if(this->headlength == 0)
+    {
+        //Only scan what is new, backing up enough to catch a terminator split over two reads
+        size_t from = this->scanned > 3 ? this->scanned - 3 : 0;
+        const char *data = this->buffer.data();
+        for(size_t at = from; at + 4 <= this->used; at++)
+        {
+            if(data[at] == '\r' && data[at + 1] == '\n' && data[at + 2] == '\r' && data[at + 3] == '\n')
+            {
+                this->headlength = at + 4;
+                break;
+            }
+        }
+        this->scanned = this->used;
+        if(this->headlength == 0) return this->used >= this->buffer.size() ? toolarge : incomplete;
+        result head = this->parseHead();
+        if(head != complete) return head;
+    }
+    if(this->current.contentlength > this->buffer.size() - this->headlength) return bodytoolarge;
+    if(this->used < this->headlength + this->current.contentlength) return incomplete;
+    this->current.body = boost::string_ref(this->buffer.data() + this->headlength, this->current.contentlength);
+    this->length = this->headlength + this->current.contentlength;
+    return complete;
+}
+
+MjpgHttpParser::result MjpgHttpParser::parseHead()
+{
+    boost::string_ref head(this->buffer.data(), this->headlength - 2); //Every line keeps its CRLF, a request line without headers too
+    while(head.starts_with("\r\n")) head.remove_prefix(2); //Stray newlines between requests are allowed
+
+    boost::string_ref line = token(head, '\n');
+    if(line.empty() || line.back() != '\r') return invalid;
+    line.remove_suffix(1);
+    this->current.method = token(line, ' ');
+    this->current.target = token(line, ' ');
+    this->current.version = line;
+    if(this->current.method.empty() || this->current.target.empty() || !this->current.version.starts_with("HTTP/")) return invalid;
+    boost::string_ref target = this->current.target;
+    this->current.path = token(target, '?');
+    this->current.query = target;
+
+    bool chunked = false;
+    boost::string_ref connection;
+    while(!head.empty())
+    {
+        line = token(head, '\n');
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if(line.empty()) continue;
+        if(line.front() == ' ' || line.front() == '\t') return invalid; //Folded headers are obsolete
+        size_t colon = line.find(':');
+        if(colon == boost::string_ref::npos || colon == 0) return invalid;
+        if(this->current.headercount == MJPGHTTP_MAXHEADERS) return invalid;
+        MjpgHttpHeader &header = this->current.headers[this->current.headercount++];
+        header.name = line.substr(0, colon);
+        header.value = trim(line.substr(colon + 1));
+
+        if(boost::algorithm::iequals(header.name, "Content-Length"))
+        {
+            if(header.value.empty()) return invalid;
+            size_t contentlength = 0;
+            for(size_t i = 0; i < header.value.size(); i++)
+            {
+                if(header.value[i] < '0' || header.value[i] > '9') return invalid;
+                contentlength = contentlength * 10 + (header.value[i] - '0');
+                if(contentlength > this->buffer.size()) return bodytoolarge; //Also stops overflowing
+            }
+            this->current.contentlength = contentlength;
+        }
+        else if(boost::algorithm::iequals(header.name, "Transfer-Encoding"))
+        {
+            chunked = true;
+        }
+        else if(boost::algorithm::iequals(header.name, "Connection"))
+        {
+            connection = header.value;
+        }
+    }
+    if(chunked) return invalid;
+    if(this->current.version == "HTTP/1.1")
+        this->current.keepalive = !hastoken(connection, "close");
+    else
+        this->current.keepalive = hastoken(connection, "keep-alive");
+    return complete;
+}
+
+const MjpgHttpRequest &MjpgHttpParser::request() const
+{
+    return this->current;
+}
+
+boost::string_ref MjpgHttpParser::remaining() const
+{
+    return boost::string_ref(this->buffer.data() + this->length, this->used - this->length);
+}
+
+void MjpgHttpParser::consume()
+{
+    if(this->length > 0)
+    {
+        std::memmove(this->buffer.data(), this->buffer.data() + this->length, this->used - this->length);
+        this->used -= this->length;
+    }
+    else
+    {
+        this->used = 0; //Nothing complete to keep, start over
+    }
+    this->scanned = 0;
+    this->headlength = 0;
+    this->length = 0;
+    this->current = MjpgHttpRequest();
+}
@@ -0,0 +1,144 @@
+/**
+    CS-11 Format
+    File: mjpghttp.h
+    Purpose: Incremental HTTP/1.1 request parser working in place on a fixed connection buffer
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGHTTP_H_
+#define MJPGHTTP_H_
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <boost/utility/string_ref.hpp>
+#include <boost/asio/buffer.hpp>
+
+//!Most headers a request may carry
+#define MJPGHTTP_MAXHEADERS 32
+
+//! One request header, both views point into the parser buffer
+struct MjpgHttpHeader
+{
+    boost::string_ref name;
+    boost::string_ref value;
+};
+
+//! A parsed request
+/*!
+Every view points straight into the connection buffer so nothing is
+copied, they stay valid until the parser is told to consume the request
+*/
+struct MjpgHttpRequest
+{
+    boost::string_ref method;
+    //!Path and query as sent
+    boost::string_ref target;
+    //!Target up to the ?
+    boost::string_ref path;
+    //!Target after the ? (empty without one)
+    boost::string_ref query;
+    boost::string_ref version;
+    boost::string_ref body;
+    MjpgHttpHeader headers[MJPGHTTP_MAXHEADERS];
+    size_t headercount = 0;
+    size_t contentlength = 0;
+    //!Whether the connection may carry another request after this one
+    bool keepalive = false;
+
+    //! Look up a header
+    /*!
+    @param name header name, matched without regard to case
+    @return the trimmed value or an empty view when missing
+    */
+    boost::string_ref header(boost::string_ref) const;
+};
+
+//! Incremental HTTP/1.1 request parser
+/*!
+The connection reads straight into the free tail of a buffer allocated
+once for the parser, the parser then picks up from where it stopped
+scanning. Nothing is allocated per request. Bodies are framed by
+Content-Length, chunked bodies aren't supported. Bytes that arrive after
+a complete request stay buffered so pipelined requests are parsed right
+after the current one is consumed. A request (head and body) must fit
+the buffer, so its size is also the request size limit
+*/
+class MjpgHttpParser
+{
+public:
+    enum result
+    {
+        //!Need more bytes
+        incomplete,
+        //!request() is ready
+        complete,
+        //!Not a request we understand
+        invalid,
+        //!Headers larger than the buffer
+        toolarge,
+        //!A Content-Length larger than what the buffer has left after the headers
+        bodytoolarge
+    };
+
+    //! Create a parser for requests up to capacity bytes
+    MjpgHttpParser(size_t);
+
+    //! Get the free part of the buffer to read into
+    boost::asio::mutable_buffers_1 prepare(void);
+
+    //! Account for bytes read into prepare() and parse them
+    /*!
+    @param bytes how many bytes were read
+    @return the state of the current request
+    */
+    result commit(size_t);
+
+    //! Parse whatever is buffered (pipelined requests)
+    result parse(void);
+
+    //! The current request, only valid after complete
+    const MjpgHttpRequest &request(void) const;
+
+    //! Drop the current request keeping any bytes after it
+    void consume(void);
+
+    //! Bytes buffered after the current request
+    /*!
+    What a connection that switches protocols already sent in its new
+    protocol, only valid after complete and until the next read
+
+    @return a view into the parser buffer
+    */
+    boost::string_ref remaining(void) const;
+
+private:
+    //!Parses the request line and headers once the blank line was found, complete if they were fine
+    result parseHead(void);
+
+    std::vector<char> buffer;
+    size_t used = 0;
+    //!Where the search for the end of the head continues
+    size_t scanned = 0;
+    //!Length of the head including the blank line, 0 until found
+    size_t headlength = 0;
+    //!Length of the whole request once complete
+    size_t length = 0;
+    MjpgHttpRequest current;
+};
+
+#endif  // MJPGHTTP_H_
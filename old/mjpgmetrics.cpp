@@ -0,0 +1,226 @@
+/**
+    CS-11 Format
+    File: mjpgmetrics.cpp
+    Purpose: Cheap sharded counters and histograms exported in the Prometheus text format
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgmetrics.h"
+#include <cstdio>
+
+void MjpgCounter::add(uint64_t amount)
+{
+    this->cells[MjpgMetrics::shard()].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t MjpgCounter::value() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < MJPGMETRICS_SHARDS; i++)
+        total += this->cells[i].value.load(std::memory_order_relaxed);
+    return total;
+}
+
+int MjpgHistogram::bucket(uint64_t value)
+{
+    if(value <= 8) return (int) value; //Exact up to the first power of two that needs splitting
+    uint64_t under = value - 1; //Buckets end on their upper edge, like Prometheus' le
+    int power = 63 - __builtin_clzll(under);
+    int index = (power - 2) * 8 + (int) ((under >> (power - 3)) & 7) + 1;
+    return index < MJPGMETRICS_BUCKETS ? index : MJPGMETRICS_BUCKETS - 1;
+}
+
+uint64_t MjpgHistogram::upper(int index)
+{
+    if(index < 8) return (uint64_t) index;
+    int power = index / 8 + 2;
+    return (uint64_t) (8 + index % 8) << (power - 3);
+}
+
+void MjpgHistogram::record(uint64_t value)
+{
+    shard &mine = this->shards[MjpgMetrics::shard()];
+    mine.counts[MjpgHistogram::bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    mine.total.fetch_add(value, std::memory_order_relaxed);
+    mine.samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t MjpgHistogram::count() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < MJPGMETRICS_SHARDS; i++)
+        total += this->shards[i].samples.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t MjpgHistogram::sum() const
+{
+    uint64_t total = 0;
+    for(int i = 0; i < MJPGMETRICS_SHARDS; i++)
+        total += this->shards[i].total.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t MjpgHistogram::atmost(uint64_t bound) const
+{
+    int last = MjpgHistogram::bucket(bound);
+    if(MjpgHistogram::upper(last) > bound) last--; //The bound's own bucket only counts if it ends there
+    uint64_t total = 0;
+    for(int s = 0; s < MJPGMETRICS_SHARDS; s++)
+        for(int i = 0; i <= last; i++)
+            total += this->shards[s].counts[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t MjpgHistogram::percentile(double percent) const
+{
+    uint64_t merged[MJPGMETRICS_BUCKETS] = {0};
+    uint64_t total = 0;
+    for(int s = 0; s < MJPGMETRICS_SHARDS; s++)
+        for(int i = 0; i < MJPGMETRICS_BUCKETS; i++)
+        {
+            uint64_t count = this->shards[s].counts[i].load(std::memory_order_relaxed);
+            merged[i] += count;
+            total += count;
+        }
+    if(total == 0) return 0;
+    uint64_t rank = (uint64_t) (percent / 100.0 * (double) total);
+    if(rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for(int i = 0; i < MJPGMETRICS_BUCKETS; i++)
+    {
+        seen += merged[i];
+        if(seen > rank) return MjpgHistogram::upper(i);
+    }
+    return MjpgHistogram::upper(MJPGMETRICS_BUCKETS - 1);
+}
+
+unsigned MjpgMetrics::shard()
+{
+    static std::atomic<unsigned> next{0};
+    static thread_local unsigned mine = next++ % MJPGMETRICS_SHARDS;
+    return mine;
+}
+
+std::string MjpgMetrics::label(const std::string &key, const std::string &value)
+{
+    std::string pair = key + "=\"";
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        if(value[i] == '\\') pair += "\\\\";
+        else if(value[i] == '"') pair += "\\\"";
+        else if(value[i] == '\n') pair += "\\n";
+        else pair += value[i];
+    }
+    return pair + "\"";
+}
+
+MjpgCounter &MjpgMetrics::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    std::unique_ptr<metric> added(new metric());
+    added->name = name;
+    added->help = help;
+    added->type = "counter";
+    added->labels = labels;
+    added->counter.reset(new MjpgCounter());
+    MjpgCounter &counter = *added->counter;
+    this->metrics.push_back(std::move(added));
+    return counter;
+}
+
+MjpgHistogram &MjpgMetrics::histogram(const std::string &name, const std::string &help, double scale, int low, int high,
+                                      const std::string &labels)
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    std::unique_ptr<metric> added(new metric());
+    added->name = name;
+    added->help = help;
+    added->type = "histogram";
+    added->labels = labels;
+    added->histogram.reset(new MjpgHistogram());
+    added->scale = scale;
+    added->low = low;
+    added->high = high < 40 ? high : 40;
+    MjpgHistogram &histogram = *added->histogram;
+    this->metrics.push_back(std::move(added));
+    return histogram;
+}
+
+void MjpgMetrics::sample(const std::string &name, const std::string &help, const std::string &type,
+                         std::function<double()> read, const std::string &labels)
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    std::unique_ptr<metric> added(new metric());
+    added->name = name;
+    added->help = help;
+    added->type = type;
+    added->labels = labels;
+    added->read = read;
+    this->metrics.push_back(std::move(added));
+}
+
+//Prometheus floats, %.9g of a double always fits
+static std::string number(double value)
+{
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.9g", value);
+    return formatted;
+}
+
+std::string MjpgMetrics::render()
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    std::string text;
+    for(size_t first = 0; first < this->metrics.size(); first++)
+    {
+        bool rendered = false;
+        for(size_t seen = 0; seen < first && !rendered; seen++)
+            rendered = this->metrics[seen]->name == this->metrics[first]->name;
+        if(rendered) continue; //Every series of a family went out with its first one
+        text += "# HELP " + this->metrics[first]->name + " " + this->metrics[first]->help + "\n";
+        text += "# TYPE " + this->metrics[first]->name + " " + this->metrics[first]->type + "\n";
+        for(size_t m = first; m < this->metrics.size(); m++)
+        {
+            const metric &current = *this->metrics[m];
+            if(current.name != this->metrics[first]->name) continue;
+            //Names and labels go in whole however long they are, only the numbers are formatted
+            std::string labels = current.labels.empty() ? "" : "{" + current.labels + "}";
+            if(current.histogram)
+            {
+                //Exported at every power of two, the fine buckets stay internal for percentiles
+                std::string prefix = current.labels.empty() ? "" : current.labels + ",";
+                uint64_t samples = current.histogram->count();
+                for(int power = current.low; power <= current.high; power++)
+                {
+                    uint64_t bound = (uint64_t) 1 << power;
+                    uint64_t atmost = current.histogram->atmost(bound);
+                    if(atmost > samples) samples = atmost; //Shards are read one by one, keep the buckets monotonic
+                    text += current.name + "_bucket{" + prefix + "le=\"" + number((double) bound * current.scale) + "\"} " +
+                            std::to_string((unsigned long long) atmost) + "\n";
+                }
+                text += current.name + "_bucket{" + prefix + "le=\"+Inf\"} " + std::to_string((unsigned long long) samples) + "\n";
+                text += current.name + "_sum" + labels + " " + number((double) current.histogram->sum() * current.scale) + "\n";
+                text += current.name + "_count" + labels + " " + std::to_string((unsigned long long) samples) + "\n";
+            }
+            else if(current.counter)
+                text += current.name + labels + " " + std::to_string((unsigned long long) current.counter->value()) + "\n";
+            else
+                text += current.name + labels + " " + number(current.read()) + "\n";
+        }
+    }
+    return text;
+}
@@ -0,0 +1,211 @@
+/**
+    CS-11 Format
+    File: mjpgmetrics.h
+    Purpose: Cheap sharded counters and histograms exported in the Prometheus text format
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGMETRICS_H_
+#define MJPGMETRICS_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <boost/thread/mutex.hpp>
+
+//!Independent copies of every metric so threads rarely share a cache line
+#define MJPGMETRICS_SHARDS 8
+//!Histogram buckets, 8 per power of two up to 2^40
+#define MJPGMETRICS_BUCKETS 320
+
+//! Monotonic counter split into per thread shards
+/*!
+Adding is a relaxed increment of the calling thread's shard, reading sums
+every shard so it's meant for the rare scrape, not the hot path
+*/
+class MjpgCounter
+{
+public:
+    //! Add to the counter (any thread, lock free)
+    /*!
+    @param amount how much to add
+    */
+    void add(uint64_t amount = 1);
+
+    //! Get the total over every shard
+    /*!
+    @return the count
+    */
+    uint64_t value(void) const;
+
+private:
+    //!One shard padded out to its own cache line
+    struct cell
+    {
+        std::atomic<uint64_t> value{0};
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    cell cells[MJPGMETRICS_SHARDS];
+};
+
+//! Log linear (HDR style) histogram of integer values
+/*!
+Every power of two is split into 8 linear buckets so any value is kept
+within 12.5% no matter its magnitude, from nanoseconds to whole seconds.
+A bucket holds the values above the previous one's edge up to and
+including its own, so a value on a power of two counts toward that le.
+Recording is a couple of relaxed increments on the calling thread's shard
+*/
+class MjpgHistogram
+{
+public:
+    //! Record one value (any thread, lock free)
+    /*!
+    @param value the sample, in the histogram's unit (ns, bytes...)
+    */
+    void record(uint64_t);
+
+    //! Get how many values were recorded
+    /*!
+    @return the count
+    */
+    uint64_t count(void) const;
+
+    //! Get the sum of every recorded value
+    /*!
+    @return the sum
+    */
+    uint64_t sum(void) const;
+
+    //! Get a percentile
+    /*!
+    @param percent between 0 and 100
+    @return the upper edge of the bucket holding that percentile or 0 when empty
+    */
+    uint64_t percentile(double) const;
+
+    //! Get how many values were at or below a bound
+    /*!
+    @param bound inclusive, counted at bucket resolution
+    @return the count of values in buckets ending at or below bound
+    */
+    uint64_t atmost(uint64_t) const;
+
+    //!Bucket a value falls in
+    static int bucket(uint64_t);
+
+    //!Largest value of a bucket
+    static uint64_t upper(int);
+
+private:
+    struct shard
+    {
+        std::atomic<uint64_t> counts[MJPGMETRICS_BUCKETS];
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> samples{0};
+        shard() { for(int i = 0; i < MJPGMETRICS_BUCKETS; i++) this->counts[i].store(0, std::memory_order_relaxed); }
+    };
+
+    shard shards[MJPGMETRICS_SHARDS];
+};
+
+//! Registry of named metrics and their Prometheus text rendering
+/*!
+Metrics are registered up front and live as long as the registry, so the
+references handed out can be kept and updated from any thread. Gauges and
+externally kept counters are read through a callback at scrape time
+*/
+class MjpgMetrics
+{
+public:
+    //! Shard of the calling thread
+    /*!
+    @return a stable index below MJPGMETRICS_SHARDS handed out round robin per thread
+    */
+    static unsigned shard(void);
+
+    //! Build a label pair out of any text
+    /*!
+    @param key the label name
+    @param value escaped for the exposition format (backslash, quote and newline)
+    @return key="value" ready to go in a label set
+    */
+    static std::string label(const std::string &, const std::string &);
+
+    //! Register a counter
+    /*!
+    @param name metric name, ending in _total by convention
+    @param help one line description
+    @param labels optional label set without braces (key="value")
+    @return the counter to update
+    */
+    MjpgCounter &counter(const std::string &, const std::string &, const std::string &labels = "");
+
+    //! Register a histogram
+    /*!
+    @param name metric name in the base unit (_seconds, _bytes)
+    @param help one line description
+    @param scale multiplier from the recorded unit to the base unit (1e-9 for ns to seconds)
+    @param low exported buckets start at 2^low
+    @param high and end at 2^high
+    @param labels optional label set without braces
+    @return the histogram to record into
+    */
+    MjpgHistogram &histogram(const std::string &, const std::string &, double, int, int, const std::string &labels = "");
+
+    //! Register a value read when scraped
+    /*!
+    @param name metric name
+    @param help one line description
+    @param type counter or gauge
+    @param read returns the current value
+    @param labels optional label set without braces
+    */
+    void sample(const std::string &, const std::string &, const std::string &, std::function<double()>, const std::string &labels = "");
+
+    //! Render every metric in the Prometheus text exposition format
+    /*!
+    @return the /metrics body
+    */
+    std::string render(void);
+
+private:
+    struct metric
+    {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::string labels;
+        std::unique_ptr<MjpgCounter> counter;
+        std::unique_ptr<MjpgHistogram> histogram;
+        std::function<double()> read;
+        double scale = 1.0;
+        int low = 0;
+        int high = 0;
+    };
+
+    //!Metrics in registration order, series of one family are rendered together
+    std::vector<std::unique_ptr<metric> > metrics;
+    boost::mutex mutex;
+};
+
+#endif  // MJPGMETRICS_H_
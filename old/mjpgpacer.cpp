@@ -0,0 +1,132 @@
+/**
+    CS-11 Format
+    File: mjpgpacer.cpp
+    Purpose: Deadline based frame pacing for the capture thread and the streaming clients
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgpacer.h"
+#include <cmath>
+#include <thread>
+#include <boost/bind.hpp>
+#include <boost/asio/placeholders.hpp>
+#ifdef __linux__
+#include <time.h>
+#include <cerrno>
+#endif
+
+void MjpgJitter::tick(std::chrono::steady_clock::duration target)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double interval = std::chrono::duration<double, std::milli>(now - this->last).count();
+    this->last = now;
+    if(this->ticks < 2)
+    {
+        this->ticks++;
+        return;
+    }
+    double mean = this->smoothed.load();
+    mean = mean > 0.0 ? mean * 0.9 + interval * 0.1 : interval;
+    this->smoothed.store(mean);
+    double wanted = target.count() > 0 ? std::chrono::duration<double, std::milli>(target).count() : mean;
+    double off = std::fabs(interval - wanted);
+    this->deviation.store(this->deviation.load() * 0.9 + off * 0.1);
+    if(off > this->largest.load()) this->largest.store(off);
+}
+
+void MjpgPacer::setRate(int fps)
+{
+    if(fps == this->rate) return;
+    this->rate = fps;
+    if(fps > 0)
+        this->period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(1000000000LL / fps));
+    else
+        this->period = std::chrono::milliseconds(2); //Unregulated still leaves the cpu a breather
+    this->started = false; //New rate, new schedule
+}
+
+std::chrono::steady_clock::time_point MjpgPacer::wait()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(!this->started || now - this->next > this->period)
+    {
+        this->started = true;
+        this->next = now; //Fell a whole interval behind, don't burst to catch up
+    }
+    std::chrono::steady_clock::time_point deadline = this->next;
+    this->next += this->period;
+    if(deadline <= now) return deadline;
+#ifdef __linux__
+    //steady_clock is CLOCK_MONOTONIC so the deadline can be slept until as is
+    std::chrono::nanoseconds since = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+    timespec until;
+    until.tv_sec = since.count() / 1000000000LL;
+    until.tv_nsec = since.count() % 1000000000LL;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR) {}
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+    return deadline;
+}
+
+MjpgTicker::MjpgTicker(boost::asio::io_service &loop, std::chrono::steady_clock::duration period)
+    : timer(loop), period(period) {}
+
+void MjpgTicker::wait(std::weak_ptr<void> owner, std::function<void()> callback)
+{
+    waiter parked = { owner, callback };
+    this->waiters.push_back(parked);
+    if(this->armed) return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(this->next <= now) //Idle for a while, stay on the same phase
+        this->next += ((now - this->next) / this->period + 1) * this->period;
+    this->armed = true;
+    this->timer.expires_at(this->next);
+    this->timer.async_wait(boost::bind(&MjpgTicker::onTick, this, boost::asio::placeholders::error));
+}
+
+void MjpgTicker::onTick(const boost::system::error_code &error)
+{
+    this->armed = false;
+    if(error) return;
+    this->next += this->period;
+    this->firing.swap(this->waiters);
+    for(size_t i = 0; i < this->firing.size(); i++)
+    {
+        std::shared_ptr<void> alive = this->firing[i].owner.lock();
+        if(alive) this->firing[i].callback(); //May park itself again for the next tick
+    }
+    this->firing.clear();
+    if(!this->waiters.empty() && !this->armed)
+    {
+        this->armed = true;
+        this->timer.expires_at(this->next);
+        this->timer.async_wait(boost::bind(&MjpgTicker::onTick, this, boost::asio::placeholders::error));
+    }
+}
+
+MjpgTicker &MjpgTimerWheel::ticker(int fps)
+{
+    if(fps < 1) fps = 1;
+    std::unique_ptr<MjpgTicker> &found = this->tickers[fps];
+    if(!found)
+    {
+        std::chrono::steady_clock::duration period =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(1000000000LL / fps));
+        found.reset(new MjpgTicker(this->loop, period));
+    }
+    return *found;
+}
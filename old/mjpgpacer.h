@@ -0,0 +1,159 @@
+/**
+    CS-11 Format
+    File: mjpgpacer.h
+    Purpose: Deadline based frame pacing for the capture thread and the streaming clients
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGPACER_H_
+#define MJPGPACER_H_
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+//! Measures how evenly spaced a series of events is
+/*!
+Jitter is the smoothed distance of every interval from the target
+interval, or from the smoothed interval itself when there is no target.
+The first interval is left out since it mostly measures start up.
+Written by one thread, the readings are safe from any thread
+*/
+class MjpgJitter
+{
+public:
+    //! Record that the event happened now
+    /*!
+    @param target the wanted interval or zero when unpaced
+    */
+    void tick(std::chrono::steady_clock::duration);
+
+    //!Smoothed interval between events (ms)
+    double interval(void) const { return this->smoothed; }
+
+    //!Smoothed deviation from the target interval (ms)
+    double jitter(void) const { return this->deviation; }
+
+    //!Largest deviation seen (ms)
+    double worst(void) const { return this->largest; }
+
+private:
+    std::chrono::steady_clock::time_point last;
+    int ticks = 0;
+    std::atomic<double> smoothed{0.0};
+    std::atomic<double> deviation{0.0};
+    std::atomic<double> largest{0.0};
+};
+
+//! Paces a loop at a fixed rate with absolute deadlines
+/*!
+Every wait sleeps until an absolute point on the monotonic clock so the
+time spent working between waits doesn't add up into drift. After a
+stall longer than a whole interval the schedule restarts from now
+instead of bursting to catch up
+*/
+class MjpgPacer
+{
+public:
+    //! Set the rate
+    /*!
+    @param fps events per second or -1 for the unregulated minimum gap
+    */
+    void setRate(int);
+
+    //! Sleep until the next deadline
+    /*!
+    @return the deadline that was slept until, compare to now for the lateness
+    */
+    std::chrono::steady_clock::time_point wait(void);
+
+private:
+    int rate = 0;
+    std::chrono::steady_clock::duration period = std::chrono::milliseconds(2);
+    std::chrono::steady_clock::time_point next;
+    bool started = false;
+};
+
+//! One shared timer waking every client paced at the same rate
+/*!
+Lives on a single event loop and must only be used from it. Ticks fall
+on absolute multiples of the period, so clients capped at the same rate
+are woken together by one timer and never drift. The timer only runs
+while somebody is waiting
+*/
+class MjpgTicker
+{
+public:
+    MjpgTicker(boost::asio::io_service &, std::chrono::steady_clock::duration);
+
+    //! Run a callback on the next tick
+    /*!
+    @param owner the waiting client, skipped if it went away meanwhile
+    @param callback runs on the loop at the tick
+    */
+    void wait(std::weak_ptr<void>, std::function<void()>);
+
+    //!The tick interval
+    std::chrono::steady_clock::duration interval(void) const { return this->period; }
+
+private:
+    void onTick(const boost::system::error_code &);
+
+    struct waiter
+    {
+        std::weak_ptr<void> owner;
+        std::function<void()> callback;
+    };
+
+    boost::asio::steady_timer timer;
+    const std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point next;
+    bool armed = false;
+    std::vector<waiter> waiters;
+    std::vector<waiter> firing;
+};
+
+//! The tickers of one event loop by rate
+/*!
+A client capped at 5 fps and another at 15 fps each share a ticker with
+every other client of that rate on the loop, so per client rate caps
+cost one timer per distinct rate instead of one per client
+*/
+class MjpgTimerWheel
+{
+public:
+    MjpgTimerWheel(boost::asio::io_service &loop) : loop(loop) {}
+
+    //! Get the ticker for a rate (loop thread only)
+    /*!
+    @param fps frames per second, at least 1
+    @return the ticker shared by every client of that rate on this loop
+    */
+    MjpgTicker &ticker(int);
+
+private:
+    boost::asio::io_service &loop;
+    std::map<int, std::unique_ptr<MjpgTicker> > tickers;
+};
+
+#endif  // MJPGPACER_H_
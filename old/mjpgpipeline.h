@@ -0,0 +1,130 @@
+/**
+    CS-11 Format
+    File: mjpgpipeline.h
+    Purpose: Work items and timing of the capture, resize, encode and publish stages
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGPIPELINE_H_
+#define MJPGPIPELINE_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <opencv2/core/core.hpp>
+#include "mjpgframe.h"
+#include "mjpgprofile.h"
+#include "mjpgworkers.h"
+
+//! One pulled frame travelling through the pipeline
+/*!
+Created by the capture stage, the resize stage fills in one sized mat
+per live profile, the encode stage one frame per profile and the
+publish stage hands those to the profile channels
+*/
+struct MjpgPipelineJob
+{
+    //!Capture order, newer jobs are larger
+    unsigned long seq = 0;
+    cv::Mat pulled;
+    std::vector<MjpgProfilePtr> profiles;
+    std::vector<MjpgRendition> renditions;
+    std::vector<cv::Mat> sized;
+    std::vector<std::shared_ptr<MjpgFrame> > encoded;
+    //!The change detector saw no difference, so each profile's last encoded frame can go out again
+    bool unchanged = false;
+    //!Upstream jpeg of a relayed frame, pulled is only decoded from it when a profile needs another size or quality, the encode stage moves it into the relayed frame
+    std::vector<unsigned char> compressed;
+    //!Per profile whether the upstream jpeg goes out untouched
+    std::vector<bool> relayed;
+    //!When the source frame was captured
+    std::chrono::steady_clock::time_point captured;
+    //!When the job was handed to the next stage
+    std::chrono::steady_clock::time_point queued;
+    //!Profiles still being encoded on the worker threads, guarded by latch
+    unsigned pending = 0;
+    //!What stopped one of the encodes, empty if none did
+    std::string failure;
+    boost::mutex latch;
+    //!Signalled when pending drops to 0
+    boost::condition_variable finished;
+
+    //! Let go of the frames while keeping the vectors' capacity for the next job
+    void reset()
+    {
+        this->pulled.release();
+        this->profiles.clear();
+        this->renditions.clear();
+        this->sized.clear();
+        this->encoded.clear();
+        this->unchanged = false;
+        this->compressed.clear();
+        this->relayed.clear();
+        this->pending = 0;
+        this->failure.clear();
+    }
+};
+
+//! Snapshot of one pipeline stage
+struct MjpgStageStats
+{
+    std::string name;
+    //!Jobs waiting in front of the stage
+    size_t depth;
+    //!Jobs the stage never saw because it fell behind
+    unsigned long dropped;
+    //!Smoothed time a job waited in front of the stage (ms)
+    double waiting;
+    //!Smoothed time the stage spent on a job (ms)
+    double working;
+};
+
+//! Timing of one stage, written by the stage thread only
+class MjpgStage
+{
+public:
+    MjpgStage(const std::string &name) : name(name) {}
+
+    const std::string name;
+
+    //! Record one job
+    /*!
+    @param queued when the job was queued for this stage
+    @param started when this stage picked it up
+    @param finished when this stage was done with it
+    */
+    void record(std::chrono::steady_clock::time_point queued,
+                std::chrono::steady_clock::time_point started,
+                std::chrono::steady_clock::time_point finished)
+    {
+        double wait = std::chrono::duration<double, std::milli>(started - queued).count();
+        double work = std::chrono::duration<double, std::milli>(finished - started).count();
+        this->waiting.store(this->waiting.load() * 0.9 + wait * 0.1);
+        this->working.store(this->working.load() * 0.9 + work * 0.1);
+    }
+
+    std::atomic<double> waiting{0.0};
+    std::atomic<double> working{0.0};
+};
+
+#endif  // MJPGPIPELINE_H_
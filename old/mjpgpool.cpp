@@ -0,0 +1,246 @@
+/**
+    CS-11 Format
+    File: mjpgpool.cpp
+    Purpose: Recycled pixel buffers, encoded frames and pipeline jobs for the frame hot path
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgpool.h"
+#include <new>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/mman.h>
+
+namespace
+{
+    //!Bytes in front of every pool buffer, keeps the pixels 64 byte aligned
+    const size_t headersize = 64;
+
+    //!Smallest buffer worth backing by huge pages
+    const size_t hugepage = 2 * 1024 * 1024;
+
+    //!Idle buffers kept per size, more are freed
+    const size_t idlepersize = 8;
+
+    //!What sits in front of every buffer so it can be freed the right way
+    struct blockheader
+    {
+        size_t length;
+        bool mapped;
+    };
+}
+
+MjpgMatPool::~MjpgMatPool()
+{
+    for(std::map<size_t, std::vector<unsigned char*> >::iterator it = this->blocks.begin(); it != this->blocks.end(); ++it)
+    {
+        for(size_t i = 0; i < it->second.size(); i++) MjpgMatPool::freeBlock(it->second[i]);
+    }
+    for(size_t i = 0; i < this->headers.size(); i++) ::operator delete(this->headers[i]);
+}
+
+cv::Mat MjpgMatPool::acquire(int rows, int cols, int type)
+{
+    cv::Mat pooled;
+    pooled.allocator = this;
+    pooled.create(rows, cols, type);
+    return pooled;
+}
+
+void MjpgMatPool::setHugePages(bool enable)
+{
+    this->hugepages = enable;
+}
+
+MjpgPoolStats MjpgMatPool::stats() const
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    MjpgPoolStats current = { this->name, this->hits.load(), this->misses.load(), this->idle, this->idlebytes };
+    return current;
+}
+
+cv::UMatData *MjpgMatPool::allocate(int dims, const int *sizes, int type, void *data, size_t *step, MjpgAccessFlag flags, cv::UMatUsageFlags usage) const
+{
+    if(data) return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage); //Nothing to pool for user memory
+
+    size_t total = CV_ELEM_SIZE(type);
+    for(int i = dims - 1; i >= 0; i--)
+    {
+        if(step) step[i] = total;
+        total *= sizes[i];
+    }
+
+    unsigned char *block = this->takeBlock(total);
+    void *storage = nullptr;
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        if(!this->headers.empty())
+        {
+            storage = this->headers.back();
+            this->headers.pop_back();
+        }
+    }
+    if(!storage) storage = ::operator new(sizeof(cv::UMatData));
+    cv::UMatData *u = new (storage) cv::UMatData(this);
+    u->data = u->origdata = block;
+    u->size = total;
+    return u;
+}
+
+bool MjpgMatPool::allocate(cv::UMatData *u, MjpgAccessFlag, cv::UMatUsageFlags) const
+{
+    return u != nullptr;
+}
+
+void MjpgMatPool::deallocate(cv::UMatData *u) const
+{
+    if(!u) return;
+    this->giveBlock(u->origdata, u->size);
+    u->~UMatData();
+    boost::mutex::scoped_lock l(this->mutex);
+    this->headers.push_back(u);
+}
+
+unsigned char *MjpgMatPool::takeBlock(size_t size) const
+{
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        std::map<size_t, std::vector<unsigned char*> >::iterator found = this->blocks.find(size);
+        if(found != this->blocks.end() && !found->second.empty())
+        {
+            unsigned char *block = found->second.back();
+            found->second.pop_back();
+            this->idle--;
+            this->idlebytes -= size;
+            this->hits++;
+            return block;
+        }
+    }
+    this->misses++;
+    return this->newBlock(size);
+}
+
+void MjpgMatPool::giveBlock(unsigned char *block, size_t size) const
+{
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        std::vector<unsigned char*> &spare = this->blocks[size];
+        if(spare.size() < idlepersize)
+        {
+            spare.push_back(block);
+            this->idle++;
+            this->idlebytes += size;
+            return;
+        }
+    }
+    MjpgMatPool::freeBlock(block); //Plenty of this size are idle already
+}
+
+unsigned char *MjpgMatPool::newBlock(size_t size) const
+{
+    size_t length = size + headersize;
+    unsigned char *base = nullptr;
+    bool mapped = false;
+    if(this->hugepages && size >= hugepage)
+    {
+        length = (length + hugepage - 1) / hugepage * hugepage;
+        void *region = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if(region == MAP_FAILED) //No huge pages reserved, let the kernel collapse it instead
+        {
+            region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if(region != MAP_FAILED) madvise(region, length, MADV_HUGEPAGE);
+#endif
+        }
+        if(region != MAP_FAILED)
+        {
+            base = static_cast<unsigned char*>(region);
+            mapped = true;
+        }
+    }
+    if(!base)
+    {
+        void *aligned = nullptr;
+        if(posix_memalign(&aligned, headersize, length) != 0) throw std::bad_alloc();
+        base = static_cast<unsigned char*>(aligned);
+    }
+    blockheader *header = reinterpret_cast<blockheader*>(base);
+    header->length = length;
+    header->mapped = mapped;
+    return base + headersize;
+}
+
+void MjpgMatPool::freeBlock(unsigned char *block)
+{
+    unsigned char *base = block - headersize;
+    blockheader *header = reinterpret_cast<blockheader*>(base);
+    if(header->mapped)
+        munmap(base, header->length);
+    else
+        free(base);
+}
+
+std::shared_ptr<MjpgFrame> MjpgFramePool::acquire()
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    for(size_t checked = 0; checked < this->frames.size(); checked++)
+    {
+        size_t at = (this->next + checked) % this->frames.size();
+        if(this->frames[at].use_count() == 1) //Only the pool still knows about it
+        {
+            std::atomic_thread_fence(std::memory_order_acquire); //See every write the last user made
+            this->frames[at]->reuses.reset(); //Lets go of the frame it sent again
+            this->next = at + 1;
+            this->hits++;
+            return this->frames[at];
+        }
+    }
+    this->misses++;
+    std::shared_ptr<MjpgFrame> fresh = std::make_shared<MjpgFrame>();
+    if(this->frames.size() < this->limit) this->frames.push_back(fresh);
+    return fresh;
+}
+
+void MjpgFramePool::forget(const MjpgFramePtr &frame)
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    for(size_t i = 0; i < this->frames.size();)
+    {
+        if(this->frames[i].get() == frame.get() || this->frames[i].get() == frame->reuses.get())
+        {
+            this->frames[i] = this->frames.back();
+            this->frames.pop_back();
+        }
+        else i++;
+    }
+    this->next = 0;
+}
+
+MjpgPoolStats MjpgFramePool::stats()
+{
+    boost::mutex::scoped_lock l(this->mutex);
+    MjpgPoolStats current = { "encoded", this->hits.load(), this->misses.load(), 0, 0 };
+    for(size_t i = 0; i < this->frames.size(); i++)
+    {
+        if(this->frames[i].use_count() != 1) continue;
+        current.pooled++;
+        current.bytes += this->frames[i]->jpeg.capacity();
+    }
+    return current;
+}
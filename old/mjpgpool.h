@@ -0,0 +1,239 @@
+/**
+    CS-11 Format
+    File: mjpgpool.h
+    Purpose: Recycled pixel buffers, encoded frames and pipeline jobs for the frame hot path
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGPOOL_H_
+#define MJPGPOOL_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <memory>
+#include <opencv2/core/core.hpp>
+#include <boost/thread/mutex.hpp>
+#include "mjpgframe.h"
+
+#if CV_VERSION_MAJOR >= 4
+typedef cv::AccessFlag MjpgAccessFlag;
+#else
+typedef int MjpgAccessFlag;
+#endif
+
+//! Hit and miss counters of one pool
+struct MjpgPoolStats
+{
+    std::string name;
+    //!Requests served from a recycled buffer
+    unsigned long hits;
+    //!Requests that had to allocate
+    unsigned long misses;
+    //!Idle buffers waiting for reuse
+    size_t pooled;
+    //!Bytes held by the idle buffers
+    size_t bytes;
+};
+
+//! OpenCV allocator recycling the pixel buffers of same sized mats
+/*!
+Set as the allocator of a mat before it is created (or call acquire())
+and its pixels come from a free list of earlier buffers with exactly the
+same size. Once the last mat sharing the buffer lets go OpenCV hands it
+back here instead of freeing it, so a steady stream of frames of one
+resolution stops touching the heap after the first few frames. Large
+buffers can be backed by huge pages to save TLB misses and page faults.
+The pool must outlive every mat allocated from it
+*/
+class MjpgMatPool : public cv::MatAllocator
+{
+public:
+    MjpgMatPool(const std::string &name) : name(name) {}
+    ~MjpgMatPool();
+
+    //! Create a mat whose pixels come from the pool
+    /*!
+    @param rows height in pixels
+    @param cols width in pixels
+    @param type OpenCV mat type like CV_8UC3
+    @return a new mat backed by a pooled buffer
+    */
+    cv::Mat acquire(int, int, int);
+
+    //! Back buffers of 2MB and up with huge pages
+    /*!
+    Explicit huge pages are tried first and transparent huge pages are
+    asked for when none are reserved. Only affects buffers allocated
+    from now on
+
+    @param enable true to use huge pages
+    */
+    void setHugePages(bool);
+
+    //! Get the hit and miss counters
+    MjpgPoolStats stats(void) const;
+
+    cv::UMatData *allocate(int, const int *, int, void *, size_t *, MjpgAccessFlag, cv::UMatUsageFlags) const;
+    bool allocate(cv::UMatData *, MjpgAccessFlag, cv::UMatUsageFlags) const;
+    void deallocate(cv::UMatData *) const;
+
+private:
+    //!Gets an idle buffer of exactly size bytes or allocates one
+    unsigned char *takeBlock(size_t) const;
+
+    //!Keeps a buffer for reuse or frees it when enough are idle
+    void giveBlock(unsigned char *, size_t) const;
+
+    //!Allocates a 64 byte aligned buffer, huge page backed if asked to
+    unsigned char *newBlock(size_t) const;
+
+    //!Frees a buffer from newBlock
+    static void freeBlock(unsigned char *);
+
+    const std::string name;
+    std::atomic<bool> hugepages{false};
+    mutable boost::mutex mutex;
+    //!Idle buffers by size
+    mutable std::map<size_t, std::vector<unsigned char*> > blocks;
+    //!Storage of released mat headers
+    mutable std::vector<void*> headers;
+    mutable size_t idle = 0;
+    mutable size_t idlebytes = 0;
+    mutable std::atomic<unsigned long> hits{0};
+    mutable std::atomic<unsigned long> misses{0};
+};
+
+//! Recycles encoded frames once nobody references them anymore
+/*!
+The pool keeps a reference to every frame it handed out. A frame whose
+only remaining reference is the pool's has been sent to every client
+and is handed out again with its jpeg vector and header string keeping
+their capacity, so neither the shared pointer nor the buffers allocate
+*/
+class MjpgFramePool
+{
+public:
+    //! Create a pool keeping up to limit frames
+    MjpgFramePool(size_t limit = 256) : limit(limit) {}
+
+    //! Get a frame nobody else references
+    /*!
+    @return a writable frame, its old contents are left in place
+    */
+    std::shared_ptr<MjpgFrame> acquire(void);
+
+    //! Never hand a frame or the one it reuses out again
+    /*!
+    For frames the kernel may still read after their client is gone, they
+    are freed once the last reference drops instead of being rewritten
+
+    @param frame the frame to drop from the pool
+    */
+    void forget(const MjpgFramePtr &);
+
+    //! Get the hit and miss counters
+    MjpgPoolStats stats(void);
+
+private:
+    const size_t limit;
+    boost::mutex mutex;
+    std::vector<std::shared_ptr<MjpgFrame> > frames;
+    //!Where the next search starts so the oldest frames are checked first
+    size_t next = 0;
+    std::atomic<unsigned long> hits{0};
+    std::atomic<unsigned long> misses{0};
+};
+
+//! Free list of reusable heap objects
+/*!
+T must have a reset() that drops what the object references while
+keeping its capacity. Objects are handed out wrapped in a handle that
+returns them here instead of deleting them
+*/
+template<typename T>
+class MjpgObjectPool
+{
+public:
+    //! Sends an object back to its pool
+    struct recycler
+    {
+        MjpgObjectPool *pool;
+        void operator()(T *item) const { this->pool->give(item); }
+    };
+
+    typedef std::unique_ptr<T, recycler> handle;
+
+    MjpgObjectPool(const std::string &name) : name(name) {}
+
+    ~MjpgObjectPool()
+    {
+        for(size_t i = 0; i < this->items.size(); i++) delete this->items[i];
+    }
+
+    //! Get a reset object
+    handle take()
+    {
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            if(!this->items.empty())
+            {
+                T *item = this->items.back();
+                this->items.pop_back();
+                this->hits++;
+                return this->wrap(item);
+            }
+        }
+        this->misses++;
+        return this->wrap(new T());
+    }
+
+    //! Take charge of an object that was released from a handle
+    handle wrap(T *item)
+    {
+        recycler back = { this };
+        return handle(item, back);
+    }
+
+    //! Reset an object and keep it for the next take
+    void give(T *item)
+    {
+        if(!item) return;
+        item->reset();
+        boost::mutex::scoped_lock l(this->mutex);
+        this->items.push_back(item);
+    }
+
+    //! Get the hit and miss counters
+    MjpgPoolStats stats()
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        MjpgPoolStats current = { this->name, this->hits.load(), this->misses.load(), this->items.size(), this->items.size() * sizeof(T) };
+        return current;
+    }
+
+private:
+    const std::string name;
+    boost::mutex mutex;
+    std::vector<T*> items;
+    std::atomic<unsigned long> hits{0};
+    std::atomic<unsigned long> misses{0};
+};
+
+#endif  // MJPGPOOL_H_
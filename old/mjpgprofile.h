@@ -0,0 +1,105 @@
+/**
+    CS-11 Format
+    File: mjpgprofile.h
+    Purpose: Per resolution/quality renditions of the stream shared by their viewers
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGPROFILE_H_
+#define MJPGPROFILE_H_
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <sstream>
+#include <tuple>
+#include "mjpgchannel.h"
+
+//! The output size and jpeg quality a client wants the stream in
+/*!
+Any value left at -1 is unregulated just like setResolution() and
+setQuality() so a default rendition sends the frame as it was pulled
+*/
+struct MjpgRendition
+{
+    int width = -1;
+    int height = -1;
+    int quality = -1;
+
+    //!Encode in this many parallel strips (below 2 encodes in one piece)
+    int strips = -1;
+
+    //! Equal for every client asking for the same output, compared per frame so it never allocates
+    bool operator==(const MjpgRendition &other) const
+    {
+        return this->fields() == other.fields();
+    }
+
+    bool operator!=(const MjpgRendition &other) const
+    {
+        return !(*this == other);
+    }
+
+    //! Orders renditions to key the profiles of a source
+    bool operator<(const MjpgRendition &other) const
+    {
+        return this->fields() < other.fields();
+    }
+
+    //! Readable name of the output for the log
+    std::string name() const
+    {
+        std::stringstream id;
+        id << this->width << "x" << this->height << "q" << this->quality;
+        if(this->strips > 1) id << "s" << this->strips;
+        return id.str();
+    }
+
+private:
+    //!What tells outputs apart, any strips below 2 encode in one piece alike
+    std::tuple<int, int, int, int> fields() const
+    {
+        return std::make_tuple(this->width, this->height, this->quality, this->strips > 1 ? this->strips : 1);
+    }
+};
+
+//! One encoded version of the stream
+/*!
+Every distinct rendition that has viewers is resized and encoded once per
+pulled frame and published to its own channel. Viewers hold the profile
+alive through a shared pointer so it goes away with its last viewer
+*/
+class MjpgProfile
+{
+public:
+    MjpgProfile(const MjpgRendition &rendition) : rendition(rendition) {}
+
+    //!What this profile encodes to
+    const MjpgRendition rendition;
+
+    //!Where the encoded frames of this profile are published
+    MjpgChannel channel;
+
+    //!The last frame actually encoded and the rendition it was encoded as (only touched by the encode stage)
+    std::shared_ptr<const MjpgFrame> encoded;
+    MjpgRendition encodedas;
+};
+
+//!Shared handle that keeps a profile encoding while held
+typedef std::shared_ptr<MjpgProfile> MjpgProfilePtr;
+
+#endif  // MJPGPROFILE_H_
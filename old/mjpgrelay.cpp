@@ -0,0 +1,358 @@
+/**
+    CS-11 Format
+    File: mjpgrelay.cpp
+    Purpose: Republishes the jpegs of an upstream mjpeg stream or of jpeg files without decoding them
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "mjpgrelay.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+//!Largest amount buffered while looking for a frame before the upstream counts as broken
+static const size_t maxpending = 32 * 1024 * 1024;
+
+MjpgRelay::MjpgRelay(const std::string &location)
+    : location(location), remote(location.compare(0, 7, "http://") == 0)
+{
+    if(!this->remote) return;
+    std::string rest = location.substr(7);
+    size_t slash = rest.find('/');
+    if(slash != std::string::npos)
+    {
+        this->path = rest.substr(slash);
+        rest = rest.substr(0, slash);
+    }
+    size_t colon = rest.find(':');
+    if(colon != std::string::npos)
+    {
+        this->port = rest.substr(colon + 1);
+        rest = rest.substr(0, colon);
+    }
+    this->host = rest;
+}
+
+MjpgRelay::~MjpgRelay()
+{
+    this->disconnect();
+    this->unmap();
+}
+
+void MjpgRelay::setTimeout(int milliseconds)
+{
+    this->timeout = milliseconds;
+}
+
+bool MjpgRelay::next(std::vector<unsigned char> &jpeg)
+{
+    return this->remote ? this->nextPart(jpeg) : this->nextFile(jpeg);
+}
+
+bool MjpgRelay::connect()
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if(getaddrinfo(this->host.c_str(), this->port.c_str(), &hints, &found) != 0 || !found)
+    {
+        std::cerr << "Couldn't resolve relay upstream " << this->host << std::endl;
+        return false;
+    }
+    timeval limit;
+    limit.tv_sec = this->timeout / 1000;
+    limit.tv_usec = (this->timeout % 1000) * 1000;
+    for(addrinfo *address = found; address && this->fd < 0; address = address->ai_next)
+    {
+        this->fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if(this->fd < 0) continue;
+        //A stalled upstream fails the read instead of hanging the capture thread
+        setsockopt(this->fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+        setsockopt(this->fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+        if(::connect(this->fd, address->ai_addr, address->ai_addrlen) != 0) this->disconnect();
+    }
+    freeaddrinfo(found);
+    if(this->fd < 0)
+    {
+        std::cerr << "Couldn't connect to relay upstream " << this->location << std::endl;
+        return false;
+    }
+    std::string request = "GET " + this->path + " HTTP/1.1\r\nHost: " + this->host + "\r\nConnection: close\r\nUser-Agent: MjpgServer relay\r\n\r\n";
+    if(send(this->fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t) request.size())
+    {
+        this->disconnect();
+        return false;
+    }
+    this->pending.clear();
+    this->used = 0;
+    static const char ending[] = "\r\n\r\n";
+    std::vector<unsigned char>::iterator headers;
+    while((headers = std::search(this->pending.begin(), this->pending.end(), ending, ending + 4)) == this->pending.end())
+    {
+        if(this->pending.size() > 65536 || !this->fill(true))
+        {
+            std::cerr << "Relay upstream " << this->location << " sent no response" << std::endl;
+            this->disconnect();
+            return false;
+        }
+    }
+    std::string response(this->pending.begin(), headers);
+    std::string status = response.substr(0, response.find('\r'));
+    if(status.find(" 200") == std::string::npos)
+    {
+        std::cerr << "Relay upstream " << this->location << " answered " << status << std::endl;
+        this->disconnect();
+        return false;
+    }
+    std::transform(response.begin(), response.end(), response.begin(), ::tolower);
+    if(response.find("transfer-encoding: chunked") != std::string::npos)
+    {
+        std::cerr << "Relay upstream " << this->location << " sends chunked bodies which can't be relayed" << std::endl;
+        this->disconnect();
+        return false;
+    }
+    this->used = (headers - this->pending.begin()) + 4; //Parts start after the response headers
+    return true;
+}
+
+void MjpgRelay::disconnect()
+{
+    if(this->fd >= 0) close(this->fd);
+    this->fd = -1;
+}
+
+bool MjpgRelay::fill(bool wait)
+{
+    if(this->used > 0)
+    {
+        this->pending.erase(this->pending.begin(), this->pending.begin() + this->used); //Keeps the capacity
+        this->used = 0;
+    }
+    size_t had = this->pending.size();
+    this->pending.resize(had + 65536);
+    ssize_t got = recv(this->fd, &this->pending[had], 65536, wait ? 0 : MSG_DONTWAIT);
+    this->pending.resize(had + (got > 0 ? got : 0));
+    return got > 0;
+}
+
+bool MjpgRelay::nextPart(std::vector<unsigned char> &jpeg)
+{
+    if(this->fd < 0 && !this->connect()) return false;
+    bool found = false;
+    while(1)
+    {
+        const unsigned char *data = this->pending.data() + this->used;
+        size_t length = this->pending.size() - this->used;
+        size_t start = 0;
+        size_t end = 0;
+        //The part headers before the jpeg usually say how long it is, which saves walking it
+        const unsigned char soi[3] = {0xFF, 0xD8, 0xFF};
+        const unsigned char *image = std::search(data, data + length, soi, soi + 3);
+        std::string headers(data, image);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        size_t declared = headers.rfind("content-length:");
+        bool complete = false;
+        if(image != data + length && declared != std::string::npos)
+        {
+            start = image - data;
+            end = start + strtoul(headers.c_str() + declared + 15, nullptr, 10);
+            complete = end <= length && end >= start + 4 && data[end - 2] == 0xFF && data[end - 1] == 0xD9;
+        }
+        if(!complete) complete = MjpgRelay::find(data, length, start, end);
+        if(complete)
+        {
+            jpeg.assign(data + start, data + end);
+            this->used += end;
+            found = true;
+            continue; //Skip ahead to the newest frame already buffered
+        }
+        if(found && !this->fill(false)) return true; //Nothing newer has arrived
+        if(found) continue;
+        if(length > maxpending || !this->fill(true))
+        {
+            std::cerr << "Relay upstream " << this->location << " stopped sending frames" << std::endl;
+            this->disconnect();
+            return false;
+        }
+    }
+}
+
+bool MjpgRelay::map(const std::string &file)
+{
+    int descriptor = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0) return false;
+    struct stat info;
+    if(fstat(descriptor, &info) != 0 || info.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+    void *region = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor); //The mapping keeps the file
+    if(region == MAP_FAILED) return false;
+    madvise(region, info.st_size, MADV_SEQUENTIAL);
+    this->mapped = (const unsigned char*) region;
+    this->mappedlength = info.st_size;
+    this->offset = 0;
+    return true;
+}
+
+void MjpgRelay::unmap()
+{
+    if(this->mapped) munmap((void*) this->mapped, this->mappedlength);
+    this->mapped = nullptr;
+    this->mappedlength = 0;
+    this->offset = 0;
+}
+
+bool MjpgRelay::nextFile(std::vector<unsigned char> &jpeg)
+{
+    if(this->files.empty())
+    {
+        DIR *directory = opendir(this->location.c_str());
+        if(directory)
+        {
+            while(dirent *entry = readdir(directory))
+            {
+                std::string name = entry->d_name;
+                std::string extension = name.substr(name.find_last_of('.') == std::string::npos ? name.size() : name.find_last_of('.'));
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+                if(extension == ".jpg" || extension == ".jpeg") this->files.push_back(this->location + "/" + name);
+            }
+            closedir(directory);
+            std::sort(this->files.begin(), this->files.end());
+        }
+        else this->files.push_back(this->location);
+    }
+    //Every file gets one chance per call so a folder without a single jpeg can't spin forever
+    for(size_t tries = 0; tries <= this->files.size(); tries++)
+    {
+        size_t start = 0;
+        size_t end = 0;
+        if(this->mapped && MjpgRelay::find(this->mapped + this->offset, this->mappedlength - this->offset, start, end))
+        {
+            jpeg.assign(this->mapped + this->offset + start, this->mapped + this->offset + end);
+            this->offset += end;
+            return true;
+        }
+        if(this->mapped && this->files.size() == 1)
+        {
+            this->offset = 0; //Loop a single file without mapping it again
+            continue;
+        }
+        this->unmap();
+        const std::string &file = this->files[this->nextfile++ % this->files.size()];
+        if(!this->map(file)) std::cerr << "Couldn't map relay file " << file << std::endl;
+    }
+    return false;
+}
+
+bool MjpgRelay::find(const unsigned char *data, size_t length, size_t &start, size_t &end)
+{
+    for(start = 0; start + 4 <= length; start++)
+    {
+        const unsigned char *marker = (const unsigned char*) memchr(data + start, 0xFF, length - start);
+        if(!marker) return false;
+        start = marker - data;
+        if(start + 4 > length) return false;
+        if(data[start + 1] != 0xD8 || data[start + 2] != 0xFF) continue;
+        size_t at = start + 2;
+        bool valid = true;
+        while(valid)
+        {
+            if(at + 2 > length) return false;
+            if(data[at] != 0xFF)
+            {
+                valid = false;
+                break;
+            }
+            unsigned char type = data[at + 1];
+            if(type == 0xFF)
+            {
+                at++; //Fill byte
+                continue;
+            }
+            if(type == 0xD9)
+            {
+                end = at + 2;
+                return true;
+            }
+            if(type == 0x01 || (type >= 0xD0 && type <= 0xD8))
+            {
+                at += 2; //Markers without a segment
+                continue;
+            }
+            if(at + 4 > length) return false;
+            size_t segment = ((size_t) data[at + 2] << 8) | data[at + 3];
+            if(segment < 2)
+            {
+                valid = false;
+                break;
+            }
+            at += 2 + segment;
+            if(type != 0xDA) continue;
+            //Entropy coded data only ever has 0xFF followed by a stuffed zero or a restart marker
+            while(1)
+            {
+                if(at >= length) return false;
+                const unsigned char *next = (const unsigned char*) memchr(data + at, 0xFF, length - at);
+                if(!next || next + 1 >= data + length) return false;
+                at = next - data;
+                unsigned char following = next[1];
+                if(following == 0x00 || (following >= 0xD0 && following <= 0xD7)) at += 2;
+                else if(following == 0xFF) at++;
+                else break;
+            }
+        }
+    }
+    return false;
+}
+
+bool MjpgRelay::dimensions(const unsigned char *data, size_t length, int &width, int &height)
+{
+    size_t at = 2;
+    while(at + 9 <= length && data[at] == 0xFF)
+    {
+        unsigned char type = data[at + 1];
+        if(type == 0xFF)
+        {
+            at++;
+            continue;
+        }
+        if(type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC)
+        {
+            height = (data[at + 5] << 8) | data[at + 6];
+            width = (data[at + 7] << 8) | data[at + 8];
+            return true;
+        }
+        if(type == 0xDA || type == 0xD9) return false;
+        at += 2 + (((size_t) data[at + 2] << 8) | data[at + 3]);
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+/**
+    CS-11 Format
+    File: mjpgrelay.h
+    Purpose: Republishes the jpegs of an upstream mjpeg stream or of jpeg files without decoding them
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MJPGRELAY_H_
+#define MJPGRELAY_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//! Reads whole jpegs out of an mjpeg stream or files as they are
+/*!
+An http url is requested and its multipart/x-mixed-replace body split
+into parts, using the part's Content-Length when it has one and
+otherwise walking the jpeg's markers to its end. When more than one
+frame is already buffered only the newest is handed out so a slow reader
+never falls behind the upstream. A directory is played back as its
+.jpg/.jpeg files in name order and any other path as a file of one or
+more concatenated jpegs (or a recorded multipart stream), both memory
+mapped and looped forever. Only ever use a relay from one thread, the
+source's capture thread
+*/
+class MjpgRelay
+{
+public:
+    //! Create a relay of an url, a directory or a file
+    /*!
+    Nothing is opened before the first frame is asked for
+
+    @param location an http:// url, a directory of jpegs or a file of jpegs
+    */
+    MjpgRelay(const std::string &);
+    ~MjpgRelay();
+
+    //! Read the next whole jpeg
+    /*!
+    Blocks until an upstream frame arrived or the read timed out. After a
+    failure the next call reconnects or reopens
+
+    @param jpeg filled with the jpeg's bytes (its capacity is reused)
+    @return false when nothing could be read
+    */
+    bool next(std::vector<unsigned char> &);
+
+    //! Set how long an upstream may stay silent before it counts as failed
+    /*!
+    @param milliseconds connect and read timeout
+    */
+    void setTimeout(int);
+
+    //! Find the first complete jpeg in a buffer
+    /*!
+    Segment lengths are followed up to the scan so embedded thumbnails
+    don't end it early, data that isn't a valid jpeg is skipped
+
+    @param data the buffer
+    @param length its size
+    @param start set to the offset of the jpeg's start of image marker
+    @param end set to the offset right after its end of image marker
+    @return false when there's no complete jpeg (yet)
+    */
+    static bool find(const unsigned char *, size_t, size_t &, size_t &);
+
+    //! Read the size of a jpeg out of its frame header
+    /*!
+    @param data the jpeg
+    @param length its size
+    @param width set to the width in pixels
+    @param height set to the height in pixels
+    @return false when there's no frame header
+    */
+    static bool dimensions(const unsigned char *, size_t, int &, int &);
+
+private:
+    bool connect(void);
+    void disconnect(void);
+    //!Appends what the socket has, blocking for at least one byte unless told not to wait
+    bool fill(bool);
+    bool nextPart(std::vector<unsigned char> &);
+    bool nextFile(std::vector<unsigned char> &);
+    bool map(const std::string &);
+    void unmap(void);
+
+    const std::string location;
+    const bool remote;
+    int timeout = 5000;
+    //!Parsed from an http url
+    std::string host;
+    std::string port = "80";
+    std::string path = "/";
+    int fd = -1;
+    //!Bytes read but not handed out yet, starting at used
+    std::vector<unsigned char> pending;
+    size_t used = 0;
+    //!Files played back in order and the one mapped at the moment
+    std::vector<std::string> files;
+    size_t nextfile = 0;
+    const unsigned char *mapped = nullptr;
+    size_t mappedlength = 0;
+    size_t offset = 0;
+};
+
+#endif  // MJPGRELAY_H_
@@ -0,0 +1,161 @@
+/**
+    CS-11 Format
+    File: mjpgring.h
+    Purpose: Bounded lock-free single producer/consumer queue between pipeline stages
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGRING_H_
+#define MJPGRING_H_
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+//! Lock-free hand off between two pipeline stage threads
+/*!
+Exactly one thread pushes and exactly one thread pops. Pushing never
+blocks: once the ring is full the oldest waiting item is overwritten and
+counted as dropped, so a slow stage always works on the freshest frame.
+Items are owned by the ring while queued and must carry an increasing
+seq member, the consumer uses it to throw away anything that got
+overtaken by a newer item while the producer was overwriting.
+The mutex is only ever taken to put an idle consumer to sleep. Items
+the ring throws away go to the dispose function, delete by default.
+*/
+template<typename T>
+class MjpgRing
+{
+public:
+    //! Create a ring holding at most depth items
+    MjpgRing(size_t depth, std::function<void(T*)> dispose = std::default_delete<T>())
+        : capacity(depth > 0 ? depth : 1), slots(new std::atomic<T*>[depth > 0 ? depth : 1]), dispose(dispose)
+    {
+        for(size_t i = 0; i < this->capacity; i++) this->slots[i].store(nullptr);
+    }
+
+    ~MjpgRing()
+    {
+        for(size_t i = 0; i < this->capacity; i++)
+        {
+            T *left = this->slots[i].exchange(nullptr);
+            if(left) this->dispose(left);
+        }
+    }
+
+    //! Queue an item (producer thread only)
+    /*!
+    @param item heap item the ring takes ownership of
+    */
+    void push(T *item)
+    {
+        unsigned long h = this->head.load(std::memory_order_relaxed);
+        T *old = this->slots[h % this->capacity].exchange(item, std::memory_order_acq_rel);
+        this->head.store(h + 1, std::memory_order_seq_cst);
+        if(old)
+        {
+            this->drops++; //Consumer fell a whole ring behind, the oldest frame goes
+            this->dispose(old);
+        }
+        if(this->sleeping.load(std::memory_order_seq_cst))
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            this->wake.notify_one();
+        }
+    }
+
+    //! Take the oldest item (consumer thread only)
+    /*!
+    @return an item the caller now owns or nullptr when empty
+    */
+    T *pop()
+    {
+        while(true)
+        {
+            unsigned long t = this->tail.load(std::memory_order_relaxed);
+            unsigned long h = this->head.load(std::memory_order_acquire);
+            if(t == h) return nullptr;
+            if(h - t > this->capacity) t = h - this->capacity; //Those positions were overwritten
+            T *item = this->slots[t % this->capacity].exchange(nullptr, std::memory_order_acq_rel);
+            this->tail.store(t + 1, std::memory_order_release);
+            if(!item) continue;
+            if(item->seq <= this->last)
+            {
+                this->drops++; //Older than something already handed out
+                this->dispose(item);
+                continue;
+            }
+            this->last = item->seq;
+            return item;
+        }
+    }
+
+    //! Take the oldest item sleeping up to timeout while empty (consumer thread only)
+    /*!
+    @param timeout longest time to sleep
+    @return an item the caller now owns or nullptr if nothing arrived
+    */
+    T *waitPop(std::chrono::milliseconds timeout)
+    {
+        T *item = this->pop();
+        if(item) return item;
+        boost::mutex::scoped_lock l(this->mutex);
+        this->sleeping.store(true, std::memory_order_seq_cst);
+        item = this->pop(); //A push may have landed before we said we were sleeping
+        if(!item)
+        {
+            this->wake.wait_for(l, boost::chrono::milliseconds(timeout.count()));
+            item = this->pop();
+        }
+        this->sleeping.store(false, std::memory_order_seq_cst);
+        return item;
+    }
+
+    //!Items currently waiting
+    size_t depth() const
+    {
+        unsigned long h = this->head.load(std::memory_order_acquire);
+        unsigned long t = this->tail.load(std::memory_order_acquire);
+        if(t >= h) return 0;
+        return h - t > this->capacity ? this->capacity : h - t;
+    }
+
+    //!Items thrown away because the consumer was too slow
+    unsigned long dropped() const
+    {
+        return this->drops.load();
+    }
+
+private:
+    const size_t capacity;
+    std::unique_ptr<std::atomic<T*>[]> slots;
+    const std::function<void(T*)> dispose;
+    std::atomic<unsigned long> head{0};
+    std::atomic<unsigned long> tail{0};
+    std::atomic<unsigned long> drops{0};
+    //!Sequence of the last item popped, only touched by the consumer
+    unsigned long last = 0;
+    std::atomic<bool> sleeping{false};
+    boost::mutex mutex;
+    boost::condition_variable wake;
+};
+
+#endif  // MJPGRING_H_
@@ -22,73 +22,101 @@
     OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include "mjpgserver.h"
+#include <pthread.h>
+#include <sched.h>
 
 MjpgServer::MjpgServer(int port)
 {
     this->port = port;
+    std::stringstream base;
+    base << std::hex << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    this->etagbase = base.str();
+    this->createEncoders();
+    this->registerMetrics();
+    this->primary = std::make_shared<source>(this, "default");
+    this->primary->registerMetrics();
+    this->sources["default"] = this->primary;
 }
 
 MjpgServer::~MjpgServer()
 {
     std::cout << "Dismounting " << this->name << " server!";
-    this->unint(); //Call the users soft unmount code
+    boost::mutex::scoped_lock l(this->sources_mutex);
+    for(std::map<std::string, source_ptr>::iterator it = this->sources.begin(); it != this->sources.end(); ++it)
+        if(it->second->unint) it->second->unint(); //Call the users soft unmount code
 }
 
-void MjpgServer::attach(cv::Mat (*pullframe)(void))
+void MjpgServer::attach(std::function<cv::Mat(void)> pullframe)
 {
-    this->pullframe = pullframe; //Look at mainloop
+    this->primary->pullframe = pullframe; //Look at mainloop
+    this->primary->pullinto = nullptr;
+}
+
+bool MjpgServer::publish(cv::Mat &&frame)
+{
+    return this->primary->push(std::move(frame), std::vector<unsigned char>());
+}
+
+bool MjpgServer::publishEncoded(std::vector<unsigned char> &&jpeg)
+{
+    return this->primary->push(cv::Mat(), std::move(jpeg));
 }
 
 void MjpgServer::setCapAttach(int value) //Set physical device pull with safety
 {
-    this->cap.open(value);
-    boost::this_thread::sleep_for(boost::chrono::milliseconds(250)); //Keeps from overreading
-    this->capattach_in(); //Call default attach method
+    this->primary->openCapture(boost::lexical_cast<std::string>(value));
 }
 
 void MjpgServer::setCapAttach(std::string value) //Set stream to pull from
 {
-    this->cap.open(value);
-    boost::this_thread::sleep_for(boost::chrono::milliseconds(250));
-    this->capattach_in();
+    this->primary->openCapture(value);
+}
+
+void MjpgServer::setRelayAttach(std::string location)
+{
+    this->primary->openRelay(location);
+}
+
+void MjpgServer::setShmAttach(std::string ring)
+{
+    this->primary->openShm(ring);
 }
 
 void MjpgServer::setQuality(int quality)
 {
-    this->quality = quality;
+    this->primary->quality = quality;
 }
 
 int MjpgServer::getQuality()
 {
-    return this->quality;
+    return this->primary->quality;
 }
 
 void MjpgServer::setFPS(int fps)
 {
-    this->controlfps = fps;
+    this->primary->controlfps = fps;
 }
 
 int MjpgServer::getFPS()
 {
-    boost::mutex::scoped_lock l(this->global_mutex);
-    return this->fps;
+    return this->primary->getFPS();
 }
 
 void MjpgServer::setResolution(int width, int height)
 {
-    this->resized[0] = width;
-    this->resized[1] = height;
+    this->primary->resized[0] = width;
+    this->primary->resized[1] = height;
 }
 
 int* MjpgServer::getResolution()
 {
-    return this->resized;
+    return this->primary->resized;
 }
 
 void MjpgServer::setSettle(int fps)
 {
-    this->settlefps = fps;
-    std::cout << "New settle fps: " << this->settlefps << std::endl;
+    this->primary->settlefps = fps;
+    std::cout << "New settle fps: " << fps << std::endl;
 }
 
 void MjpgServer::setMaxConnections(int connections)
@@ -106,47 +134,9 @@ int MjpgServer::getConnections()
     return this->connections;
 }
 
-void MjpgServer::capattach_in()
-{
-    int tries = 0;
-    while(!cap.isOpened()) {
-        if(tries++ > this->maxfailpackets) break;
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-    } //Make sure we are connected before continuing
-    this->setSettle((int) cap.get(cv::CAP_PROP_FPS));
-    const auto proc = [this]() -> cv::Mat
-    {
-        cv::Mat frame;
-        try {
-            if(!this->cap.read(frame)) return frame;
-        }
-        catch (std::exception& err)
-        {
-            std::cerr << "Overread on stream" << std::endl;
-        }
-        return frame;
-    };
-    const auto deproc = [this]() -> void
-    {
-        try {
-            this->cap.release();
-        }
-        catch(cv::Exception& err)
-        {
-            std::cerr << "Release capture error: " << err.what() << std::endl;
-        }
-    };
-    static auto static_proc = proc;
-    static auto static_deproc = deproc;
-    cv::Mat (*ptr) () = []() -> cv::Mat { return static_proc(); }; //Create the captured lambdas into function pointers
-    void (*dptr) () = []() -> void { return static_deproc(); };
-    this->attach(ptr);
-    this->detacher(dptr);
-}
-
 void MjpgServer::detacher(void (*detacher)(void))
 {
-    this->unint = detacher;
+    this->primary->unint = detacher;
 }
 
 void MjpgServer::setName(std::string new_name)
@@ -154,616 +144,2451 @@ void MjpgServer::setName(std::string new_name)
     this->name = new_name;
 }
 
-std::string MjpgServer::convertString()
+void MjpgServer::addSource(std::string name, std::function<cv::Mat(void)> pullframe)
 {
-    std::vector<uchar> buff;
-    if(this->resized[0] > 0)
-    {
-        cv::resize(this->curframe, this->curframe, cv::Size(this->resized[0], this->resized[1]), 0, 0, cv::INTER_LINEAR); // If resize then do so
-    }
-
-    if(this->quality > -1) //If specified quality then do so
-    {
-        std::vector<int> compression_params;
-        compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
-        compression_params.push_back(this->quality);
-        cv::imencode(".jpg", this->curframe, buff, compression_params);
-    }
-    else
-    {
-        cv::imencode(".jpg", this->curframe, buff);
-    }
-    std::string content(buff.begin(), buff.end());
-    return content;
+    this->createSource(name, [pullframe](source &added) { added.pullframe = pullframe; });
 }
 
-void MjpgServer::handleJpg(asio::ip::tcp::socket &socket)
+void MjpgServer::addCaptureSource(std::string name, std::string capture)
 {
-    boost::mutex mutex;
-    std::cout << "Client requested single image!" << std::endl;
-    boost::mutex::scoped_lock l(mutex);
-    this->connections += 1;
-    try
-    {
-        this->curframe = this->pullframe();
-        std::string content = this->convertString();
-        std::stringstream response;
-        response << "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nServer: " << this->host_name;
-        response << "\r\nContent-Length: " << content.length() << "\r\n\r\n" << content;
-        if(!sendresponse(socket, response.str())) throw std::invalid_argument("send error");
-    }
-    catch(std::exception& err)
-    {
-        std::cerr << "Error sending image to client!" << std::endl;
-        std::string resp = "<p>Failed sending image</p>";
-        sendError(socket, resp);
-    }
-    this->connections -= 1;
+    this->createSource(name, [capture](source &added) { added.openCapture(capture); });
 }
 
-void MjpgServer::mainPullLoop()
+void MjpgServer::addRelaySource(std::string name, std::string location)
 {
-    boost::mutex mutex;
-
-    mutex.lock();
-    this->pullcap = true;
-    mutex.unlock();
+    this->createSource(name, [location](source &added) { added.openRelay(location); });
+}
 
-    for(int test = 0; test < 3; test++)
-    {
-        mutex.lock();
-        try
-        {
-            this->pullframe();
-        }
-        catch(std::exception& err) {}
-        mutex.unlock();
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
-    }
+void MjpgServer::addShmSource(std::string name, std::string ring)
+{
+    this->createSource(name, [ring](source &added) { added.openShm(ring); });
+}
 
-    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
-    std::chrono::high_resolution_clock::time_point now = start;
-    while(1)
-    {
-        now = std::chrono::high_resolution_clock::now();
-        float delta = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-        start = now;
-        float timepoint = 1000 / (float) (this->settlefps > 0) ?
-                          this->settlefps : (this->controlfps > 0) ?
-                          this->controlfps : 1000;
-        int sleepoint = 2;
-        if(delta < timepoint)
-        {
-            sleepoint = (((int) (timepoint - delta)) * 2) - 3;
-        }
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(sleepoint));
-        mutex.lock();
-        try
-        {
-            this->curframe = this->pullframe();
-            if(!this->curframe.empty())
-                this->content = this->convertString();
-        }
-        catch(std::exception& pullerror) {
-            std::cerr << "Image pull error: " << pullerror.what() << std::endl;
-        }
-        mutex.unlock();
-    }
-    mutex.lock();
-    this->pullcap = false;
-    mutex.unlock();
+void MjpgServer::addPushSource(std::string name)
+{
+    this->createSource(name, std::function<void(source &)>());
 }
 
-void MjpgServer::handleMjpg(asio::ip::tcp::socket &socket)
+void MjpgServer::createSource(const std::string &name, std::function<void(source &)> open)
 {
-    //Tell client mjpg stream is going to be sent
-    std::stringstream respcompile;
-    respcompile << "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=";
-    respcompile << this->boundary << "\r\nServer: " << this->host_name;
-    respcompile << "\r\n\r\n";
-    std::string initresponse = respcompile.str();
-    boost::mutex mutex;
-    this->connections += 1;
-    if(!sendresponse(socket, initresponse))
     {
-        std::cerr << "Failed to initiate stream with client... removing client" << std::endl;
-        return;
+        boost::mutex::scoped_lock l(this->sources_mutex);
+        if(this->sources.count(name) || !this->opening.insert(name).second)
+        {
+            std::cerr << "Source " << name << " already exists" << std::endl;
+            return;
+        }
     }
-    else
-        std::cout << "Client connected to stream!" << std::endl;
-    long failcount = 0;
-    static int frames = 0;
-    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
-
-    if(!this->pullcap)
+    //Opening can wait on a camera, the name stays taken without holding up lookups meanwhile
+    source_ptr added;
+    try
     {
-        boost::thread(boost::bind(&MjpgServer::mainPullLoop, this));
+        added = std::make_shared<source>(this, name);
+        if(open) open(*added);
     }
-
-    std::chrono::high_resolution_clock::time_point point = std::chrono::high_resolution_clock::now();
-    std::chrono::high_resolution_clock::time_point now = point;
-    while(1) // Loop forever
+    catch(...)
     {
-        try
-        {
-            int sleepint = 2; //Default sleep when target not specified
-            {
-                //scoped lock without delay
-                boost::mutex::scoped_lock l(mutex);
-                if(this->content.length() < 3)  //this->curframe.empty()) {
-                {
-                    boost::this_thread::sleep_for(boost::chrono::milliseconds(2));
-                    continue;
-                }
-                std::stringstream response;
-                response << this->boundary << "\r\nContent-Type: image/jpeg\r\nContent-Length: " << this->content.length() << "\r\n\r\n" << this->content;
-                if(!sendresponse(socket, response.str()))
-                {
-                    if(failcount++ > this->maxfailpackets) break;
-                }
-                now = std::chrono::high_resolution_clock::now();
-                float delta = std::chrono::duration_cast<std::chrono::milliseconds>(now - point).count();
-                point = now;
-                float timepoint = 1000.0f / (float) this->controlfps;
-                if(delta < timepoint && this->controlfps > 0)
-                {
-                    sleepint = (((int) (timepoint - delta)) * 2);
-                }
-                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-                frames++;
-                if(duration > 250 && frames > this->samplefps)
-                {
-                    this->fps = (float) ((frames * 1000) / duration);
-                    start = now;
-                    frames = 0;
-                }
-            }
-            boost::this_thread::sleep_for(boost::chrono::milliseconds(sleepint));
-        }
-        catch(cv::Exception& err)
-        {
-            std::cout << "CV ERROR: " << err.what() << std::endl;
-        }
-        catch(std::exception& err)
-        {
-            std::cout << "Client disconnect" << std::endl;
-            break;
-        }
+        boost::mutex::scoped_lock l(this->sources_mutex);
+        this->opening.erase(name);
+        throw;
     }
-    this->connections -= 1;
+    added->registerMetrics(); //Only sources that opened are ever scraped, they live as long as the server
+    boost::mutex::scoped_lock l(this->sources_mutex);
+    this->opening.erase(name);
+    this->sources[name] = added;
 }
 
-void MjpgServer::handleHtml(asio::ip::tcp::socket &socket, std::string& root) //Look at onAccept
+bool MjpgServer::publish(std::string name, cv::Mat &&frame)
 {
-    boost::mutex mutex;
-    boost::mutex::scoped_lock l(mutex);
-    std::stringstream p_con;
-    p_con << "<html><head></head><body><img src=\"" << root << "\"/></body></html>";
-    std::string main_content = p_con.str();
-    std::stringstream content;
-    content << "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " << main_content.length();
-    content << "\r\nServer: " << this->host_name;
-    content << "\r\n\r\n" << main_content;
-    sendresponse(socket, content.str());
+    source_ptr cam = this->findSource(name);
+    if(!cam) return false;
+    return cam->push(std::move(frame), std::vector<unsigned char>());
 }
 
-void MjpgServer::sendSimple(asio::ip::tcp::socket &socket, std::string& simple) //Look at onAccept
+bool MjpgServer::publishEncoded(std::string name, std::vector<unsigned char> &&jpeg)
 {
-    std::stringstream content;
-    content << "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " << simple.length();
-    content << "\r\nServer: " << this->host_name;
-    content << "\r\n\r\n" << simple;
-    sendresponse(socket, content.str());
+    source_ptr cam = this->findSource(name);
+    if(!cam) return false;
+    return cam->push(cv::Mat(), std::move(jpeg));
 }
 
-void MjpgServer::onAccept(asio::ip::tcp::socket &socket) //Look at onAccept
+std::vector<std::string> MjpgServer::getSources()
 {
-    boost::mutex mutex;
-
-    while(1)
-    {
-        std::string httprequest;
-        std::vector<std::string> reqs;
-        std::map<std::string, std::string> headers;
-        try
-        {
-            httprequest = this->readrequest(socket);
-            if(httprequest == this->badread) throw std::invalid_argument("bad read");
-            headers = this->parseheaders(httprequest);
-            reqs = typeReq(httprequest);
-        }
-        catch(std::exception& err)
-        {
-            std::cerr << "String parse error" << std::endl;
-            break;
-        }
+    std::vector<std::string> names(1, this->primary->name);
+    boost::mutex::scoped_lock l(this->sources_mutex);
+    for(std::map<std::string, source_ptr>::iterator it = this->sources.begin(); it != this->sources.end(); ++it)
+        if(it->second != this->primary) names.push_back(it->first);
+    return names;
+}
 
-        try
-        {
-            if(reqs[2] != "HTTP/1.1") throw std::invalid_argument("HTTP");
-        }
-        catch(std::exception& err)
-        {
-            std::cerr << "Bad HTTP request" << std::endl;
-            std::string resp = "<p>Request needs to be <b>HTTP/1.1</b></p>";
-            sendError(socket, resp);
-            break;
-        }
+MjpgServer::source_ptr MjpgServer::findSource(const std::string &name)
+{
+    boost::mutex::scoped_lock l(this->sources_mutex);
+    std::map<std::string, source_ptr>::iterator found = this->sources.find(name);
+    return found == this->sources.end() ? source_ptr() : found->second;
+}
 
-        std::string req_type;
-        std::string path;
-        std::string extension;
+void MjpgServer::setSourceFPS(std::string name, int fps)
+{
+    source_ptr cam = this->findSource(name);
+    if(cam) cam->controlfps = fps;
+    else std::cerr << "No source named " << name << std::endl;
+}
 
-        try
-        {
-            req_type = reqs[0];
-            std::stringstream pathgen;
-            pathgen << "http://" << headers["Host"];
-            pathgen << reqs[1];
-            path = pathgen.str();
-            extension = reqs[1];
-        }
-        catch(std::exception& err)
-        {
-            std::cerr << "String parse error" << std::endl;
-            std::string resp = "<p>Request faced internal server error <b>(Couldn't part headers)</b></p>";
-            sendError(socket, resp);
-            continue;
-        }
+void MjpgServer::setSourceQuality(std::string name, int quality)
+{
+    source_ptr cam = this->findSource(name);
+    if(cam) cam->quality = quality;
+    else std::cerr << "No source named " << name << std::endl;
+}
 
-        try
-        {
-            if(extension == "/mjpg")
-            {
-                if(this->maxconnections > 0 && this->connections >= this->maxconnections)
-                {
-                    this->sendError(socket, this->tooManyErr);
-                    break;
-                }
-                try
-                {
-                    this->handleMjpg(socket);
-                }
-                catch(std::exception& mjpgerr)
-                {
-                    std::cerr << "Error handling mjpg stream with client: " << mjpgerr.what() << std::endl;
-                }
-                break;
-            }
-            else if(extension == "/" || extension == "/html")
-            {
-                if(this->maxconnections > 0 && this->connections >= this->maxconnections)
-                {
-                    this->sendError(socket, this->tooManyErr);
-                    break;
-                }
-                try
-                {
-                    std::stringstream mjpgpath;
-                    mjpgpath << "http://" << headers["Host"] << "/mjpg";
-                    std::string newpath(mjpgpath.str());
-                    this->handleHtml(socket, newpath);
-                }
-                catch(std::exception& errsend)
-                {
-                    std::cerr << "Error html request: " << errsend.what() << std::endl;
-                    break;
-                }
-            }
-            else if(extension == "/jpg") //Send single image
-            {
-                try
-                {
-                    this->handleJpg(socket);
-                }
-                catch(std::exception& imageerr)
-                {
-                    std::cerr << "Error jpg send: " << imageerr.what() << std::endl;
-                }
-                break;
-            }
-            else if(extension == "/fps") //REST control fps
-            {
-                std::string tosend;
-                boost::mutex::scoped_lock l(mutex);
-                try
-                {
-                    if(req_type == "GET")
-                    {
-                        std::cout << "Requested to get fps" << std::endl;
-                        std::stringstream ss;
-                        ss << (int) this->fps; //Turn the float to int to string
-                        tosend = ss.str();
-                        this->sendSimple(socket, tosend);
-                    }
-                    else if(req_type == "POST")
-                    {
-                        std::string body = this->getBody(httprequest);
-                        this->controlfps = atoi(body.c_str());
-                        tosend = ""; //Send empty response since it's a simple response
-                        this->sendSimple(socket, tosend);
-                        std::cout << "Requested to set fps to: " << this->controlfps << " Completed" << std::endl;
-                    }
-                    else
-                    {
-                        this->sendError(socket, this->defErr);
-                    }
-                    break;
-                }
-                catch(std::exception& err)
-                {
-                    std::cerr << "Bad request on resolution" << std::endl;
-                    this->sendError(socket, this->defErr);
-                }
-            }
-            else if(extension == "/quality")
-            {
-                std::string tosend;
-                boost::mutex::scoped_lock l(mutex);
-                try
-                {
-                    if(req_type == "GET")
-                    {
-                        std::cout << "Requested to get quality" << std::endl;
-                        std::stringstream ss;
-                        ss << (int) this->quality;
-                        tosend = ss.str();
-                        this->sendSimple(socket, tosend);
-                    }
-                    else if(req_type == "POST")
-                    {
-                        std::string body = this->getBody(httprequest);
-                        this->quality = atoi(body.c_str());
-                        tosend = "";
-                        this->sendSimple(socket, tosend);
-                        std::cout << "Requested to set quality to: " << this->quality << " Completed" << std::endl;
-                    }
-                    else
-                    {
-                        this->sendError(socket, this->defErr);
-                    }
-                    break;
-                }
-                catch(std::exception& err)
-                {
-                    std::cerr << "Bad request on quality" << std::endl;
-                    this->sendError(socket, this->defErr);
-                }
-            }
-            else if(extension == "/connections")
-            {
-                std::string tosend;
-                boost::mutex::scoped_lock l(mutex);
-                try
-                {
-                    if(req_type == "GET")
-                    {
-                        std::cout << "Requested to get connections" << std::endl;
-                        std::stringstream ss;
-                        ss << this->connections;
-                        tosend = ss.str();
-                        this->sendSimple(socket, tosend);
-                    }
-                    else if(req_type == "POST")
-                    {
-                        std::string body = this->getBody(httprequest);
-                        this->maxconnections = atoi(body.c_str());
-                        tosend = "";
-                        this->sendSimple(socket, tosend);
-                        std::cout << "Requested to set max connections to: " << this->maxconnections << " Completed" << std::endl;
-                    }
-                    else
-                    {
-                        this->sendError(socket, this->defErr);
-                    }
-                    break;
-                }
-                catch(std::exception& err)
-                {
-                    std::cerr << "Bad request on connections" << std::endl;
-                }
-            }
-            else if(extension == "/resolution")
-            {
-                std::string tosend;
-                boost::mutex::scoped_lock l(mutex);
-                try
-                {
-                    if(req_type == "GET")
-                    {
-                        std::cout << "Requested to get resolution" << std::endl;
-                        std::stringstream ss;
-                        int width = this->curframe.cols;
-                        int height = this->curframe.rows;
-                        ss << width << "x" << height;
-                        tosend = ss.str();
-                        this->sendSimple(socket, tosend);
-                    }
-                    else if(req_type == "POST")
-                    {
-                        std::string body = this->getBody(httprequest);
-                        std::string dim = body.substr(0, body.find("x"));
-                        this->resized[0] = atoi(dim.c_str());
-                        dim = body.substr(body.find("x") + 1);
-                        this->resized[1] = atoi(dim.c_str());
-                        tosend = "";
-                        this->sendSimple(socket, tosend);
-                        std::cout << "Requested to set resolution to: " << body << " Completed" << std::endl;
-                    }
-                    else
-                    {
-                        this->sendError(socket, this->defErr);
-                    }
-                    break;
-                }
-                catch(std::exception& err)
-                {
-                    std::cerr << "Bad request on resolution" << std::endl;
-                    this->sendError(socket, this->defErr);
-                }
-            }
-            else
-            {
-                std::string resp = "<p>404 Page not found! please use <b>.../mjpg, .../html, .../jpg or controls (fps, quality, resolution)</b></p>";
-                sendError(socket, resp);
-                break;
-            }
-        }
-        catch(std::exception& err)
-        {
-            std::cerr << "Loop error" << std::endl;
-            continue;
-        }
-    }
-    try
-    {
-        socket.close();
-    }
-    catch(std::exception& safetyclose) {}
+void MjpgServer::setSourceStrips(std::string name, int strips)
+{
+    source_ptr cam = this->findSource(name);
+    if(cam) cam->strips = strips;
+    else std::cerr << "No source named " << name << std::endl;
 }
 
-std::map<std::string, std::string> MjpgServer::parseheaders(const std::string response)
+void MjpgServer::setSourceResolution(std::string name, int width, int height)
 {
-    std::map<std::string, std::string> mapper;
-    std::istringstream resp(response);
-    std::string header;
-    std::string::size_type index;
-    while (std::getline(resp, header) && header != "\r")
+    source_ptr cam = this->findSource(name);
+    if(!cam)
     {
-        index = header.find(':', 0);
-        if(index != std::string::npos)
-        {
-            mapper.insert(std::make_pair(
-                              boost::algorithm::trim_copy(header.substr(0, index)),
-                              boost::algorithm::trim_copy(header.substr(index + 1))
-                          ));
-        }
+        std::cerr << "No source named " << name << std::endl;
+        return;
     }
-    return mapper;
+    cam->resized[0] = width;
+    cam->resized[1] = height;
 }
 
-std::string MjpgServer::getBody(std::string &request)
+void MjpgServer::pinSource(std::string name, std::vector<int> cpus)
 {
-    return request.substr(request.find("\r\n\r\n") + 4, request.rfind("\r\n"));
+    source_ptr cam = this->findSource(name);
+    if(cam) cam->cpus = cpus;
+    else std::cerr << "No source named " << name << std::endl;
 }
 
-std::vector<std::string> MjpgServer::typeReq(std::string request)
+std::string MjpgServer::sourceTable()
 {
-    std::vector<std::string> ret;
-
-    try
-    {
-        std::string temp;
-        std::stringstream strings(request);
-        while(strings >> temp) ret.push_back(temp);
-        return ret;
-    }
-    catch(std::exception& err)
+    std::vector<std::string> names = this->getSources();
+    std::stringstream table;
+    for(size_t i = 0; i < names.size(); i++)
     {
-        std::vector<std::string> ret2;
-        ret2.push_back(this->badread);
-        return ret2;
+        source_ptr cam = this->findSource(names[i]);
+        if(!cam) continue;
+        table << cam->name << " " << (int) cam->getFPS() << " ";
+        table << (!cam->running ? "idle" : (cam->suspended ? "suspended" : (cam->failing ? "failing" : "running")));
+        if(this->changethreshold >= 0) table << " " << cam->skipRatio() << "% unchanged";
+        table << "\n";
     }
+    return table.str();
 }
 
-std::string MjpgServer::readrequest(asio::ip::tcp::socket &socket)
+std::shared_ptr<MjpgFrame> MjpgServer::convertString(const cv::Mat &source, const MjpgRendition &rendition)
 {
-    try
-    {
-        asio::streambuf buf;
-        asio::read_until( socket, buf, "\r\n" );
-        std::string data = asio::buffer_cast<const char*>(buf.data());
-        return data;
-    }
-    catch(std::exception& err)
-    {
-        std::cerr << "Request cancelled" << std::endl;
-        return this->badread;
-    }
+    return this->encodeFrame(this->resizeFrame(source, rendition), rendition);
 }
 
-bool MjpgServer::sendresponse(asio::ip::tcp::socket &socket, const std::string& str)
+cv::Mat MjpgServer::resizeFrame(const cv::Mat &source, const MjpgRendition &rendition)
 {
-    try
+    cv::Mat sized = source;
+    if(rendition.width > 0 && rendition.height > 0)
     {
-        const std::string msg = str + "\r\n";
-        asio::write( socket, asio::buffer(msg));
-        return true;
-    }
-    catch(std::exception& err)
-    {
-        std::cerr << "Client write fail, pipe broken" << std::endl;
-        return false;
+        sized = cv::Mat();
+        sized.allocator = &this->resizepool;
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        cv::resize(source, sized, cv::Size(rendition.width, rendition.height), 0, 0, cv::INTER_LINEAR); // If resize then do so without touching the shared source
+        this->resizetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
     }
+    return sized;
 }
 
-void MjpgServer::sendError(asio::ip::tcp::socket & socket, std::string &message)
+std::shared_ptr<MjpgFrame> MjpgServer::encodeFrame(const cv::Mat &sized, const MjpgRendition &rendition, unsigned long captureseq,
+                                                   std::chrono::steady_clock::time_point captured)
 {
-    std::string content = "<html><body><h1>" + this->name + " error:</h1>";
-    std::stringstream bad;
-    bad << "HTTP/1.1 500\r\nContent-Type: text/html\r\nContent-Length: " << (content.length() + message.length()) << "\r\n\r\n" << content << message << "</body></html>\r\n";
-    sendresponse(socket, content);
+    std::shared_ptr<MjpgFrame> encoded = this->encodedpool.acquire(); //Keeps the buffers of a frame every client is done with
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    if(rendition.strips > 1)
+        std::atomic_load(&this->stripencoder)->encode(sized, rendition.quality, rendition.strips, encoded->jpeg);
+    else
+        std::atomic_load(&this->encoder)->encode(sized, rendition.quality, encoded->jpeg);
+    encoded->captureseq = captureseq;
+    encoded->captured = captured;
+    encoded->encoded = std::chrono::steady_clock::now();
+    this->encodetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(encoded->encoded - started).count());
+    this->encodedbytes.record(encoded->jpeg.size());
+    if(captureseq > 0)
+        this->encodedage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(encoded->encoded - captured).count());
+    encoded->seal(this->boundary); //Serialize the part header once for every client
+    return encoded;
 }
 
-void MjpgServer::run(bool threaded_start) {
-    if(threaded_start) {
-        boost::thread t(boost::bind(&MjpgServer::run, this));
-        boost::thread(boost::bind(&MjpgServer::mainPullLoop, this));
-    } else {
-        this->run();
-    }
+std::shared_ptr<MjpgFrame> MjpgServer::wrapFrame(std::vector<unsigned char> &&jpeg, unsigned long captureseq,
+                                                 std::chrono::steady_clock::time_point captured)
+{
+    std::shared_ptr<MjpgFrame> wrapped = this->encodedpool.acquire();
+    wrapped->jpeg.swap(jpeg); //Takes the bytes without copying, the caller gets the recycled buffer to read the next jpeg into
+    wrapped->captureseq = captureseq;
+    wrapped->captured = captured;
+    wrapped->encoded = std::chrono::steady_clock::now();
+    wrapped->seal(this->boundary);
+    return wrapped;
 }
 
-
-void MjpgServer::run()
+std::shared_ptr<MjpgFrame> MjpgServer::reuseFrame(MjpgFramePtr previous, unsigned long captureseq,
+                                                  std::chrono::steady_clock::time_point captured)
 {
-    std::cout << "Welcome to: " << this->name << std::endl << "Waiting for a clients..." << std::endl;
-    asio::io_service io_service;
-    MjpgServer::server s(io_service, this, this->port);
-    io_service.run();
+    std::shared_ptr<MjpgFrame> reused = this->encodedpool.acquire();
+    reused->reuses = previous; //Only the header is new, clients send the previous jpeg's bytes
+    reused->captureseq = captureseq;
+    reused->captured = captured;
+    reused->encoded = std::chrono::steady_clock::now();
+    reused->seal(this->boundary);
+    return reused;
 }
 
-void MjpgServer::session::start(MjpgServer *server)
+void MjpgServer::handleJpg(session_ptr client, source_ptr cam, MjpgProfilePtr profile, long long after, const std::string &ifnonematch)
 {
-    try
+    std::cout << "Client requested single image!" << std::endl;
+    //A running pipeline already has a fresh frame, pulling here would block on the camera
+    MjpgFramePtr image = (cam->running && !cam->suspended) ? profile->channel.latest() : MjpgFramePtr();
+    if(!image && profile != cam->defaultprofile && after < 0) after = 0; //Only the pipeline encodes other profiles, wait for its first frame
+    if(after >= 0 && (!image || image->captureseq <= (unsigned long) after))
     {
-        this->master = server;
-        boost::thread t(boost::bind(&MjpgServer::onAccept, server, boost::ref(this->socket_)));
+        this->snapshotspolled.add();
+        client->poll(cam, profile, (unsigned long) after, ifnonematch);
+        return;
     }
-    catch(...)
+    if(image)
     {
-        std::cout << "Caught threading problem not quiting though..." << std::endl;
-        delete this;
+        this->snapshotslatest.add();
+        this->sendJpg(client, image, ifnonematch);
+        return;
     }
-}
+    if(cam->failing)
+    {
+        std::string resp = "<p>The camera is <b>not delivering</b> frames</p>";
+        sendError(client, resp);
+        return;
+    }
+    //Nothing is running so grab one on a thread of its own, anyone asking meanwhile gets the same frame
+    MjpgServer *self = this;
+    cam->snapshot(client->loop(), [self, client, ifnonematch](MjpgFramePtr image)
+    {
+        if(!image)
+        {
+            std::string resp = "<p>Failed sending image</p>";
+            self->sendError(client, resp);
+            return;
+        }
+        self->sendJpg(client, image, ifnonematch);
+    });
+}
+
+void MjpgServer::sendJpg(session_ptr client, MjpgFramePtr image, const std::string &ifnonematch)
+{
+    std::stringstream etag;
+    etag << "\"" << this->etagbase << "-" << image->content().captureseq << "\""; //Frames sent again keep the tag of their bytes
+    std::stringstream response;
+    if(!ifnonematch.empty() && (ifnonematch == "*" || ifnonematch.find(etag.str()) != std::string::npos))
+    {
+        this->snapshotsunmodified.add(); //The client already has this very frame
+        response << "HTTP/1.1 304 Not Modified\r\nETag: " << etag.str() << "\r\nServer: " << this->host_name << "\r\n\r\n";
+        client->respond(response.str(), true);
+        return;
+    }
+    response << "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nServer: " << this->host_name;
+    response << "\r\nCache-Control: no-cache\r\nETag: " << etag.str() << "\r\nX-Seq: " << image->captureseq;
+    response << "\r\nContent-Length: " << image->content().jpeg.size() << "\r\n\r\n";
+    client->respond(response.str(), image, true);
+}
+
+MjpgServer::source::source(MjpgServer *server, const std::string &name)
+    : name(name), master(server), idlesince(std::chrono::steady_clock::now())
+{
+    this->defaultprofile = std::make_shared<MjpgProfile>(MjpgRendition()); //Follows the source's resolution and quality
+    this->setDepth(server->pipelinedepth);
+}
+
+void MjpgServer::source::registerMetrics()
+{
+    MjpgMetrics &metrics = this->master->metrics;
+    std::string sourcelabel = MjpgMetrics::label("source", this->name);
+    this->suspends = &metrics.counter("mjpg_source_suspends_total", "Times a source stopped capturing for lack of viewers", sourcelabel);
+    this->resumes = &metrics.counter("mjpg_source_resumes_total", "Times a suspended source started capturing again", sourcelabel);
+    this->changedframes = &metrics.counter("mjpg_change_frames_total", "Compared frames by whether they had to be encoded", "result=\"changed\"," + sourcelabel);
+    this->reusedframes = &metrics.counter("mjpg_change_frames_total", "Compared frames by whether they had to be encoded", "result=\"reused\"," + sourcelabel);
+    this->throttledframes = &metrics.counter("mjpg_change_frames_total", "Compared frames by whether they had to be encoded", "result=\"throttled\"," + sourcelabel);
+    //Every series of a family carries the same labels, stage queues keep their own drop counts so read them where they are
+    std::string labels = "," + sourcelabel;
+    this->clientdrops = &metrics.counter("mjpg_dropped_frames_total", "Frames skipped because their consumer fell behind", "where=\"client\"" + labels);
+    std::unique_ptr<MjpgRing<MjpgPipelineJob> > *queues[3] = { &this->resizeq, &this->encodeq, &this->publishq };
+    const char *stages[3] = { "resize", "encode", "publish" };
+    for(int i = 0; i < 3; i++)
+    {
+        std::unique_ptr<MjpgRing<MjpgPipelineJob> > *queue = queues[i];
+        metrics.sample("mjpg_dropped_frames_total", "Frames skipped because their consumer fell behind", "counter",
+                       [queue]() { return (double) (*queue)->dropped(); }, std::string("where=\"") + stages[i] + "\"" + labels);
+    }
+    source *self = this;
+    metrics.sample("mjpg_source_fps", "Frames per second a source publishes", "gauge",
+                   [self]() { return (double) self->getFPS(); }, sourcelabel);
+}
+
+void MjpgServer::source::start()
+{
+    {
+        boost::mutex::scoped_lock l(this->demand_mutex); //setDepth can't swap the queues once this is set
+        if(this->running.exchange(true)) return; //Only the first viewer starts it
+    }
+    boost::thread(boost::bind(&source::mainPullLoop, this));
+}
+
+void MjpgServer::source::join()
+{
+    {
+        boost::mutex::scoped_lock l(this->demand_mutex);
+        this->viewers++;
+    }
+    this->demand.notify_all();
+    this->start();
+}
+
+void MjpgServer::source::leave()
+{
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    if(--this->viewers == 0) this->idlesince = std::chrono::steady_clock::now();
+}
+
+bool MjpgServer::source::idle()
+{
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    if(!this->unwatched()) return false;
+    this->suspend();
+    while(this->viewers == 0) this->demand.wait(l); //The channels keep the last frame for whoever comes back
+    this->resume();
+    return true;
+}
+
+bool MjpgServer::source::dormant()
+{
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    bool unwatched = this->unwatched();
+    if(unwatched && !this->suspended) this->suspend();
+    else if(!unwatched && this->suspended) this->resume();
+    return unwatched;
+}
+
+bool MjpgServer::source::unwatched()
+{
+    int linger = this->master->linger;
+    if(this->viewers > 0 || linger < 0) return false;
+    return std::chrono::steady_clock::now() - this->idlesince >= std::chrono::milliseconds(linger);
+}
+
+void MjpgServer::source::suspend()
+{
+    this->suspended = true;
+    this->suspends->add();
+    {
+        boost::mutex::scoped_lock f(this->fps_mutex);
+        this->fps = 0.0f;
+    }
+    std::cout << "Source " << this->name << " has no viewers, suspending capture" << std::endl;
+}
+
+void MjpgServer::source::resume()
+{
+    this->suspended = false;
+    this->resumes->add();
+    this->woken = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    this->demand.notify_all(); //Wakes the parked stage threads
+    std::cout << "Source " << this->name << " has a viewer again, resuming capture" << std::endl;
+}
+
+bool MjpgServer::source::park(const MjpgRing<MjpgPipelineJob> &queue)
+{
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    if(!this->suspended || queue.depth() > 0) return false;
+    while(this->suspended && queue.depth() == 0) this->demand.wait(l); //Instead of waking every timeout for nothing
+    return true;
+}
+
+void MjpgServer::source::handoff(MjpgRing<MjpgPipelineJob> &queue, MjpgPipelineJob *job)
+{
+    queue.push(job);
+    if(!this->suspended) return;
+    //A job still on its way when the source suspended has to reach a parked stage
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    this->demand.notify_all();
+}
+
+bool MjpgServer::source::pushed()
+{
+    return !this->pullframe && !this->pullinto;
+}
+
+bool MjpgServer::source::push(cv::Mat &&frame, std::vector<unsigned char> &&jpeg)
+{
+    if(frame.empty() && jpeg.empty()) return false;
+    if(!this->pushed())
+    {
+        //The pull thread already feeds the resize queue and it only takes one producer
+        if(!this->pushrefused.exchange(true))
+            std::cerr << "Source " << this->name << " pulls its frames, published ones are dropped" << std::endl;
+        return false;
+    }
+    if(!this->running) this->start(); //Brings up the stage threads, there's nothing to pull
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    boost::mutex::scoped_lock l(this->publish_mutex);
+    if(this->dormant())
+    {
+        this->heldframe = std::move(frame); //Only the newest is kept for snapshots
+        this->heldjpeg = std::move(jpeg);
+        return false;
+    }
+    this->heldframe.release();
+    this->heldjpeg.clear();
+    MjpgObjectPool<MjpgPipelineJob>::handle job = this->master->jobpool.take();
+    job->pulled = std::move(frame);
+    job->compressed = std::move(jpeg);
+    job->seq = ++this->captures;
+    job->queued = now;
+    job->captured = now;
+    this->capturestage.record(now, now, now); //Published frames are never late or waited on
+    this->handoff(*this->resizeq, job.release()); //Wakes the resize stage right away
+    return true;
+}
+
+void MjpgServer::source::snapshot(boost::asio::io_service &loop, std::function<void(MjpgFramePtr)> callback)
+{
+    boost::mutex::scoped_lock l(this->snapshots_mutex);
+    this->snapshots.push_back(std::make_pair(&loop, callback));
+    if(this->snapshots.size() > 1)
+    {
+        this->master->snapshotscoalesced.add(); //Rides along with the capture in flight
+        return;
+    }
+    this->master->snapshotscaptured.add();
+    boost::thread(boost::bind(&source::snapshotLoop, this));
+}
+
+void MjpgServer::source::snapshotLoop()
+{
+    MjpgFramePtr image;
+    try
+    {
+        image = this->snap();
+    }
+    catch(std::exception& snaperror)
+    {
+        std::cerr << "Snapshot error on " << this->name << ": " << snaperror.what() << std::endl;
+    }
+    std::vector<std::pair<boost::asio::io_service*, std::function<void(MjpgFramePtr)> > > waiting;
+    {
+        boost::mutex::scoped_lock l(this->snapshots_mutex);
+        waiting.swap(this->snapshots); //Anyone asking from now on starts the next capture
+    }
+    for(size_t i = 0; i < waiting.size(); i++)
+    {
+        std::function<void(MjpgFramePtr)> callback = waiting[i].second;
+        waiting[i].first->post([callback, image]() { callback(image); });
+    }
+}
+
+MjpgFramePtr MjpgServer::source::snap()
+{
+    cv::Mat pulled;
+    std::vector<unsigned char> relayed;
+    if(this->pushed()) this->held(pulled, relayed); //Published while nobody streamed, nothing to pull
+    else
+    {
+        boost::mutex::scoped_lock l(this->pull_mutex); //A viewer may have woken the pull thread meanwhile
+        if(!this->pullinto) pulled = this->pullframe();
+        else if(!this->pullinto(pulled, relayed)) return MjpgFramePtr();
+    }
+    if(pulled.empty() && relayed.empty()) return this->pushed() ? this->defaultprofile->channel.latest() : MjpgFramePtr();
+    unsigned long seq = ++this->captures;
+    std::chrono::steady_clock::time_point captured = std::chrono::steady_clock::now();
+    MjpgRendition rendition = this->rendition();
+    if(!relayed.empty() && this->relays(relayed, rendition)) return this->master->wrapFrame(std::move(relayed), seq, captured);
+    if(!relayed.empty()) pulled = cv::imdecode(relayed, cv::IMREAD_COLOR);
+    return this->master->encodeFrame(this->master->resizeFrame(pulled, rendition), rendition, seq, captured);
+}
+
+bool MjpgServer::source::held(cv::Mat &frame, std::vector<unsigned char> &jpeg)
+{
+    boost::mutex::scoped_lock l(this->publish_mutex);
+    frame = this->heldframe;
+    jpeg = this->heldjpeg;
+    return !frame.empty() || !jpeg.empty();
+}
+
+bool MjpgServer::source::setDepth(int depth)
+{
+    boost::mutex::scoped_lock l(this->demand_mutex);
+    if(this->running) return false; //The stage threads hold on to the queues
+    MjpgObjectPool<MjpgPipelineJob> *jobs = &this->master->jobpool;
+    std::function<void(MjpgPipelineJob*)> recycle = [jobs](MjpgPipelineJob *job) { jobs->give(job); }; //Dropped jobs are reused too
+    this->resizeq.reset(new MjpgRing<MjpgPipelineJob>(depth, recycle));
+    this->encodeq.reset(new MjpgRing<MjpgPipelineJob>(depth, recycle));
+    this->publishq.reset(new MjpgRing<MjpgPipelineJob>(depth, recycle));
+    return true;
+}
+
+void MjpgServer::source::openCapture(const std::string &value)
+{
+    this->capture = value;
+    this->pullinto = nullptr;
+    bool device = !value.empty() && value.find_first_not_of("0123456789") == std::string::npos;
+    if(device) this->cap.open(atoi(value.c_str())); //Set physical device pull with safety
+    else this->cap.open(value); //Set stream to pull from
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(250)); //Keeps from overreading
+    int tries = 0;
+    while(!this->cap.isOpened()) {
+        if(tries++ > this->master->maxfailpackets) break;
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+    } //Make sure we are connected before continuing
+    this->settlefps = (int) this->cap.get(cv::CAP_PROP_FPS);
+    std::cout << "New settle fps: " << this->settlefps << std::endl;
+    this->pullframe = [this]() -> cv::Mat
+    {
+        cv::Mat frame;
+        frame.allocator = &this->master->framepool; //The capture writes straight into a recycled buffer
+        try {
+            if(!this->cap.read(frame)) return frame;
+        }
+        catch (std::exception& err)
+        {
+            std::cerr << "Overread on stream" << std::endl;
+        }
+        return frame;
+    };
+    this->unint = [this]() -> void
+    {
+        try {
+            this->cap.release();
+        }
+        catch(cv::Exception& err)
+        {
+            std::cerr << "Release capture error: " << err.what() << std::endl;
+        }
+    };
+}
+
+void MjpgServer::source::openRelay(const std::string &location)
+{
+    this->relay.reset(new MjpgRelay(location));
+    MjpgRelay *relay = this->relay.get();
+    this->pullinto = [relay](cv::Mat &, std::vector<unsigned char> &jpeg) -> bool { return relay->next(jpeg); };
+}
+
+void MjpgServer::source::openShm(const std::string &ring)
+{
+    this->ring.reset(new MjpgShmConsumer(ring));
+    MjpgShmConsumer *consumer = this->ring.get();
+    MjpgMatPool *converted = &this->master->framepool;
+    this->pullinto = [consumer, converted](cv::Mat &frame, std::vector<unsigned char> &jpeg) -> bool
+    {
+        return consumer->next(frame, jpeg, converted);
+    };
+}
+
+bool MjpgServer::source::relays(const std::vector<unsigned char> &jpeg, const MjpgRendition &rendition)
+{
+    if(rendition.quality >= 0) return false; //Asking for a quality means encoding again
+    if(rendition.width <= 0 || rendition.height <= 0) return true;
+    int width = 0;
+    int height = 0;
+    return MjpgRelay::dimensions(jpeg.data(), jpeg.size(), width, height) && width == rendition.width && height == rendition.height;
+}
+
+MjpgRendition MjpgServer::source::rendition()
+{
+    MjpgRendition current;
+    current.width = this->resized[0];
+    current.height = this->resized[1];
+    current.quality = this->quality;
+    current.strips = this->strips;
+    return current;
+}
+
+float MjpgServer::source::getFPS()
+{
+    boost::mutex::scoped_lock l(this->fps_mutex);
+    return this->fps;
+}
+
+int MjpgServer::source::skipRatio()
+{
+    uint64_t changed = this->changedframes->value();
+    uint64_t skipped = this->reusedframes->value() + this->throttledframes->value();
+    if(changed + skipped == 0) return 0;
+    return (int) (skipped * 100 / (changed + skipped));
+}
+
+void MjpgServer::source::pin()
+{
+#ifdef __linux__
+    if(this->cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i = 0; i < this->cpus.size(); i++) CPU_SET(this->cpus[i], &set);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        std::cerr << "Couldn't pin source " << this->name << " to its cores" << std::endl;
+#endif
+}
+
+void MjpgServer::source::mainPullLoop()
+{
+    this->pin();
+    bool pushed = this->pushed();
+    for(int test = 0; test < 3 && !pushed && !this->pullinto; test++)
+    {
+        try
+        {
+            this->pullframe();
+        }
+        catch(std::exception& err) {}
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+    }
+
+    //Each stage gets its own thread so pulling the next frame overlaps encoding this one
+    boost::thread_group stages;
+    stages.create_thread(boost::bind(&source::resizeLoop, this));
+    stages.create_thread(boost::bind(&source::encodeLoop, this));
+    stages.create_thread(boost::bind(&source::publishLoop, this));
+    if(pushed)
+    {
+        stages.join_all(); //Frames are published to the resize stage from the application's threads
+        return;
+    }
+
+    long failures = 0;
+    MjpgPacer pacer;
+    while(1)
+    {
+        this->idle();
+        //Settle follows the camera, otherwise the served fps, otherwise as fast as the source allows
+        pacer.setRate((this->settlefps > 0) ? this->settlefps : this->controlfps);
+        std::chrono::steady_clock::time_point deadline = pacer.wait();
+        cv::Mat pulled;
+        MjpgObjectPool<MjpgPipelineJob>::handle job = this->master->jobpool.take();
+        std::chrono::steady_clock::time_point pulling = std::chrono::steady_clock::now();
+        try
+        {
+            boost::mutex::scoped_lock l(this->pull_mutex);
+            if(!this->pullinto) pulled = this->pullframe();
+            else if(!this->pullinto(pulled, job->compressed))
+            {
+                pulled.release();
+                job->compressed.clear();
+            }
+        }
+        catch(std::exception& pullerror) {
+            if(failures == 0) std::cerr << "Image pull error on " << this->name << ": " << pullerror.what() << std::endl;
+        }
+        this->master->capturetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - pulling).count());
+        if(pulled.empty() && job->compressed.empty())
+        {
+            if(++failures < this->master->maxfailpackets) continue;
+            if(!this->failing.exchange(true))
+                std::cerr << "Source " << this->name << " keeps failing, backing off" << std::endl;
+            if(!this->capture.empty() && failures % this->master->maxfailpackets == 0)
+            {
+                boost::mutex::scoped_lock l(this->pull_mutex); //A snapshot may be reading the capture
+                this->cap.release();
+                bool device = this->capture.find_first_not_of("0123456789") == std::string::npos;
+                if(device) this->cap.open(atoi(this->capture.c_str()));
+                else this->cap.open(this->capture);
+            }
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(std::min<long>(failures * 10, 1000)));
+            continue;
+        }
+        if(this->failing.exchange(false))
+            std::cout << "Source " << this->name << " is delivering frames again" << std::endl;
+        failures = 0;
+        this->curframe = pulled;
+        job->seq = ++this->captures;
+        job->pulled = pulled;
+        job->queued = std::chrono::steady_clock::now();
+        job->captured = job->queued;
+        this->capturestage.record(deadline, pulling, job->queued); //Waiting is how late the pull started
+        this->handoff(*this->resizeq, job.release());
+    }
+}
+
+void MjpgServer::source::resizeLoop()
+{
+    this->pin();
+    while(1)
+    {
+        MjpgObjectPool<MjpgPipelineJob>::handle job = this->master->jobpool.wrap(this->resizeq->waitPop(std::chrono::milliseconds(100)));
+        if(!job)
+        {
+            this->park(*this->resizeq);
+            continue;
+        }
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        int threshold = this->master->changethreshold;
+        if(threshold < 0 || job->pulled.empty()) this->detector.reset(); //Turned back on it starts over from a fresh frame, relayed frames aren't decoded to compare
+        else if(this->detector.changed(job->pulled, threshold)) this->changedframes->add();
+        else
+        {
+            int keepalive = this->master->keepalivefps;
+            if(keepalive > 0 && job->captured - this->kept < std::chrono::microseconds(1000000 / keepalive))
+            {
+                this->throttledframes->add(); //Nothing new to show until the next keep-alive
+                continue;
+            }
+            job->unchanged = true;
+            this->reusedframes->add();
+        }
+        this->kept = job->captured;
+        try
+        {
+            this->activeProfiles(job->profiles);
+            for(size_t i = 0; i < job->profiles.size(); i++)
+            {
+                MjpgRendition rendition = (job->profiles[i] == this->defaultprofile) ? this->rendition() : job->profiles[i]->rendition;
+                job->renditions.push_back(rendition);
+                job->relayed.push_back(!job->compressed.empty() && this->relays(job->compressed, rendition));
+                //Unchanged frames are only sized by the encode stage if a profile has nothing to reuse yet
+                if(job->relayed[i] || job->unchanged)
+                {
+                    job->sized.push_back(cv::Mat());
+                    continue;
+                }
+                if(job->pulled.empty()) //Only a relayed frame a profile resizes or requantizes is decoded, once for all of them
+                    job->pulled = cv::imdecode(job->compressed, cv::IMREAD_COLOR);
+                job->sized.push_back(this->master->resizeFrame(job->pulled, rendition));
+            }
+        }
+        catch(std::exception& resizeerror)
+        {
+            std::cerr << "Image resize error: " << resizeerror.what() << std::endl;
+            continue;
+        }
+        std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+        this->resizestage.record(job->queued, started, finished);
+        job->queued = finished;
+        this->handoff(*this->encodeq, job.release());
+    }
+}
+
+void MjpgServer::source::encodeLoop()
+{
+    this->pin();
+    while(1)
+    {
+        MjpgObjectPool<MjpgPipelineJob>::handle job = this->master->jobpool.wrap(this->encodeq->waitPop(std::chrono::milliseconds(100)));
+        if(!job)
+        {
+            this->park(*this->encodeq);
+            continue;
+        }
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        //Every rendition with viewers is encoded in parallel on the server's encode threads
+        MjpgPipelineJob *encoding = job.get();
+        size_t profiles = encoding->sized.size();
+        encoding->encoded.resize(profiles);
+        encoding->pending = profiles;
+        for(size_t i = 0; i < profiles; i++)
+        {
+            if(!encoding->relayed[i]) continue;
+            //The first profile relaying the upstream jpeg takes its bytes, the others send that frame's again
+            encoding->encoded[i] = this->master->wrapFrame(std::move(encoding->compressed), encoding->seq, encoding->captured);
+            break;
+        }
+        for(size_t i = 0; i < profiles; i++)
+        {
+            if(profiles == 1)
+                this->encodeProfile(encoding, i); //Nothing to overlap with so skip the pool hop
+            else
+                this->master->encoders.post(&source::encodeTask, this, encoding, i);
+        }
+        {
+            boost::mutex::scoped_lock l(encoding->latch);
+            while(encoding->pending > 0) encoding->finished.wait(l); //Every task must be done with the job before it can go
+        }
+        if(!encoding->failure.empty())
+        {
+            std::cerr << "Image encode error: " << encoding->failure << std::endl;
+            continue;
+        }
+        std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+        this->encodestage.record(job->queued, started, finished);
+        job->queued = finished;
+        this->handoff(*this->publishq, job.release());
+    }
+}
+
+void MjpgServer::source::encodeTask(void *owner, void *job, size_t index)
+{
+    static_cast<source *>(owner)->encodeProfile(static_cast<MjpgPipelineJob *>(job), index);
+}
+
+void MjpgServer::source::encodeProfile(MjpgPipelineJob *job, size_t i)
+{
+    MjpgServer *server = this->master;
+    try
+    {
+        if(job->relayed[i])
+        {
+            size_t first = 0;
+            while(!job->relayed[first]) first++;
+            if(first != i) job->encoded[i] = server->reuseFrame(job->encoded[first], job->seq, job->captured); //Wrapped before the encodes started
+        }
+        else
+        {
+            MjpgProfile *profile = job->profiles[i].get();
+            if(job->unchanged && profile->encoded && profile->encodedas == job->renditions[i])
+            {
+                job->encoded[i] = server->reuseFrame(profile->encoded, job->seq, job->captured);
+            }
+            else
+            {
+                if(job->sized[i].empty())
+                    job->sized[i] = server->resizeFrame(job->pulled, job->renditions[i]);
+                job->encoded[i] = server->encodeFrame(job->sized[i], job->renditions[i], job->seq, job->captured);
+                profile->encoded = job->encoded[i];
+                profile->encodedas = job->renditions[i];
+            }
+        }
+    }
+    catch(std::exception& encodeerror)
+    {
+        boost::mutex::scoped_lock l(job->latch);
+        if(job->failure.empty()) job->failure = encodeerror.what();
+    }
+    boost::mutex::scoped_lock l(job->latch);
+    if(--job->pending == 0) job->finished.notify_one(); //Still under the latch, the job may be recycled right after
+}
+
+void MjpgServer::source::publishLoop()
+{
+    this->pin();
+    //Only this thread counts published frames so /fps no longer depends on how many clients watch
+    int frames = 0;
+    std::chrono::steady_clock::time_point sampled = std::chrono::steady_clock::now();
+    while(1)
+    {
+        MjpgObjectPool<MjpgPipelineJob>::handle job = this->master->jobpool.wrap(this->publishq->waitPop(std::chrono::milliseconds(100)));
+        if(!job)
+        {
+            this->park(*this->publishq);
+            continue;
+        }
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < job->encoded.size(); i++)
+        {
+            job->profiles[i]->channel.publish(job->encoded[i]); //Publish once, every client of the profile shares this buffer
+            this->master->publishedage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                job->encoded[i]->published - job->captured).count());
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        this->publishstage.record(job->queued, started, now);
+        long long woken = this->woken.load();
+        if(woken != 0 && job->captured.time_since_epoch() >= std::chrono::nanoseconds(woken) && this->woken.compare_exchange_strong(woken, 0))
+            this->master->resumetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() - woken);
+        frames++;
+        long duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - sampled).count();
+        if(duration > 250 && frames > this->master->samplefps)
+        {
+            boost::mutex::scoped_lock l(this->fps_mutex);
+            this->fps = (float) (frames * 1000) / duration;
+            sampled = now;
+            frames = 0;
+        }
+    }
+}
+
+MjpgProfilePtr MjpgServer::source::acquireProfile(const MjpgRendition &rendition)
+{
+    //What the source already encodes needs no profile of its own
+    if(rendition == this->defaultprofile->rendition || rendition == this->rendition()) return this->defaultprofile;
+    boost::mutex::scoped_lock l(this->profiles_mutex);
+    std::map<MjpgRendition, std::weak_ptr<MjpgProfile> >::iterator found = this->profiles.find(rendition);
+    MjpgProfilePtr profile = (found != this->profiles.end()) ? found->second.lock() : MjpgProfilePtr();
+    if(!profile)
+    {
+        if(found == this->profiles.end() && this->master->maxprofiles > 0 && (int) this->profiles.size() >= this->master->maxprofiles)
+            return MjpgProfilePtr(); //Each profile costs a resize and encode per frame
+        profile = std::make_shared<MjpgProfile>(rendition);
+        this->profiles[rendition] = profile;
+        std::cout << "Started encoding profile " << rendition.name() << " of " << this->name << std::endl;
+    }
+    return profile;
+}
+
+void MjpgServer::source::activeProfiles(std::vector<MjpgProfilePtr> &active)
+{
+    active.push_back(this->defaultprofile);
+    boost::mutex::scoped_lock l(this->profiles_mutex);
+    for(std::map<MjpgRendition, std::weak_ptr<MjpgProfile> >::iterator it = this->profiles.begin(); it != this->profiles.end();)
+    {
+        MjpgProfilePtr profile = it->second.lock();
+        if(profile)
+        {
+            active.push_back(profile);
+            ++it;
+        }
+        else
+        {
+            std::cout << "Stopped encoding profile " << it->first.name() << " of " << this->name << std::endl;
+            this->profiles.erase(it++); //Its last viewer left
+        }
+    }
+}
+
+std::vector<MjpgStageStats> MjpgServer::source::stats()
+{
+    const MjpgStage *stages[] = {&this->capturestage, &this->resizestage, &this->encodestage, &this->publishstage};
+    const MjpgRing<MjpgPipelineJob> *queues[] = {nullptr, this->resizeq.get(), this->encodeq.get(), this->publishq.get()};
+    std::vector<MjpgStageStats> all;
+    for(int i = 0; i < 4; i++)
+    {
+        MjpgStageStats stage;
+        stage.name = (this->name == "default") ? stages[i]->name : this->name + "/" + stages[i]->name;
+        stage.depth = queues[i] ? queues[i]->depth() : 0;
+        stage.dropped = queues[i] ? queues[i]->dropped() : 0;
+        stage.waiting = stages[i]->waiting.load();
+        stage.working = stages[i]->working.load();
+        all.push_back(stage);
+    }
+    return all;
+}
+
+void MjpgServer::handleMjpg(session_ptr client, source_ptr cam, MjpgProfilePtr profile, int fps)
+{
+    //Tell client mjpg stream is going to be sent
+    std::stringstream respcompile;
+    respcompile << "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=";
+    respcompile << this->boundary << "\r\nServer: " << this->host_name;
+    respcompile << "\r\n\r\n";
+
+    client->stream(respcompile.str(), cam, profile, fps); //The session's event loop paces the frames from here
+}
+
+void MjpgServer::handleWs(session_ptr client, source_ptr cam, MjpgProfilePtr profile, int fps, int window, const MjpgHttpRequest &request)
+{
+    std::string upgrade = request.header("Upgrade").to_string();
+    std::string connection = request.header("Connection").to_string();
+    boost::string_ref key = request.header("Sec-WebSocket-Key");
+    if(!boost::algorithm::iequals(upgrade, "websocket") || !boost::algorithm::icontains(connection, "upgrade") || key.empty())
+    {
+        client->respond("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", false);
+        return;
+    }
+    if(request.header("Sec-WebSocket-Version") != "13")
+    {
+        client->respond("HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", false);
+        return;
+    }
+    std::stringstream respcompile;
+    respcompile << "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    respcompile << MjpgWebSocket::acceptKey(key) << "\r\nServer: " << this->host_name << "\r\n\r\n";
+
+    client->websocket(respcompile.str(), cam, profile, fps, window); //Acks from the client pace the frames from here
+}
+
+void MjpgServer::handleHtml(session_ptr client, std::string& root) //Look at onAccept
+{
+    std::stringstream p_con;
+    p_con << "<html><head></head><body><img src=\"" << root << "\"/></body></html>";
+    std::string main_content = p_con.str();
+    std::stringstream content;
+    content << "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " << main_content.length();
+    content << "\r\nServer: " << this->host_name;
+    content << "\r\n\r\n" << main_content;
+    client->respond(content.str(), true);
+}
+
+void MjpgServer::sendSimple(session_ptr client, std::string& simple) //Look at onAccept
+{
+    std::stringstream content;
+    content << "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " << simple.length();
+    content << "\r\nServer: " << this->host_name;
+    content << "\r\n\r\n" << simple;
+    client->respond(content.str(), true);
+}
+
+void MjpgServer::onAccept(session_ptr client, const MjpgHttpRequest &request) //Look at session::onRequest
+{
+    boost::mutex mutex;
+
+    if(request.version != "HTTP/1.1")
+    {
+        std::cerr << "Bad HTTP request" << std::endl;
+        std::string resp = "<p>Request needs to be <b>HTTP/1.1</b></p>";
+        sendError(client, resp);
+        return;
+    }
+
+    //Views into the connection buffer, only valid until this returns
+    const boost::string_ref req_type = request.method;
+    boost::string_ref extension = request.path;
+    const std::string query = request.query.to_string();
+
+    //Everything below /cam/<name>/ is about that camera, the rest about the default one
+    source_ptr cam = this->primary;
+    std::string prefix;
+    if(extension.starts_with("/cam/"))
+    {
+        boost::string_ref rest = extension.substr(5);
+        boost::string_ref::size_type slash = rest.find('/');
+        std::string camname = rest.substr(0, slash).to_string();
+        cam = this->findSource(camname);
+        if(!cam)
+        {
+            std::string resp = "<p>There is <b>no camera</b> named " + this->escapehtml(camname) + "</p>";
+            sendError(client, resp);
+            return;
+        }
+        prefix = "/cam/" + camname;
+        extension = (slash == boost::string_ref::npos) ? boost::string_ref("/") : rest.substr(slash);
+    }
+
+    try
+    {
+        if(extension == "/mjpg" || extension == "/ws")
+        {
+            if(this->maxconnections > 0 && this->connections >= this->maxconnections)
+            {
+                this->sendError(client, this->tooManyErr);
+                return;
+            }
+            int fps = -1;
+            std::map<std::string, std::string> params = this->parsequery(query);
+            if(params.count("fps"))
+            {
+                fps = atoi(params["fps"].c_str());
+                if(fps < 1 || fps > 1000)
+                {
+                    std::string resp = "<p>Stream <b>fps</b> must be between 1 and 1000</p>";
+                    this->sendError(client, resp);
+                    return;
+                }
+            }
+            int window = this->wswindow;
+            if(params.count("window"))
+            {
+                window = std::min(atoi(params["window"].c_str()), this->wswindow);
+                if(window < 1)
+                {
+                    std::string resp = "<p>The WebSocket <b>window</b> must be at least 1</p>";
+                    this->sendError(client, resp);
+                    return;
+                }
+            }
+            MjpgProfilePtr profile = this->resolveProfile(client, cam, query);
+            if(!profile) return;
+            try
+            {
+                if(extension == "/ws") this->handleWs(client, cam, profile, fps, window, request);
+                else this->handleMjpg(client, cam, profile, fps);
+            }
+            catch(std::exception& mjpgerr)
+            {
+                std::cerr << "Error handling mjpg stream with client: " << mjpgerr.what() << std::endl;
+            }
+            return;
+        }
+        else if(extension == "/" || extension == "/html")
+        {
+            if(this->maxconnections > 0 && this->connections >= this->maxconnections)
+            {
+                this->sendError(client, this->tooManyErr);
+                return;
+            }
+            try
+            {
+                std::stringstream mjpgpath;
+                mjpgpath << "http://" << request.header("Host") << prefix << "/mjpg";
+                std::string newpath(mjpgpath.str());
+                this->handleHtml(client, newpath);
+            }
+            catch(std::exception& errsend)
+            {
+                std::cerr << "Error html request: " << errsend.what() << std::endl;
+                return;
+            }
+        }
+        else if(extension == "/jpg") //Send single image
+        {
+            std::map<std::string, std::string> params = this->parsequery(query);
+            long long after = params.count("after") ? atoll(params["after"].c_str()) : -1;
+            if(after < -1)
+            {
+                std::string resp = "<p>The <b>after</b> sequence can't be negative</p>";
+                this->sendError(client, resp);
+                return;
+            }
+            MjpgProfilePtr profile = this->resolveProfile(client, cam, query);
+            if(!profile) return;
+            try
+            {
+                this->handleJpg(client, cam, profile, after, request.header("If-None-Match").to_string());
+            }
+            catch(std::exception& imageerr)
+            {
+                std::cerr << "Error jpg send: " << imageerr.what() << std::endl;
+            }
+            return;
+        }
+        else if(extension == "/fps") //REST control fps
+        {
+            std::string tosend;
+            boost::mutex::scoped_lock l(mutex);
+            try
+            {
+                if(req_type == "GET")
+                {
+                    std::cout << "Requested to get fps" << std::endl;
+                    std::stringstream ss;
+                    ss << (int) cam->getFPS(); //Turn the float to int to string
+                    tosend = ss.str();
+                    this->sendSimple(client, tosend);
+                }
+                else if(req_type == "POST")
+                {
+                    std::string body = request.body.to_string();
+                    cam->controlfps = atoi(body.c_str());
+                    tosend = ""; //Send empty response since it's a simple response
+                    this->sendSimple(client, tosend);
+                    std::cout << "Requested to set fps to: " << cam->controlfps << " Completed" << std::endl;
+                }
+                else
+                {
+                    this->sendError(client, this->defErr);
+                }
+                return;
+            }
+            catch(std::exception& err)
+            {
+                std::cerr << "Bad request on resolution" << std::endl;
+                this->sendError(client, this->defErr);
+            }
+        }
+        else if(extension == "/quality")
+        {
+            std::string tosend;
+            boost::mutex::scoped_lock l(mutex);
+            try
+            {
+                if(req_type == "GET")
+                {
+                    std::cout << "Requested to get quality" << std::endl;
+                    std::stringstream ss;
+                    ss << (int) cam->quality;
+                    tosend = ss.str();
+                    this->sendSimple(client, tosend);
+                }
+                else if(req_type == "POST")
+                {
+                    std::string body = request.body.to_string();
+                    cam->quality = atoi(body.c_str());
+                    tosend = "";
+                    this->sendSimple(client, tosend);
+                    std::cout << "Requested to set quality to: " << cam->quality << " Completed" << std::endl;
+                }
+                else
+                {
+                    this->sendError(client, this->defErr);
+                }
+                return;
+            }
+            catch(std::exception& err)
+            {
+                std::cerr << "Bad request on quality" << std::endl;
+                this->sendError(client, this->defErr);
+            }
+        }
+        else if(extension == "/connections")
+        {
+            std::string tosend;
+            boost::mutex::scoped_lock l(mutex);
+            try
+            {
+                if(req_type == "GET")
+                {
+                    std::cout << "Requested to get connections" << std::endl;
+                    std::stringstream ss;
+                    ss << this->connections;
+                    tosend = ss.str();
+                    this->sendSimple(client, tosend);
+                }
+                else if(req_type == "POST")
+                {
+                    std::string body = request.body.to_string();
+                    this->maxconnections = atoi(body.c_str());
+                    tosend = "";
+                    this->sendSimple(client, tosend);
+                    std::cout << "Requested to set max connections to: " << this->maxconnections << " Completed" << std::endl;
+                }
+                else
+                {
+                    this->sendError(client, this->defErr);
+                }
+                return;
+            }
+            catch(std::exception& err)
+            {
+                std::cerr << "Bad request on connections" << std::endl;
+            }
+        }
+        else if(extension == "/clients")
+        {
+            if(req_type == "GET")
+            {
+                std::string tosend = this->clientTable();
+                this->sendSimple(client, tosend);
+            }
+            else
+            {
+                this->sendError(client, this->defErr);
+            }
+            return;
+        }
+        else if(extension == "/pipeline")
+        {
+            if(req_type == "GET")
+            {
+                std::string tosend = this->pipelineTable();
+                this->sendSimple(client, tosend);
+            }
+            else
+            {
+                this->sendError(client, this->defErr);
+            }
+            return;
+        }
+        else if(extension == "/metrics")
+        {
+            if(req_type == "GET")
+            {
+                std::string tosend = this->getMetrics();
+                this->sendSimple(client, tosend);
+            }
+            else
+            {
+                this->sendError(client, this->defErr);
+            }
+            return;
+        }
+        else if(extension == "/sources")
+        {
+            if(req_type == "GET")
+            {
+                std::string tosend = this->sourceTable();
+                this->sendSimple(client, tosend);
+            }
+            else
+            {
+                this->sendError(client, this->defErr);
+            }
+            return;
+        }
+        else if(extension == "/pools")
+        {
+            if(req_type == "GET")
+            {
+                std::string tosend = this->poolTable();
+                this->sendSimple(client, tosend);
+            }
+            else
+            {
+                this->sendError(client, this->defErr);
+            }
+            return;
+        }
+        else if(extension == "/resolution")
+        {
+            std::string tosend;
+            boost::mutex::scoped_lock l(mutex);
+            try
+            {
+                if(req_type == "GET")
+                {
+                    std::cout << "Requested to get resolution" << std::endl;
+                    std::stringstream ss;
+                    int width = cam->resized[0] > 0 ? cam->resized[0] : cam->curframe.cols;
+                    int height = cam->resized[1] > 0 ? cam->resized[1] : cam->curframe.rows;
+                    ss << width << "x" << height;
+                    tosend = ss.str();
+                    this->sendSimple(client, tosend);
+                }
+                else if(req_type == "POST")
+                {
+                    std::string body = request.body.to_string();
+                    std::string dim = body.substr(0, body.find("x"));
+                    cam->resized[0] = atoi(dim.c_str());
+                    dim = body.substr(body.find("x") + 1);
+                    cam->resized[1] = atoi(dim.c_str());
+                    tosend = "";
+                    this->sendSimple(client, tosend);
+                    std::cout << "Requested to set resolution to: " << body << " Completed" << std::endl;
+                }
+                else
+                {
+                    this->sendError(client, this->defErr);
+                }
+                return;
+            }
+            catch(std::exception& err)
+            {
+                std::cerr << "Bad request on resolution" << std::endl;
+                this->sendError(client, this->defErr);
+            }
+        }
+        else
+        {
+            std::string resp = "<p>404 Page not found! please use <b>.../mjpg, .../html, .../jpg (also below /cam/&lt;name&gt;/) or controls (fps, quality, resolution, connections, clients, pipeline, pools, metrics, sources)</b></p>";
+            sendError(client, resp);
+            return;
+        }
+    }
+    catch(std::exception& err)
+    {
+        std::cerr << "Loop error" << std::endl;
+        return;
+    }
+}
+
+void MjpgServer::sendError(session_ptr client, std::string &message, const char *status)
+{
+    std::string content = "<html><body><h1>" + this->name + " error:</h1>" + message + "</body></html>\r\n";
+    std::stringstream bad;
+    bad << "HTTP/1.1 " << status << "\r\nContent-Type: text/html\r\nContent-Length: " << content.length() << "\r\nConnection: close\r\n\r\n" << content;
+    client->respond(bad.str(), false);
+}
+
+void MjpgServer::setMaxRequestSize(int bytes)
+{
+    this->maxrequest = bytes;
+}
+
+void MjpgServer::setReadTimeout(int milliseconds)
+{
+    this->readtimeout = milliseconds;
+}
+
+void MjpgServer::setEventLoops(int loops)
+{
+    this->eventloops = loops;
+}
+
+void MjpgServer::addProfile(std::string name, int width, int height, int quality, int strips)
+{
+    MjpgRendition rendition;
+    rendition.width = width;
+    rendition.height = height;
+    rendition.quality = quality;
+    rendition.strips = strips;
+    boost::mutex::scoped_lock l(this->profiles_mutex);
+    this->namedprofiles[name] = rendition;
+}
+
+void MjpgServer::setEncoderTuning(int subsampling, bool fastdct, bool optimize)
+{
+    this->tuning.subsampling = subsampling;
+    this->tuning.fastdct = fastdct;
+    this->tuning.optimize = optimize;
+    this->createEncoders();
+}
+
+void MjpgServer::createEncoders()
+{
+    MjpgEncoderTuning shared = this->tuning;
+    shared.optimize = false; //Stitched strips must share the standard huffman tables
+    std::atomic_store(&this->encoder, MjpgEncoder::create(this->tuning)); //Frames being encoded finish on the old one
+    std::atomic_store(&this->stripencoder, std::make_shared<MjpgStripEncoder>(MjpgEncoder::create(shared), 1, this->encoders));
+}
+
+void MjpgServer::setStrips(int strips)
+{
+    this->primary->strips = strips;
+}
+
+void MjpgServer::setEncodeThreads(int threads)
+{
+    this->encoders.setThreads(threads);
+}
+
+void MjpgServer::setMaxProfiles(int profiles)
+{
+    this->maxprofiles = profiles;
+}
+
+bool MjpgServer::parseRendition(const std::string &query, MjpgRendition &rendition)
+{
+    std::map<std::string, std::string> params = this->parsequery(query);
+    if(params.count("profile"))
+    {
+        boost::mutex::scoped_lock l(this->profiles_mutex);
+        std::map<std::string, MjpgRendition>::iterator named = this->namedprofiles.find(params["profile"]);
+        if(named == this->namedprofiles.end()) return false;
+        rendition = named->second;
+        return true;
+    }
+    if(params.count("w")) rendition.width = atoi(params["w"].c_str());
+    if(params.count("h")) rendition.height = atoi(params["h"].c_str());
+    if(params.count("q")) rendition.quality = atoi(params["q"].c_str());
+    if(params.count("strips")) rendition.strips = atoi(params["strips"].c_str());
+    if(rendition.strips > 64) return false;
+    if((rendition.width > 0) != (rendition.height > 0)) return false;
+    if(rendition.width > 8192 || rendition.height > 8192) return false;
+    return rendition.quality <= 100;
+}
+
+MjpgProfilePtr MjpgServer::resolveProfile(session_ptr client, source_ptr cam, const std::string &query)
+{
+    MjpgRendition rendition;
+    if(!this->parseRendition(query, rendition))
+    {
+        std::map<std::string, std::string> params = this->parsequery(query);
+        std::string resp = params.count("profile") ? "<p>Unknown <b>profile</b> " + this->escapehtml(params["profile"]) + "</p>"
+                                                   : "<p>Bad <b>w, h or q</b> rendition parameters</p>";
+        this->sendError(client, resp, params.count("profile") ? "404 Not Found" : "400 Bad Request");
+        return MjpgProfilePtr();
+    }
+    MjpgProfilePtr profile = cam->acquireProfile(rendition);
+    if(!profile)
+    {
+        std::string resp = "<p>There are <b>too many</b> stream profiles running!</p>";
+        this->sendError(client, resp);
+    }
+    return profile;
+}
+
+std::map<std::string, std::string> MjpgServer::parsequery(const std::string &query)
+{
+    std::map<std::string, std::string> params;
+    std::vector<std::string> pairs;
+    boost::algorithm::split(pairs, query, boost::algorithm::is_any_of("&"));
+    for(size_t i = 0; i < pairs.size(); i++)
+    {
+        std::string::size_type index = pairs[i].find('=');
+        if(index == std::string::npos) continue;
+        params[pairs[i].substr(0, index)] = pairs[i].substr(index + 1);
+    }
+    return params;
+}
+
+std::string MjpgServer::escapehtml(const std::string &text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        switch(text[i])
+        {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            case '\'': escaped += "&#39;"; break;
+            default: escaped += text[i];
+        }
+    }
+    return escaped;
+}
+
+void MjpgServer::setSendBuffer(int bytes)
+{
+    this->sendbuffer = bytes;
+}
+
+void MjpgServer::setSendLowat(int bytes)
+{
+    this->sendlowat = bytes;
+}
+
+void MjpgServer::setSendTimeout(int milliseconds)
+{
+    this->sendtimeout = milliseconds;
+}
+
+void MjpgServer::setZeroCopy(int bytes)
+{
+    this->zerocopy = bytes;
+}
+
+void MjpgServer::setIoUring(bool enable)
+{
+    this->uring = enable;
+}
+
+std::vector<MjpgServer::ClientStats> MjpgServer::getClientStats()
+{
+    std::vector<ClientStats> all;
+    boost::mutex::scoped_lock l(this->streams_mutex);
+    for(std::map<session*, std::weak_ptr<session> >::iterator it = this->streams.begin(); it != this->streams.end(); ++it)
+    {
+        session_ptr client = it->second.lock();
+        if(client) all.push_back(client->stats());
+    }
+    return all;
+}
+
+std::string MjpgServer::clientTable()
+{
+    std::vector<ClientStats> all = this->getClientStats();
+    std::stringstream table;
+    for(size_t i = 0; i < all.size(); i++)
+    {
+        table << all[i].address << " " << all[i].sent << " " << all[i].dropped << " " << all[i].fps << " ";
+        table << all[i].interval << " " << all[i].jitter << " " << all[i].worst << " " << all[i].source << "\n";
+    }
+    return table.str();
+}
+
+void MjpgServer::setChangeDetection(int threshold)
+{
+    this->changethreshold = threshold;
+}
+
+void MjpgServer::setKeepAliveFPS(int fps)
+{
+    this->keepalivefps = fps;
+}
+
+void MjpgServer::setIdleLinger(int milliseconds)
+{
+    this->linger = milliseconds;
+}
+
+void MjpgServer::setLongPollTimeout(int milliseconds)
+{
+    this->polltimeout = milliseconds;
+}
+
+void MjpgServer::setWebSocketWindow(int frames)
+{
+    this->wswindow = frames > 0 ? frames : 1;
+}
+
+void MjpgServer::setPipelineDepth(int depth)
+{
+    if(depth < 1) depth = 1;
+    this->pipelinedepth = depth;
+    boost::mutex::scoped_lock l(this->sources_mutex);
+    for(std::map<std::string, source_ptr>::iterator it = this->sources.begin(); it != this->sources.end(); ++it)
+    {
+        if(!it->second->setDepth(depth))
+            std::cerr << "Source " << it->first << " is already running, its pipeline keeps its depth" << std::endl;
+    }
+}
+
+void MjpgServer::setHugePages(bool enable)
+{
+    this->framepool.setHugePages(enable);
+    this->resizepool.setHugePages(enable);
+}
+
+std::vector<MjpgPoolStats> MjpgServer::getPoolStats()
+{
+    std::vector<MjpgPoolStats> all;
+    all.push_back(this->framepool.stats());
+    all.push_back(this->resizepool.stats());
+    all.push_back(this->encodedpool.stats());
+    all.push_back(this->jobpool.stats());
+    return all;
+}
+
+std::string MjpgServer::poolTable()
+{
+    std::vector<MjpgPoolStats> all = this->getPoolStats();
+    std::stringstream table;
+    for(size_t i = 0; i < all.size(); i++)
+    {
+        table << all[i].name << " " << all[i].hits << " " << all[i].misses << " " << all[i].pooled << " " << all[i].bytes << "\n";
+    }
+    return table.str();
+}
+
+std::string MjpgServer::getMetrics()
+{
+    return this->metrics.render();
+}
+
+void MjpgServer::registerMetrics()
+{
+    std::atomic<int> *connections = &this->connections;
+    this->metrics.sample("mjpg_connections", "Streaming clients connected", "gauge",
+                         [connections]() { return (double) connections->load(); });
+}
+
+cv::Mat MjpgServer::acquireFrame(int rows, int cols, int type)
+{
+    return this->framepool.acquire(rows, cols, type);
+}
+
+std::vector<MjpgStageStats> MjpgServer::getPipelineStats()
+{
+    std::vector<std::string> names = this->getSources();
+    std::vector<MjpgStageStats> all;
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        source_ptr cam = this->findSource(names[i]);
+        if(!cam) continue;
+        std::vector<MjpgStageStats> stages = cam->stats();
+        all.insert(all.end(), stages.begin(), stages.end());
+    }
+    return all;
+}
+
+std::string MjpgServer::pipelineTable()
+{
+    std::vector<MjpgStageStats> all = this->getPipelineStats();
+    std::stringstream table;
+    for(size_t i = 0; i < all.size(); i++)
+    {
+        table << all[i].name << " " << all[i].depth << " " << all[i].dropped << " " << all[i].waiting << " " << all[i].working << "\n";
+    }
+    return table.str();
+}
+
+asio::io_service& MjpgServer::nextLoop()
+{
+    //Round robin so every core gets an even share of the clients
+    return *this->loops[this->nextloop++ % this->loops.size()];
+}
+
+MjpgTimerWheel& MjpgServer::wheelOf(asio::io_service &loop)
+{
+    for(size_t i = 0; i < this->loops.size(); i++)
+        if(this->loops[i].get() == &loop) return *this->wheels[i];
+    return *this->wheels[0];
+}
+
+MjpgUring* MjpgServer::ringOf(asio::io_service &loop)
+{
+    for(size_t i = 0; i < this->rings.size(); i++)
+        if(this->loops[i].get() == &loop) return this->rings[i].get();
+    return nullptr;
+}
+
+void MjpgServer::run(bool threaded_start) {
+    if(threaded_start) {
+        boost::thread t(boost::bind(&MjpgServer::run, this));
+        this->primary->start();
+    } else {
+        this->run();
+    }
+}
+
+
+void MjpgServer::run()
+{
+    std::cout << "Welcome to: " << this->name << std::endl << "Waiting for a clients..." << std::endl;
+    int count = this->eventloops;
+    if(count < 1) count = boost::thread::hardware_concurrency();
+    if(count < 1) count = 1;
+    for(int i = 0; i < count; i++)
+    {
+        this->loops.push_back(std::make_shared<asio::io_service>(1)); //Each loop is only ever run by one thread
+        this->loopwork.push_back(std::make_shared<asio::io_service::work>(*this->loops.back()));
+        this->wheels.push_back(std::make_shared<MjpgTimerWheel>(*this->loops.back()));
+    }
+    for(int i = 0; this->uring && i < count; i++)
+    {
+        this->rings.push_back(std::make_shared<MjpgUring>(*this->loops[i], 256, 16, this->uringsubmits, this->uringentries,
+                                                             this->uringfailures));
+        if(!this->rings.back()->ready())
+        {
+            std::cout << "io_uring isn't available, sending through asio" << std::endl;
+            this->rings.clear();
+            this->uring = false;
+        }
+    }
+    std::cout << "Serving on " << count << " event loops" << (this->uring ? " with io_uring" : "") << std::endl;
+    MjpgServer::server s(*this->loops[0], this, this->port);
+    boost::thread_group pool;
+    for(int i = 1; i < count; i++)
+    {
+        asio::io_service *loop = this->loops[i].get();
+        pool.create_thread([loop]() { loop->run(); });
+    }
+    this->loops[0]->run(); //The acceptor shares the first loop with its clients
+    pool.join_all();
+}
+
+MjpgServer::session::~session()
+{
+    if(this->streaming)
+    {
+        this->master->connections -= 1;
+        this->source_->leave();
+        boost::mutex::scoped_lock l(this->master->streams_mutex);
+        this->master->streams.erase(this);
+    }
+    if(this->polling_) this->source_->leave();
+    if(this->ring_ && this->socket_.is_open()) this->ring_->release(this->socket_.native_handle());
+}
+
+void MjpgServer::session::start(MjpgServer *server)
+{
+    this->master = server;
+    this->readRequest();
+}
+
+tcp::socket& MjpgServer::session::socket()
+{
+    return this->socket_;
+}
+
+void MjpgServer::session::readRequest()
+{
+    MjpgHttpParser::result parsed = this->parser_.parse();
+    if(parsed != MjpgHttpParser::incomplete)
+    {
+        this->onRequest(parsed); //Pipelined behind the last one
+        return;
+    }
+    if(this->master->readtimeout > 0)
+    {
+        this->deadline_.expires_from_now(std::chrono::milliseconds(this->master->readtimeout));
+        this->deadline_.async_wait(boost::bind(&session::onIdle, shared_from_this(),
+                                               asio::placeholders::error));
+    }
+    this->socket_.async_read_some(this->parser_.prepare(),
+                                  boost::bind(&session::onRead, shared_from_this(),
+                                              asio::placeholders::error, asio::placeholders::bytes_transferred));
+}
 
-tcp::socket& MjpgServer::session::socket()
+void MjpgServer::session::onRead(const boost::system::error_code& error, size_t bytes)
 {
-    return this->socket_;
+    if(error)
+    {
+        this->close(); //Client hung up or the read deadline passed
+        return;
+    }
+    MjpgHttpParser::result parsed = this->parser_.commit(bytes);
+    if(parsed == MjpgHttpParser::incomplete)
+    {
+        this->socket_.async_read_some(this->parser_.prepare(),
+                                      boost::bind(&session::onRead, shared_from_this(),
+                                                  asio::placeholders::error, asio::placeholders::bytes_transferred));
+        return;
+    }
+    this->onRequest(parsed);
+}
+
+void MjpgServer::session::onRequest(MjpgHttpParser::result parsed)
+{
+    this->disarm();
+    if(parsed == MjpgHttpParser::toolarge)
+    {
+        this->master->largerequests.add();
+        this->respond("HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", false);
+        return;
+    }
+    if(parsed == MjpgHttpParser::bodytoolarge)
+    {
+        this->master->largebodies.add();
+        this->respond("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", false);
+        return;
+    }
+    if(parsed == MjpgHttpParser::invalid)
+    {
+        this->master->badrequests.add();
+        this->respond("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", false);
+        return;
+    }
+    this->keepalive_ = this->parser_.request().keepalive;
+    this->master->onAccept(shared_from_this(), this->parser_.request());
+}
+
+void MjpgServer::session::onIdle(const boost::system::error_code& error)
+{
+    if(error || !this->expired()) return; //A request arrived in time
+    this->close();
+}
+
+void MjpgServer::session::disarm()
+{
+    this->deadline_.expires_at(std::chrono::steady_clock::time_point::max()); //Also cancels the wait
+}
+
+bool MjpgServer::session::expired()
+{
+    //A handler that fired just before its deadline was moved still runs without an error
+    return this->deadline_.expires_at() <= std::chrono::steady_clock::now();
+}
+
+void MjpgServer::session::respond(const std::string& head, bool keepalive)
+{
+    this->respond(head, MjpgFramePtr(), keepalive);
+}
+
+void MjpgServer::session::respond(const std::string& head, MjpgFramePtr body, bool keepalive)
+{
+    this->outgoing_ = head;
+    this->inflight_ = body;
+    boost::array<asio::const_buffer, 2> parts = {{
+        asio::buffer(this->outgoing_),
+        body ? asio::buffer(body->content().jpeg) : asio::const_buffer() //Nothing may follow the body on a kept alive connection
+    }};
+    asio::async_write(this->socket_, parts,
+                      boost::bind(&session::onResponse, shared_from_this(),
+                                  asio::placeholders::error, keepalive));
+}
+
+void MjpgServer::session::onResponse(const boost::system::error_code& error, bool keepalive)
+{
+    this->inflight_.reset();
+    if(error || !keepalive || !this->keepalive_)
+    {
+        this->close();
+        return;
+    }
+    this->parser_.consume();
+    this->readRequest();
+}
+
+void MjpgServer::session::stream(const std::string& initresponse, source_ptr cam, MjpgProfilePtr profile, int fps)
+{
+    this->profile_ = profile;
+    this->source_ = cam;
+    this->fps_ = fps;
+    this->requested_ = std::chrono::steady_clock::now();
+    this->wheel_ = &this->master->wheelOf(this->loop_);
+    this->ring_ = this->master->ringOf(this->loop_);
+    this->outgoing_ = initresponse + "\r\n";
+    this->streaming = true;
+    this->master->connections += 1;
+    cam->join(); //Starts or wakes up the pipeline, the profile's last frame goes out meanwhile
+    {
+        boost::mutex::scoped_lock l(this->master->streams_mutex);
+        this->master->streams[this] = shared_from_this();
+    }
+    this->tune();
+    this->watch();
+    asio::async_write(this->socket_, asio::buffer(this->outgoing_),
+                      boost::bind(&session::onFrame, shared_from_this(),
+                                  asio::placeholders::error));
+}
+
+void MjpgServer::session::poll(source_ptr cam, MjpgProfilePtr profile, unsigned long after, const std::string& etag)
+{
+    this->source_ = cam;
+    this->profile_ = profile; //Keeps the profile encoding until the poll is answered
+    this->after_ = after;
+    this->etag_ = etag;
+    this->polling_ = true;
+    cam->join(); //Wakes a suspended source, it couldn't publish anything newer otherwise
+    //Also what keeps the session alive, the channel only holds on to it weakly
+    this->deadline_.expires_from_now(std::chrono::milliseconds(std::max(this->master->polltimeout, 0)));
+    this->deadline_.async_wait(boost::bind(&session::onPollTimeout, shared_from_this(),
+                                           asio::placeholders::error));
+    MjpgFramePtr latest = profile->channel.latest();
+    profile->channel.wait(shared_from_this(), this->loop_, latest ? latest->seq : 0,
+                          [this](MjpgFramePtr frame) { this->onPollFrame(frame); });
+}
+
+void MjpgServer::session::onPollFrame(MjpgFramePtr frame)
+{
+    if(!this->polling_ || !this->socket_.is_open()) return; //Timed out or a wake up left over from an earlier poll
+    if(frame->captureseq <= this->after_)
+    {
+        this->profile_->channel.wait(shared_from_this(), this->loop_, frame->seq,
+                                     [this](MjpgFramePtr frame) { this->onPollFrame(frame); });
+        return;
+    }
+    this->endPoll();
+    this->master->sendJpg(shared_from_this(), frame, this->etag_);
+}
+
+void MjpgServer::session::onPollTimeout(const boost::system::error_code& error)
+{
+    if(error || !this->polling_ || !this->expired()) return; //A frame came first
+    MjpgFramePtr latest = this->profile_->channel.latest();
+    this->endPoll();
+    if(!latest)
+    {
+        std::string resp = "<p>The camera <b>hasn't published</b> a frame yet</p>";
+        this->master->sendError(shared_from_this(), resp);
+        return;
+    }
+    this->master->sendJpg(shared_from_this(), latest, this->etag_);
+}
+
+void MjpgServer::session::endPoll()
+{
+    this->polling_ = false;
+    this->disarm();
+    this->profile_.reset(); //A kept alive connection shouldn't hold the profile
+    this->source_->leave();
+}
+
+void MjpgServer::session::websocket(const std::string& upgraded, source_ptr cam, MjpgProfilePtr profile, int fps, int window)
+{
+    this->profile_ = profile;
+    this->source_ = cam;
+    this->fps_ = fps;
+    this->window_ = window;
+    this->requested_ = std::chrono::steady_clock::now();
+    this->wheel_ = &this->master->wheelOf(this->loop_);
+    this->ws_.reset(new MjpgWebSocket());
+    boost::string_ref early = this->parser_.remaining(); //Whatever the client sent right behind the upgrade
+    if(!this->ws_->append(early.data(), early.size())) this->wsclosing_ = true; //Can't be a handful of acks
+    this->streaming = true;
+    this->master->connections += 1;
+    cam->join();
+    {
+        boost::mutex::scoped_lock l(this->master->streams_mutex);
+        this->master->streams[this] = shared_from_this();
+    }
+    this->tune();
+    std::cout << "Client connected to websocket!" << std::endl;
+    this->wscontrol_ = upgraded; //Goes out ahead of the first frame
+    this->wsSend();
+    this->wsRead();
+}
+
+void MjpgServer::session::wsRead()
+{
+    this->socket_.async_read_some(asio::buffer(this->discard_),
+                                  boost::bind(&session::onWsRead, shared_from_this(),
+                                              asio::placeholders::error, asio::placeholders::bytes_transferred));
+}
+
+void MjpgServer::session::onWsRead(const boost::system::error_code& error, size_t bytes)
+{
+    if(error)
+    {
+        this->close();
+        return;
+    }
+    MjpgWebSocket::message message;
+    MjpgWebSocket::result read;
+    if(!this->ws_->append(this->discard_, bytes))
+    {
+        this->wscontrol_ += MjpgWebSocket::control(MjpgWebSocket::CLOSE, boost::string_ref("\x03\xF1", 2)); //1009 message too big
+        this->wsclosing_ = true;
+    }
+    while(!this->wsclosing_ && (read = this->ws_->next(message)) != MjpgWebSocket::incomplete)
+    {
+        if(read == MjpgWebSocket::invalid)
+        {
+            this->wscontrol_ += MjpgWebSocket::control(MjpgWebSocket::CLOSE, boost::string_ref("\x03\xEA", 2)); //1002 protocol error
+            this->wsclosing_ = true;
+        }
+        else if(message.opcode == MjpgWebSocket::TEXT || message.opcode == MjpgWebSocket::BINARY)
+        {
+            if(this->unacked_ > 0) this->unacked_--; //Acks the oldest frame still out
+        }
+        else if(message.opcode == MjpgWebSocket::PING)
+        {
+            this->wscontrol_ += MjpgWebSocket::control(MjpgWebSocket::PONG, message.payload);
+        }
+        else if(message.opcode == MjpgWebSocket::CLOSE)
+        {
+            this->wscontrol_ += MjpgWebSocket::control(MjpgWebSocket::CLOSE, boost::string_ref(message.payload).substr(0, 2)); //Echo the status code
+            this->wsclosing_ = true;
+        }
+    }
+    this->wsSend();
+    if(!this->wsclosing_) this->wsRead();
+}
+
+void MjpgServer::session::wsSend()
+{
+    //Only ever one write on the socket, whatever comes up meanwhile waits for onWsWritten
+    if(this->wswriting_ || !this->socket_.is_open()) return;
+    if(!this->wscontrol_.empty())
+    {
+        this->wsout_.swap(this->wscontrol_);
+        this->wscontrol_.clear();
+        this->wswriting_ = true;
+        asio::async_write(this->socket_, asio::buffer(this->wsout_),
+                          boost::bind(&session::onWsWritten, shared_from_this(),
+                                      asio::placeholders::error));
+        return;
+    }
+    if(this->wsclosing_)
+    {
+        this->close();
+        return;
+    }
+    if(this->wsnext_)
+    {
+        this->inflight_.swap(this->wsnext_);
+        this->wsnext_.reset();
+        this->watchWrite();
+        this->master->sentage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->inflight_->captured).count());
+        this->wsheadlength_ = MjpgWebSocket::header(this->wshead_, MjpgWebSocket::BINARY, this->inflight_->content().jpeg.size());
+        boost::array<asio::const_buffer, 2> parts = {{
+            asio::buffer(this->wshead_, this->wsheadlength_),
+            asio::buffer(this->inflight_->content().jpeg) //Straight from the shared frame
+        }};
+        this->wswriting_ = true;
+        asio::async_write(this->socket_, parts,
+                          boost::bind(&session::onWsWritten, shared_from_this(),
+                                      asio::placeholders::error));
+        return;
+    }
+    if(this->wswaiting_ || this->unacked_ >= this->window_) return; //The next ack sends the newest frame
+    this->wswaiting_ = true;
+    this->ready_ = this->profile_->channel.sequence();
+    int cap = this->rate();
+    if(cap > 0)
+        this->wheel_->ticker(cap).wait(shared_from_this(), [this]() { this->wsNext(); });
+    else
+        this->wsNext();
+}
+
+void MjpgServer::session::wsNext()
+{
+    this->profile_->channel.wait(shared_from_this(), this->loop_, this->sent_,
+                                 [this](MjpgFramePtr frame) { this->onWsPublish(frame); });
+}
+
+void MjpgServer::session::onWsPublish(MjpgFramePtr frame)
+{
+    this->wswaiting_ = false;
+    if(!this->socket_.is_open() || this->wsclosing_) return;
+    this->countDrops(frame->seq);
+    this->wsnext_ = frame; //Goes out right away unless a pong or close is still being written
+    this->sent_ = frame->seq;
+    this->unacked_++;
+    int cap = this->rate();
+    this->jitter_.tick(cap > 0 ? this->wheel_->ticker(cap).interval() : std::chrono::steady_clock::duration::zero());
+    this->wsSend();
+}
+
+void MjpgServer::session::onWsWritten(const boost::system::error_code& error)
+{
+    this->wswriting_ = false;
+    if(error)
+    {
+        std::cout << "Client disconnect" << std::endl;
+        this->close();
+        return;
+    }
+    this->wsout_.clear();
+    if(this->inflight_)
+    {
+        this->writing_ = std::chrono::steady_clock::time_point();
+        this->framessent_++;
+        this->master->sentframes.add();
+        size_t bytes = this->wsheadlength_ + this->inflight_->content().jpeg.size();
+        this->master->sentbytes.add(bytes);
+        this->master->copybytes.add(bytes);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(this->framessent_ == 1)
+            this->master->firstframetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->requested_).count());
+        this->master->sendlatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->inflight_->published).count());
+        this->master->writtenage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->inflight_->captured).count());
+        this->inflight_.reset();
+    }
+    this->wsSend();
+}
+
+void MjpgServer::session::countDrops(unsigned long seq)
+{
+    //The channel only ever holds the newest frame, anything published while we were still writing (or waiting on acks)
+    //was replaced. What the rate cap skipped afterwards was meant to be skipped so it doesn't count
+    unsigned long busy = std::min(seq - 1, this->ready_);
+    if(this->sent_ == 0 || busy <= this->sent_) return;
+    this->framesdropped_ += busy - this->sent_;
+    this->source_->clientdrops->add(busy - this->sent_);
+}
+
+void MjpgServer::session::nextFrame()
+{
+    //Park until the pull loop publishes something we haven't sent yet, a lambda of only this fits std::function without allocating
+    this->profile_->channel.wait(shared_from_this(), this->loop_, this->sent_,
+                               [this](MjpgFramePtr frame) { this->onPublish(frame); });
+}
+
+void MjpgServer::session::onPublish(MjpgFramePtr frame)
+{
+    if(!this->socket_.is_open()) return;
+    this->countDrops(frame->seq);
+    this->inflight_ = frame;
+    this->sent_ = frame->seq;
+    int cap = this->rate();
+    this->jitter_.tick(cap > 0 ? this->wheel_->ticker(cap).interval() : std::chrono::steady_clock::duration::zero());
+    this->watchWrite();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    this->stamplength_ = MjpgFrame::stamp(this->stamp_, now);
+    this->master->sentage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame->captured).count());
+    if(this->ring_)
+    {
+        //Submitted with every other client of this loop the same publish woke
+        this->zerocopying_ = false;
+        this->ring_->send(this->socket_.native_handle(), frame, asio::buffer(this->stamp_, this->stamplength_),
+                          std::bind(&session::onRingSent, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+        return;
+    }
+    this->zerocopying_ = this->zerocopy_ && frame->content().jpeg.size() >= (size_t) this->master->zerocopy;
+    if(this->zerocopying_)
+    {
+        //The kernel may read the part long after this write returns, so it gets a stamp of its own
+        this->zcpart_ = this->zeroCopyPart();
+        this->zcpart_->frame = frame;
+        this->zcpart_->stamplength = MjpgFrame::stamp(this->zcpart_->stamp, now);
+        this->zcsent_ = 0;
+        this->sendZeroCopy();
+        return;
+    }
+    asio::async_write(this->socket_, this->inflight_->buffers(asio::buffer(this->stamp_, this->stamplength_)), //Gather write straight from the shared frame
+                      boost::bind(&session::onFrame, shared_from_this(),
+                                  asio::placeholders::error));
+}
+
+std::shared_ptr<MjpgZeroCopyFrame> MjpgServer::session::zeroCopyPart()
+{
+    this->zcpart_.reset();
+    for(size_t i = 0; i < this->zcparts_.size(); i++)
+    {
+        if(this->zcparts_[i].use_count() == 1) return this->zcparts_[i];
+    }
+    std::shared_ptr<MjpgZeroCopyFrame> part = std::make_shared<MjpgZeroCopyFrame>();
+    //Slow completions only add holders up to a few, past that the extra ones aren't kept
+    if(this->zcparts_.size() < 4) this->zcparts_.push_back(part);
+    return part;
+}
+
+void MjpgServer::session::sendZeroCopy()
+{
+    const MjpgFrame &frame = *this->zcpart_->frame;
+    struct iovec whole[4] = {
+        { (void *) frame.header.data(), frame.header.size() },
+        { this->zcpart_->stamp, this->zcpart_->stamplength },
+        { (void *) frame.content().jpeg.data(), frame.content().jpeg.size() },
+        { (void *) "\r\n", 2 }
+    };
+    int fd = this->socket_.native_handle();
+    for(;;)
+    {
+        //Skip whatever earlier sends already took
+        struct iovec parts[4];
+        int count = 0;
+        size_t skip = this->zcsent_;
+        for(int i = 0; i < 4; i++)
+        {
+            if(skip >= whole[i].iov_len)
+            {
+                skip -= whole[i].iov_len;
+                continue;
+            }
+            parts[count].iov_base = (char *) whole[i].iov_base + skip;
+            parts[count].iov_len = whole[i].iov_len - skip;
+            skip = 0;
+            count++;
+        }
+        if(count == 0) break;
+        long sent = this->zerocopy_->send(fd, parts, count, this->zcpart_);
+        if(sent >= 0)
+        {
+            this->zcsent_ += sent;
+            continue;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            this->reapZeroCopy();
+            this->socket_.async_wait(tcp::socket::wait_write,
+                                     boost::bind(&session::onWritable, shared_from_this(),
+                                                 asio::placeholders::error));
+            return;
+        }
+        if(errno == ENOBUFS)
+        {
+            //Out of memory to pin pages (optmem), copy the rest of this part instead
+            std::vector<asio::const_buffer> rest;
+            for(int i = 0; i < count; i++) rest.push_back(asio::buffer(parts[i].iov_base, parts[i].iov_len));
+            this->master->copybytes.add(asio::buffer_size(rest));
+            asio::async_write(this->socket_, rest,
+                              boost::bind(&session::onFrame, shared_from_this(),
+                                          asio::placeholders::error));
+            return;
+        }
+        this->loop_.post(boost::bind(&session::onFrame, shared_from_this(),
+                                     boost::system::error_code(errno, boost::system::system_category())));
+        return;
+    }
+    this->reapZeroCopy();
+    //Completes asynchronously like any other write
+    this->loop_.post(boost::bind(&session::onFrame, shared_from_this(), boost::system::error_code()));
+}
+
+void MjpgServer::session::onWritable(const boost::system::error_code& error)
+{
+    if(error)
+    {
+        this->onFrame(error);
+        return;
+    }
+    this->sendZeroCopy();
+}
+
+void MjpgServer::session::reapZeroCopy()
+{
+    if(!this->socket_.is_open()) return;
+    bool pending = this->zerocopy_->reap(this->socket_.native_handle());
+    for(size_t i = 0; i < this->zcparts_.size(); i++)
+    {
+        //A free holder mustn't keep its frame from going back to the pool
+        if(this->zcparts_[i].use_count() == 1) this->zcparts_[i]->frame.reset();
+    }
+    if(!pending || this->zcwaiting_) return;
+    //Completions show up as socket errors, the session and its pinned frames live until they all came back
+    this->zcwaiting_ = true;
+    this->socket_.async_wait(tcp::socket::wait_error,
+                             boost::bind(&session::onCompletion, shared_from_this(),
+                                         asio::placeholders::error));
+}
+
+void MjpgServer::session::onCompletion(const boost::system::error_code& error)
+{
+    this->zcwaiting_ = false;
+    if(error) return; //Closed, close() took the frames still pinned out of the pool
+    this->reapZeroCopy();
+}
+
+void MjpgServer::session::onRingSent(size_t sent, int error)
+{
+    if(error)
+    {
+        this->onFrame(boost::system::error_code(error, boost::system::system_category()));
+        return;
+    }
+    //The socket was full before the whole part fit, asio writes the rest once it drains
+    boost::array<asio::const_buffer, 4> parts = this->inflight_->buffers(asio::buffer(this->stamp_, this->stamplength_));
+    std::vector<asio::const_buffer> rest;
+    for(size_t i = 0; i < parts.size(); i++)
+    {
+        size_t length = asio::buffer_size(parts[i]);
+        if(sent >= length)
+        {
+            sent -= length;
+            continue;
+        }
+        rest.push_back(parts[i] + sent);
+        sent = 0;
+    }
+    if(rest.empty())
+    {
+        this->onFrame(boost::system::error_code());
+        return;
+    }
+    asio::async_write(this->socket_, rest,
+                      boost::bind(&session::onFrame, shared_from_this(),
+                                  asio::placeholders::error));
+}
+
+void MjpgServer::session::watchWrite()
+{
+    this->writing_ = std::chrono::steady_clock::now();
+    if(!this->watching_ && this->master->sendtimeout > 0) this->watchSend(); //Otherwise the running watch gets to this write too
+}
+
+void MjpgServer::session::watchSend()
+{
+    this->watching_ = true;
+    this->deadline_.expires_at(this->writing_ + std::chrono::milliseconds(this->master->sendtimeout));
+    this->deadline_.async_wait(boost::bind(&session::onDeadline, shared_from_this(),
+                                           asio::placeholders::error));
+}
+
+void MjpgServer::session::onDeadline(const boost::system::error_code& error)
+{
+    if(error || !this->expired()) return; //Taken down with the connection
+    this->watching_ = false;
+    if(this->writing_ == std::chrono::steady_clock::time_point()) return; //Between frames, the next write watches again
+    if(this->writing_ + std::chrono::milliseconds(this->master->sendtimeout) > std::chrono::steady_clock::now())
+    {
+        this->watchSend(); //A later write than the one the watch started with, it gets its full time
+        return;
+    }
+    std::cout << "Client too slow to take a frame, removing client" << std::endl;
+    this->close();
+}
+
+void MjpgServer::session::tune()
+{
+    boost::system::error_code ignored;
+    tcp::endpoint remote = this->socket_.remote_endpoint(ignored);
+    std::stringstream address;
+    address << remote.address().to_string() << ":" << remote.port();
+    this->address_ = address.str();
+    this->socket_.set_option(tcp::no_delay(true), ignored);
+    if(this->master->sendbuffer > 0)
+        this->socket_.set_option(asio::socket_base::send_buffer_size(this->master->sendbuffer), ignored);
+#ifdef TCP_NOTSENT_LOWAT
+    if(this->master->sendlowat > 0)
+    {
+        //Only report writable once the previous frame has nearly drained so the next pick is the freshest
+        int lowat = this->master->sendlowat;
+        setsockopt(this->socket_.native_handle(), IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+    }
+#endif
+    if(this->master->zerocopy >= 0 && MjpgZeroCopy::enable(this->socket_.native_handle()))
+        this->zerocopy_.reset(new MjpgZeroCopy(this->master->zerocopybytes, this->master->zerocopiedbytes));
+}
+
+MjpgServer::ClientStats MjpgServer::session::stats()
+{
+    ClientStats current;
+    current.address = this->address_;
+    current.sent = this->framessent_;
+    current.dropped = this->framesdropped_;
+    current.fps = this->fps_;
+    if(this->source_)
+    {
+        current.source = this->source_->name;
+        if(this->source_->controlfps > 0 && (current.fps <= 0 || current.fps > this->source_->controlfps))
+            current.fps = this->source_->controlfps;
+    }
+    current.interval = this->jitter_.interval();
+    current.jitter = this->jitter_.jitter();
+    current.worst = this->jitter_.worst();
+    return current;
+}
+
+int MjpgServer::session::rate()
+{
+    //The source's fps caps all of its viewers, a client may only ask for less
+    int cap = this->fps_;
+    int global = this->source_->controlfps;
+    if(global > 0 && (cap <= 0 || cap > global)) cap = global;
+    return cap;
+}
+
+void MjpgServer::session::onFrame(const boost::system::error_code& error)
+{
+    if(error)
+    {
+        std::cout << "Client disconnect" << std::endl;
+        this->close();
+        return;
+    }
+    if(this->inflight_)
+    {
+        this->writing_ = std::chrono::steady_clock::time_point();
+        this->framessent_++;
+        this->master->sentframes.add();
+        size_t bytes = this->inflight_->header.size() + this->stamplength_ + this->inflight_->content().jpeg.size() + 2;
+        this->master->sentbytes.add(bytes);
+        if(!this->zerocopying_) this->master->copybytes.add(bytes); //Zerocopy bytes are counted as their completions come in
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(this->framessent_ == 1)
+            this->master->firstframetime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->requested_).count());
+        this->master->sendlatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->inflight_->published).count());
+        this->master->writtenage.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->inflight_->captured).count());
+        this->inflight_.reset();
+    }
+    else
+    {
+        std::cout << "Client connected to stream!" << std::endl;
+    }
+    this->ready_ = this->profile_->channel.sequence();
+    int cap = this->rate();
+    if(cap > 0) //Wait for the next absolute tick of the cap shared by every client of that rate on this loop
+        this->wheel_->ticker(cap).wait(shared_from_this(), [this]() { this->nextFrame(); });
+    else
+        this->nextFrame();
+}
+
+void MjpgServer::session::watch()
+{
+    //Stream clients never send anything, a finished read means they hung up
+    this->socket_.async_read_some(asio::buffer(this->discard_),
+                                  boost::bind(&session::onWatch, shared_from_this(),
+                                              asio::placeholders::error));
+}
+
+void MjpgServer::session::onWatch(const boost::system::error_code& error)
+{
+    if(error)
+    {
+        this->close();
+        return;
+    }
+    this->watch();
+}
+
+void MjpgServer::session::close()
+{
+    boost::system::error_code ignored;
+    this->disarm();
+    //The ring holds its own reference to the socket, drop it before the descriptor can be reused
+    if(this->ring_ && this->socket_.is_open()) this->ring_->release(this->socket_.native_handle());
+    if(this->zerocopy_ && this->zerocopy_->pending() > 0 && this->socket_.is_open())
+    {
+        //A plain close still sends what's queued out of the pinned pages, reset the connection instead
+        //and free those frames once they're let go rather than encoding into them again
+        std::vector<MjpgFramePtr> pinned;
+        this->zerocopy_->pinned(pinned);
+        for(size_t i = 0; i < pinned.size(); i++) this->master->encodedpool.forget(pinned[i]);
+        this->socket_.set_option(asio::socket_base::linger(true, 0), ignored);
+    }
+    else
+    {
+        this->socket_.shutdown(tcp::socket::shutdown_both, ignored);
+    }
+    this->socket_.close(ignored);
 }
 
 void MjpgServer::server::start_accept()
 {
-    session* new_session = new session(io_service_);
+    //Accept onto the next event loop so client sessions are sharded across the cores
+    session_ptr new_session = std::make_shared<session>(this->master->nextLoop(), this->master->maxrequest);
     acceptor_.async_accept(new_session->socket(),
                            boost::bind(&server::handle_accept, this, new_session,
                                        boost::asio::placeholders::error));
 }
 
+bool MjpgServer::server::start_multishot()
+{
+    MjpgUring *ring = this->master->ringOf(this->io_service_);
+    return ring && ring->accept(this->acceptor_.native_handle(),
+                                std::bind(&server::handle_fd, this, std::placeholders::_1));
+}
+
+void MjpgServer::server::handle_fd(int fd)
+{
+    if(fd < 0)
+    {
+        this->master->accepterrors.add();
+        if(fd == -EINVAL || fd == -EOPNOTSUPP)
+        {
+            std::cout << "Kernel can't do multishot accept, accepting through asio" << std::endl;
+            start_accept();
+        }
+        return;
+    }
+    session_ptr new_session = std::make_shared<session>(this->master->nextLoop(), this->master->maxrequest);
+    boost::system::error_code error;
+    new_session->socket().assign(tcp::v4(), fd, error);
+    if(error)
+    {
+        ::close(fd);
+        this->master->accepterrors.add();
+        return;
+    }
+    new_session->loop().post(boost::bind(&session::start, new_session, this->master));
+}
+
 void MjpgServer::server::cleanup()
 {
-    this->io_service_.stop();
+    for(size_t i = 0; i < this->master->loops.size(); i++)
+        this->master->loops[i]->stop();
 }
 
-void MjpgServer::server::handle_accept(session* new_session, const boost::system::error_code& error)
+void MjpgServer::server::handle_accept(session_ptr new_session, const boost::system::error_code& error)
 {
     if (!error)
     {
-        new_session->start(this->master);
+        //Hand the session to the loop that owns its socket
+        new_session->loop().post(boost::bind(&session::start, new_session, this->master));
     }
     else
     {
-        delete new_session;
+        this->master->accepterrors.add();
     }
 
     start_accept();
@@ -29,6 +29,8 @@
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <map>
+#include <set>
 #include <cstddef>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -37,15 +39,36 @@
 #include <chrono>
 #include <functional>
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <future>
+#include <atomic>
+#include <memory>
 #include <boost/chrono.hpp>
 #include <unistd.h>
+#include <netinet/tcp.h>
+#include "mjpgframe.h"
+#include "mjpgchannel.h"
+#include "mjpgprofile.h"
+#include "mjpgencoder.h"
+#include "mjpgring.h"
+#include "mjpgpipeline.h"
+#include "mjpgpool.h"
+#include "mjpghttp.h"
+#include "mjpgpacer.h"
+#include "mjpgchange.h"
+#include "mjpgrelay.h"
+#include "mjpgshm.h"
+#include "mjpgmetrics.h"
+#include "mjpgzerocopy.h"
+#include "mjpguring.h"
+#include "mjpgwebsocket.h"
 
 
 namespace asio = boost::asio;
@@ -53,6 +76,26 @@ using boost::asio::ip::tcp;
 
 class MjpgServer
 {
+public:
+    //!Snapshot of one streaming client's delivery counters
+    struct ClientStats
+    {
+        std::string address;
+        unsigned long sent;
+        unsigned long dropped;
+        //!Rate cap the client is paced at or -1 when unpaced
+        int fps;
+        //!Smoothed interval between delivered frames (ms)
+        double interval;
+        //!Smoothed deviation of the interval from the cap (ms)
+        double jitter;
+        //!Largest deviation seen (ms)
+        double worst;
+        //!The camera the client watches
+        std::string source;
+    };
+
+private:
     int port = 80;
     std::string name = "Titan 5431 MjpgServer";
     std::string boundary = "--titanboundary";
@@ -61,18 +104,72 @@ class MjpgServer
     std::string defErr = "<p>Bad request</p>";
     std::string tooManyErr = "<p>There are <b>too many</b> connections on the line!</p>";
     long maxfailpackets = 30;
-    float fps = 0.0f;
-    int controlfps = -1;
+    int linger = 10000;
+    int changethreshold = -1;
+    int keepalivefps = -1;
     int samplefps = 50;
-    int settlefps = -1;
-    int quality = -1;
-    int connections = 0;
+    std::atomic<int> connections{0};
     int maxconnections = -1;
-    int resized[2] = {-1, -1};
-    cv::VideoCapture cap;
-    bool pullcap = false;
-    std::string content;
+    std::map<std::string, MjpgRendition> namedprofiles;
+    boost::mutex profiles_mutex;
+    MjpgEncoderTuning tuning;
+    MjpgEncoderPtr encoder;
+    std::shared_ptr<MjpgStripEncoder> stripencoder;
+    int maxprofiles = 8;
     boost::mutex global_mutex;
+    int eventloops = -1;
+    int sendbuffer = -1;
+    int sendlowat = 16384;
+    int sendtimeout = 5000;
+    int zerocopy = -1;
+    int maxrequest = 8192;
+    int readtimeout = 10000;
+    int polltimeout = 30000;
+    int wswindow = 2;
+    //!Makes snapshot etags of one server run differ from those of the last one
+    std::string etagbase;
+    std::atomic<unsigned> nextloop{0};
+    std::vector<std::shared_ptr<asio::io_service> > loops;
+    std::vector<std::shared_ptr<asio::io_service::work> > loopwork;
+    std::vector<std::shared_ptr<MjpgTimerWheel> > wheels;
+    bool uring = false;
+    std::vector<std::shared_ptr<MjpgUring> > rings;
+    MjpgMatPool framepool{"frames"};
+    MjpgMatPool resizepool{"resized"};
+    MjpgFramePool encodedpool;
+    MjpgObjectPool<MjpgPipelineJob> jobpool{"jobs"};
+    //!Encode threads shared by every source's encode stage and the strip encoder
+    MjpgWorkers encoders;
+    int pipelinedepth = 2;
+    MjpgMetrics metrics;
+    MjpgHistogram &capturetime = metrics.histogram("mjpg_capture_seconds", "Time spent pulling a frame from the source", 1e-9, 10, 34);
+    MjpgHistogram &resizetime = metrics.histogram("mjpg_resize_seconds", "Time spent resizing a frame for one rendition", 1e-9, 10, 34);
+    MjpgHistogram &encodetime = metrics.histogram("mjpg_encode_seconds", "Time spent encoding one rendition of a frame", 1e-9, 10, 34);
+    MjpgHistogram &encodedbytes = metrics.histogram("mjpg_encoded_bytes", "Size of every encoded jpeg", 1.0, 10, 26);
+    MjpgHistogram &sendlatency = metrics.histogram("mjpg_publish_to_send_seconds", "Time from publishing a frame until a client's write of it completed", 1e-9, 10, 34);
+    MjpgHistogram &encodedage = metrics.histogram("mjpg_frame_age_seconds", "Time since capture when a frame reached a stage", 1e-9, 10, 34, "stage=\"encoded\"");
+    MjpgHistogram &publishedage = metrics.histogram("mjpg_frame_age_seconds", "Time since capture when a frame reached a stage", 1e-9, 10, 34, "stage=\"published\"");
+    MjpgHistogram &sentage = metrics.histogram("mjpg_frame_age_seconds", "Time since capture when a frame reached a stage", 1e-9, 10, 34, "stage=\"sent\"");
+    MjpgHistogram &writtenage = metrics.histogram("mjpg_frame_age_seconds", "Time since capture when a frame reached a stage", 1e-9, 10, 34, "stage=\"written\"");
+    MjpgCounter &sentframes = metrics.counter("mjpg_sent_frames_total", "Stream frames written to clients");
+    MjpgCounter &sentbytes = metrics.counter("mjpg_sent_bytes_total", "Stream bytes written to clients");
+    MjpgCounter &copybytes = metrics.counter("mjpg_send_path_bytes_total", "Stream bytes by how the kernel sent them", "path=\"copy\"");
+    MjpgCounter &zerocopybytes = metrics.counter("mjpg_send_path_bytes_total", "Stream bytes by how the kernel sent them", "path=\"zerocopy\"");
+    MjpgCounter &zerocopiedbytes = metrics.counter("mjpg_send_path_bytes_total", "Stream bytes by how the kernel sent them", "path=\"zerocopy_copied\"");
+    MjpgCounter &uringsubmits = metrics.counter("mjpg_uring_submits_total", "io_uring_enter calls handing work to the kernel");
+    MjpgCounter &uringentries = metrics.counter("mjpg_uring_entries_total", "io_uring submission entries handed to the kernel");
+    MjpgCounter &uringfailures = metrics.counter("mjpg_uring_submit_failures_total", "io_uring_enter calls that failed to submit and were retried");
+    MjpgHistogram &resumetime = metrics.histogram("mjpg_resume_to_frame_seconds", "Time from a suspended source waking up until its first fresh frame was published", 1e-9, 10, 34);
+    MjpgHistogram &firstframetime = metrics.histogram("mjpg_first_frame_seconds", "Time from a stream request until its first frame was written", 1e-9, 10, 34);
+    MjpgCounter &accepterrors = metrics.counter("mjpg_accept_errors_total", "Failed accepts");
+    MjpgCounter &badrequests = metrics.counter("mjpg_parse_errors_total", "Requests rejected by the parser", "reason=\"invalid\"");
+    MjpgCounter &largerequests = metrics.counter("mjpg_parse_errors_total", "Requests rejected by the parser", "reason=\"toolarge\"");
+    MjpgCounter &largebodies = metrics.counter("mjpg_parse_errors_total", "Requests rejected by the parser", "reason=\"bodytoolarge\"");
+    MjpgCounter &snapshotslatest = metrics.counter("mjpg_snapshots_total", "Snapshot requests by how they were answered", "result=\"latest\"");
+    MjpgCounter &snapshotscaptured = metrics.counter("mjpg_snapshots_total", "Snapshot requests by how they were answered", "result=\"captured\"");
+    MjpgCounter &snapshotscoalesced = metrics.counter("mjpg_snapshots_total", "Snapshot requests by how they were answered", "result=\"coalesced\"");
+    MjpgCounter &snapshotspolled = metrics.counter("mjpg_snapshots_total", "Snapshot requests by how they were answered", "result=\"polled\"");
+    MjpgCounter &snapshotsunmodified = metrics.counter("mjpg_snapshots_total", "Snapshot requests by how they were answered", "result=\"not_modified\"");
 
 public:
     //! MjpgServer constructor
@@ -102,27 +199,57 @@ public:
 
     //! Attaches a pull method to the server
     /*!
-    Connects an OpenCv primitive method to a function pointer
-    That will called by the main loops ( @see setSettle() ) to
+    Connects an OpenCv primitive method to a function, lambda or any
+    other callable That will called by the main loops ( @see setSettle() ) to
     adjust threaded pull rate. Keep the map in BGR color space if
     you want the results to come out as expected. Please place inits
-    Out of this function. The pointer function/lambda must be in a
-    static contex
+    Out of this function. Whatever the callable captures has to outlive
+    the server. Applications that produce frames on their own thread
+    should rather hand them over ( @see publish() )
 
-    @param pullframe a function pointer to a mat return
+    @param pullframe returns the next frame or an empty mat on failure
 
-    Example: { @code  const auto proc = [&cap]() -> cv::Mat
+    Example: { @code server.attach([&cap]() -> cv::Mat
     {
         cv::Mat frame;
         if(!cap.read(frame)) std::cout << "bad frame" << std::endl;
         return frame;
-    };
-    static auto static_proc = proc;
-    cv::Mat (*ptr) () = []() -> cv::Mat { return static_proc(); };
-    server.attach(ptr);
+    });
     }
     */
-    void attach(cv::Mat (*pullframe)(void));
+    void attach(std::function<cv::Mat(void)>);
+
+    //! Hand the server a frame from the application's own thread
+    /*!
+    Instead of the server pulling, the frame is moved into the pipeline
+    and its resize and encode start right away on the source's threads,
+    so the call only queues it and returns. The pixels aren't copied, the
+    pipeline keeps them referenced until every profile encoded them, so
+    don't write into the same buffer again (pulling the next one from
+    acquireFrame() recycles them). Frames may come from several threads.
+    Only sources with nothing attached take frames, one that pulls drops
+    them. While nobody streamed for the linger ( @see setIdleLinger() )
+    frames aren't encoded, the newest is only kept for snapshots
+
+    Example: { @code cv::Mat frame = server.acquireFrame(720, 1280, CV_8UC3);
+    process(frame);
+    server.publish(std::move(frame));
+    }
+
+    @param frame the frame in BGR, left empty
+    @return true if it's being encoded, false if it was only kept because nobody watched or the source pulls
+    */
+    bool publish(cv::Mat &&);
+
+    //! Hand the server an already encoded jpeg from the application's own thread
+    /*!
+    Served as is to every profile that doesn't ask for another size or
+    quality, only decoded for the ones that do ( @see publish() )
+
+    @param jpeg a complete jpeg image, left empty
+    @return true if it's being published, false if it was only kept because nobody watched or the source pulls
+    */
+    bool publishEncoded(std::vector<unsigned char> &&);
 
     //! Custom release of stream reader
     /*!
@@ -178,6 +305,35 @@ public:
     */
     void setCapAttach(std::string);
 
+    //! Relay another mjpeg server or jpeg files without decoding them
+    /*!
+    Unlike setCapAttach(std::string) the upstream jpegs aren't decoded and
+    encoded again, their bytes are published as they are. Only profiles
+    asking for another size or a quality are decoded and encoded. The
+    upstream is reconnected whenever it fails or stalls.
+    Example:
+    { @code server.setRelayAttach("http://localhost:8080/mjpg"); }
+    ( @see MjpgRelay )
+
+    @param location an http:// url of an mjpeg stream, a directory of jpegs or a file of jpegs
+    */
+    void setRelayAttach(std::string);
+
+    //! Serve frames another process writes into shared memory
+    /*!
+    The producer links nothing but MjpgShmProducer and writes BGR, GRAY,
+    YUV or jpeg frames into a ring of preallocated slots. BGR and GRAY
+    slots are resized and encoded straight out of shared memory, jpeg
+    slots are relayed like setRelayAttach() does. A producer that exits
+    or stalls makes the source fail (viewers keep the last frame) until
+    a producer creates the ring again.
+    Example:
+    { @code server.setShmAttach("camera"); }
+
+    @param ring the name the producer created its ring with
+    */
+    void setShmAttach(std::string);
+
     //! Set stream quality (0 - 100)
     /*!
     Sets the server stream jpeg quality/compression value
@@ -204,7 +360,8 @@ public:
     That this value stays at a lower value because depending on the
     cpu this can eat up to 90% of your cpu since the server will try
     it's best to get to that value. This can also be regulated via the
-    REST client;
+    REST client; Frames are paced on absolute deadlines so the rate
+    doesn't drift, and a stream client can ask for less with /mjpg?fps=N
 
     @param fps an integer between 1 > ... or -1 to set unregulated which is 2ms delay
     */
@@ -279,76 +436,824 @@ public:
     */
     int getConnections();
 
-private:
-    //!Global thread shared frame
-    cv::Mat curframe;
+    //! Set the amount of event loops serving clients
+    /*!
+    Every client socket is owned by exactly one event loop thread and all of
+    its reads, writes and frame pacing run asynchronously on that loop. New
+    clients are handed out round robin so the load spreads over the cores.
+    Must be set before run() is called
+
+    @param loops number of loop threads or -1 to use one per cpu core
+    */
+    void setEventLoops(int);
+
+    //! Register a named stream profile
+    /*!
+    Clients can ask for a different size and quality than the default
+    stream with { @code /mjpg?w=320&h=180&q=40 } or by name with
+    { @code /mjpg?profile=thumb }. Each distinct profile is resized and
+    encoded once per frame no matter how many clients watch it and stops
+    being encoded when its last viewer leaves
+
+    @param name the name clients pass as profile=
+    @param width output width in pixels or -1 to keep the pulled size
+    @param height output height in pixels or -1 to keep the pulled size
+    @param quality jpeg quality between 0 - 100 or -1 unregulated
+    @param strips parallel strips to encode in ( @see setStrips() ) or -1
+    */
+    void addProfile(std::string, int, int, int, int = -1);
+
+    //! Tune the jpeg encoder
+    /*!
+    Trades frame size and picture quality against encode time. When the
+    library is built with MJPGSERVER_TURBOJPEG frames are encoded by
+    libjpeg-turbo with a compressor kept per encode thread and all knobs
+    apply, the default cv::imencode path only honours optimize
+
+    @param subsampling chroma subsampling as 444, 422 or 420
+    @param fastdct use the faster less accurate integer DCT
+    @param optimize build optimal huffman tables for smaller frames
+    */
+    void setEncoderTuning(int, bool, bool);
+
+    //! Set the amount of threads encoding profiles and strips in parallel
+    /*!
+    One pool is shared by every source and the strips of their frames
+    ( @see setStrips() ) so more sources don't mean more threads. Must be
+    called before the first frame is encoded
+
+    @param threads number of encode threads or -1 to use one per cpu core
+    */
+    void setEncodeThreads(int);
+
+    //! Encode every frame of the default stream in parallel strips
+    /*!
+    Large frames take long enough to encode on one core to cap the frame
+    rate. Split into strips each frame is encoded by several cores at once
+    and stitched back into one standard jpeg using restart markers. Any
+    stream can ask for it with { @code /mjpg?strips=4 }. Optimize is
+    ignored for striped streams since every strip has to share the same
+    huffman tables
+
+    @param strips strips per frame, around the core count, or -1 to encode in one piece
+    */
+    void setStrips(int);
+
+    //! Set how many extra profiles may be encoded at once
+    /*!
+    Every profile costs a resize and an encode per frame so clients asking
+    for new ones are turned away once this many are running
+
+    @param profiles the limit or -1 for unlimited
+    */
+    void setMaxProfiles(int);
+
+    //! Set the kernel send buffer size of streaming clients
+    /*!
+    A smaller send buffer keeps fewer stale frames queued inside the kernel
+    for a slow viewer. Leave it at -1 to keep the kernel's autotuning which
+    is what you want for fast links carrying big frames
+
+    @param bytes the SO_SNDBUF size in bytes or -1 for the kernel default
+    */
+    void setSendBuffer(int);
+
+    //! Set how much unsent data a streaming client may have queued
+    /*!
+    A client only counts as ready for its next frame once less than this
+    many bytes are still waiting in its socket (TCP_NOTSENT_LOWAT). Until
+    then newer frames replace each other and the client gets only the
+    newest one, so a slow link never falls behind the camera
+
+    @param bytes the low water mark in bytes or -1 to leave it unset
+    */
+    void setSendLowat(int);
+
+    //! Set how long a single frame write may take
+    /*!
+    A client that can't take one frame within this time is disconnected
+
+    @param milliseconds the write deadline or -1 to wait forever
+    */
+    void setSendTimeout(int);
+
+    //! Send big frames to streaming clients without copying them into the kernel
+    /*!
+    Frames of at least this many bytes are sent with MSG_ZEROCOPY (Linux
+    4.14 and newer), the kernel reads the shared frame directly and the
+    frame only goes back to its pool once the kernel reports it's done with
+    it. Pinning pages and reading the completions costs more than copying
+    a small frame, those keep the normal copying write, around 32KB is
+    where it starts to pay. Loopback and some drivers copy anyway, the
+    mjpg_send_path_bytes_total metric shows which path the bytes took
+
+    @param bytes the smallest frame to send without copying or -1 to never (default)
+    */
+    void setZeroCopy(int);
+
+    //! Send frames and accept clients through io_uring instead of asio
+    /*!
+    Every event loop gets an io_uring next to its asio reactor. Frame sends
+    of all the clients a publish wakes on a loop are submitted together
+    with one syscall, jpegs go out of buffers registered once with zerocopy sends and the
+    listener takes every connection through one multishot accept. Requests,
+    timers and everything else stay on asio. Needs a build with
+    MJPGSERVER_URING and Linux 5.19 or newer, otherwise the server says so
+    and keeps using asio. Must be set before run()
+
+    @param enable true for io_uring, false for plain asio (default)
+    */
+    void setIoUring(bool);
+
+    //! Set the largest request a client may send
+    /*!
+    Every connection gets a buffer of this size once, the request line,
+    headers and body have to fit it. Headers that don't are answered with
+    431, a Content-Length that doesn't with 413 and the connection is closed
+
+    @param bytes the request size limit in bytes
+    */
+    void setMaxRequestSize(int);
+
+    //! Set how long a client may take to send a request
+    /*!
+    Also how long an idle keep-alive connection is kept open waiting for
+    its next request
+
+    @param milliseconds the read deadline or -1 to wait forever
+    */
+    void setReadTimeout(int);
+
+    //! Get the delivery counters of every streaming client
+    /*!
+    Dropped counts the frames a client skipped because it was still busy
+    writing an older frame when they were published. Also served as text
+    on the /clients REST path
+
+    @return one entry per connected stream client
+    */
+    std::vector<ClientStats> getClientStats(void);
+
+    //! Set how many frames may wait in front of each pipeline stage
+    /*!
+    Capture, resize, encode and publish run on their own threads so a
+    frame is pulled while the previous one is still being encoded. When a
+    stage falls behind the oldest waiting frame is dropped, so a deeper
+    queue smooths out hiccups at the cost of latency. Sources that are
+    already running keep the depth they started with
+
+    @param depth frames per stage queue (at least 1)
+    */
+    void setPipelineDepth(int);
+
+    //! Skip encoding frames that didn't change
+    /*!
+    Every pulled frame is compared to the last one that was encoded on a
+    sample of its rows, tile by tile. When no tile differs by more than
+    the threshold the resize and encode are skipped and each profile's
+    previous jpeg goes out again. How many frames were skipped is counted
+    per source in mjpg_change_frames_total and on the /sources REST path
+
+    @param threshold mean absolute pixel difference (0 - 255) a tile may have and still count as unchanged, 0 for identical frames only or -1 to encode every frame (default)
+    */
+    void setChangeDetection(int);
+
+    //! Throttle the stream while nothing changes
+    /*!
+    With change detection on, unchanged frames are only published at this
+    rate so a static scene costs clients next to no bandwidth while they
+    still see the stream is alive. Motion is picked up right away since
+    every pulled frame is still compared
+
+    @param fps unchanged frames per second to publish or -1 to publish every one (default)
+    */
+    void setKeepAliveFPS(int);
+
+    //! Set how long a source keeps capturing after its last viewer left
+    /*!
+    Once nobody streamed a source for this long its capture, resize and
+    encode stop until the next stream viewer connects, so an unwatched
+    camera costs next to no cpu. The last frame stays published which
+    lets a returning viewer start with it right away while the capture
+    wakes up. Snapshots of a suspended source pull a frame on their own
+
+    @param milliseconds the idle time before suspending or -1 to never suspend
+    */
+    void setIdleLinger(int);
+
+    //! Set how long a /jpg?after=<seq> long-poll waits for a newer frame
+    /*!
+    Snapshots carry their capture sequence in X-Seq and an ETag, a client
+    passing the sequence it has back with ?after= is answered as soon as
+    a newer frame is published. A waiting client counts as a viewer so
+    a suspended source captures again. Once the time is up it gets the
+    newest frame there is (or a 304 if that's the one its If-None-Match names)
 
-    //!Internal attach method for getting OpenCv Mat
-    cv::Mat (*pullframe)(void);
+    @param milliseconds the longest a long-poll waits
+    */
+    void setLongPollTimeout(int);
+
+    //! Set how many frames a WebSocket client may have unacknowledged
+    /*!
+    Next to /mjpg every source serves /ws (same profile and fps query) where
+    each frame is one binary message holding the jpeg. The client answers
+    every frame with a message of its own (any text or binary) and while
+    this many are still unanswered nothing more is sent, once an ack comes
+    in the newest frame goes out and everything published meanwhile is
+    skipped. So a slow link can't fill up with stale frames and the
+    latency stays around a frame time. A client may ask for less with ?window=
+
+    Example: { @code ws = new WebSocket("ws://host:8080/ws"); ws.binaryType = "blob";
+    ws.onmessage = function(e) { img.src = URL.createObjectURL(e.data); ws.send("ack"); };
+    }
+
+    @param frames frames in flight per client (default 2)
+    */
+    void setWebSocketWindow(int);
+
+    //! Get the queue depth and timing of every pipeline stage
+    /*!
+    Also served as text on the /pipeline REST path
+
+    @return one entry per stage in pipeline order
+    */
+    std::vector<MjpgStageStats> getPipelineStats(void);
+
+    //! Back large frame buffers with huge pages
+    /*!
+    Pulled frames and resize targets are recycled through pools so a
+    running stream doesn't allocate per frame. With huge pages on, those
+    of 2MB and up (720p and larger) are mapped with huge pages which
+    saves page faults and TLB misses when every pixel is touched each
+    frame. Falls back to transparent huge pages when none are reserved
+
+    @param enable true to use huge pages for new buffers
+    */
+    void setHugePages(bool);
+
+    //! Get the hit and miss counters of the buffer pools
+    /*!
+    A miss is a buffer that had to be allocated, once a stream has run
+    for a few frames only hits should be climbing. Also served as text on
+    the /pools REST path
+
+    @return one entry per pool
+    */
+    std::vector<MjpgPoolStats> getPoolStats(void);
+
+    //! Get every metric in the Prometheus text format
+    /*!
+    Stage timings, frame sizes, send latency, frame, byte and drop counters,
+    connections and request errors. Updates are per thread sharded so they
+    stay on in production. Also served on the /metrics REST path
+
+    @return the exposition text
+    */
+    std::string getMetrics(void);
+
+    //! Get a pooled mat to pull a frame into
+    /*!
+    Methods given to attach() can return mats created by this (or pull
+    into them) so their pixel buffers are recycled with everything else
+
+    @param rows frame height in pixels
+    @param cols frame width in pixels
+    @param type OpenCV mat type like CV_8UC3
+    @return a mat backed by the frame pool
+    */
+    cv::Mat acquireFrame(int, int, int);
+
+    //! Add a named camera pulled from a function
+    /*!
+    Every source gets its own capture, resize, encode and publish threads,
+    its own profiles and settings and is served under
+    { @code /cam/<name>/mjpg, /cam/<name>/jpg, /cam/<name>/html } and the
+    fps, quality and resolution controls below the same prefix. A source
+    that hangs or keeps failing only stalls its own viewers. The settings
+    of the server itself (attach(), setFPS(), ...) belong to the source
+    named default. Like the default source it starts pulling once its first
+    stream viewer connects and suspends when they're gone ( @see setIdleLinger() )
+
+    @param name the name in the url
+    @param pullframe returns the next frame in BGR or an empty mat on failure
+    */
+    void addSource(std::string, std::function<cv::Mat(void)>);
+
+    //! Add a named camera read through OpenCV
+    /*!
+    The capture is reopened whenever it keeps failing. ( @see addSource() )
+
+    @param name the name in the url
+    @param capture a device number like "0" or a stream url or file
+    */
+    void addCaptureSource(std::string, std::string);
+
+    //! Add a named camera relayed without decoding ( @see setRelayAttach() )
+    /*!
+    @param name the name in the url
+    @param location an http:// url of an mjpeg stream, a directory of jpegs or a file of jpegs
+    */
+    void addRelaySource(std::string, std::string);
+
+    //! Add a named camera fed through shared memory ( @see setShmAttach() )
+    /*!
+    @param name the name in the url
+    @param ring the name the producer created its ring with
+    */
+    void addShmSource(std::string, std::string);
+
+    //! Add a named camera the application publishes frames to
+    /*!
+    @param name the name in the url
+    @see publish()
+    */
+    void addPushSource(std::string);
+
+    //! Hand a named source a frame from the application's own thread ( @see publish() )
+    /*!
+    @param name the source
+    @param frame the frame in BGR, left empty
+    @return true if it's being encoded, false if it was only kept or there's no such source
+    */
+    bool publish(std::string, cv::Mat &&);
+
+    //! Hand a named source an encoded jpeg from the application's own thread ( @see publishEncoded() )
+    /*!
+    @param name the source
+    @param jpeg a complete jpeg image, left empty
+    @return true if it's being published, false if it was only kept or there's no such source
+    */
+    bool publishEncoded(std::string, std::vector<unsigned char> &&);
+
+    //! Get the names of every source
+    /*!
+    @return default followed by the added sources
+    */
+    std::vector<std::string> getSources(void);
+
+    //! Set the fps of a source ( @see setFPS() )
+    /*!
+    @param name the source
+    @param fps an integer between 1 > ... or -1 for unregulated
+    */
+    void setSourceFPS(std::string, int);
+
+    //! Set the jpeg quality of a source ( @see setQuality() )
+    /*!
+    @param name the source
+    @param quality an integer between 0 - 100 or -1 unregulated
+    */
+    void setSourceQuality(std::string, int);
 
-    //!Internal detach method for releasing cameras
-    void (*unint)(void);
+    //! Set the parallel strips of a source ( @see setStrips() )
+    /*!
+    @param name the source
+    @param strips strips per frame or -1 to encode in one piece
+    */
+    void setSourceStrips(std::string, int);
 
-    //!A string map of the headers by key and value
-    std::map<std::string, std::string> parseheaders(const std::string);
+    //! Set the output size of a source ( @see setResolution() )
+    /*!
+    @param name the source
+    @param width integer of the width in pixels or -1
+    @param height integer of the height in pixels or -1
+    */
+    void setSourceResolution(std::string, int, int);
 
-    //!Pulls the entire request till socket close
-    std::string readrequest(asio::ip::tcp::socket &);
+    //! Pin the pipeline threads of a source to cores
+    /*!
+    Keeps a busy camera from competing with the others for caches and
+    cores. Applies when the source's pipeline starts so set it before its
+    first viewer connects
 
-    //!Sends the http response with closure eof
-    bool sendresponse(asio::ip::tcp::socket &, const std::string&);
+    @param name the source
+    @param cpus the cores its threads may run on, empty for any
+    */
+    void pinSource(std::string, std::vector<int>);
 
-    //!Sends a default error with an html based message
-    void sendError(asio::ip::tcp::socket &, std::string &);
+private:
+    //!Unit tests look at the sources' renditions
+    friend class MjpgServerTest;
+    class session;
+    typedef std::shared_ptr<session> session_ptr;
+    class source;
+    typedef std::shared_ptr<source> source_ptr;
+
+    //!Every camera by name, the default one is also kept in primary
+    std::map<std::string, source_ptr> sources;
+    boost::mutex sources_mutex;
+    //!Names of sources still being opened, taken as much as those in sources
+    std::set<std::string> opening;
+    source_ptr primary;
+
+    //!Every streaming client keyed by its session for the stats
+    std::map<session*, std::weak_ptr<session> > streams;
+    boost::mutex streams_mutex;
+
+    //!Sends a default error with an html based message and a status line other than 500 if given
+    void sendError(session_ptr, std::string &, const char *status = "500");
 
     //!When the extension is /html run the default html handler (Doesn't break connection)
-    void handleHtml(asio::ip::tcp::socket &, std::string&);
+    void handleHtml(session_ptr, std::string&);
+
+    //!When the extension is /mjpg run the mjpg server stream of a source's profile at a client rate cap (Closes on end of request)
+    void handleMjpg(session_ptr, source_ptr, MjpgProfilePtr, int);
 
-    //!When the extension is /mjpg run the mjpg server stream (Closes on end of request)
-    void handleMjpg(asio::ip::tcp::socket &);
+    //!When the extension is /ws upgrade to a WebSocket and send a source's profile a binary message per acknowledged frame
+    void handleWs(session_ptr, source_ptr, MjpgProfilePtr, int, int, const MjpgHttpRequest &);
 
-    //!When the extension is /jpg run the single image response (Closes on end of request)
-    void handleJpg(asio::ip::tcp::socket &);
+    //!When the extension is /jpg answer with a source's profile's newest frame, a newer one than after (-1 for any) or a 304 (Doesn't break connection)
+    void handleJpg(session_ptr, source_ptr, MjpgProfilePtr, long long, const std::string &);
+
+    //!Sends a snapshot with its ETag or a 304 if the If-None-Match names it
+    void sendJpg(session_ptr, MjpgFramePtr, const std::string &);
 
     //!Sends a simple REST text/plain response to the client
-    void sendSimple(asio::ip::tcp::socket &, std::string&);
+    void sendSimple(session_ptr, std::string&);
+
+    //!Resizes and encodes a pulled Mat once into a sealed shareable frame
+    std::shared_ptr<MjpgFrame> convertString(const cv::Mat &, const MjpgRendition &);
+
+    //!Resizes a pulled Mat to a rendition without touching the source
+    cv::Mat resizeFrame(const cv::Mat &, const MjpgRendition &);
 
-    //!Turns the global OpenCv Mat into a byte encoded string
-    std::string convertString(void);
+    //!Encodes an already sized Mat into a sealed shareable frame stamped with its capture order and time
+    std::shared_ptr<MjpgFrame> encodeFrame(const cv::Mat &, const MjpgRendition &, unsigned long captureseq = 0,
+                                           std::chrono::steady_clock::time_point captured = std::chrono::steady_clock::time_point());
 
-    //!Splits the response by spaces to retrieve header data
-    std::vector<std::string> typeReq(std::string);
+    //!Moves already encoded jpeg bytes into a new shareable frame stamped with its capture order and time, the vector is left with a recycled buffer
+    std::shared_ptr<MjpgFrame> wrapFrame(std::vector<unsigned char> &&, unsigned long, std::chrono::steady_clock::time_point);
 
-    //!Removes the requests headers and newline characters to just retrieve the body
-    std::string getBody(std::string &);
+    //!Stamps a new capture onto a previous frame's jpeg without copying it, the ETag stays that of the bytes
+    std::shared_ptr<MjpgFrame> reuseFrame(MjpgFramePtr, unsigned long, std::chrono::steady_clock::time_point);
 
-    //!Internal method to attach cap to the pull method
-    void capattach_in(void);
+    //!Swaps in encoders built from the current tuning
+    void createEncoders(void);
 
-    //!On session successful completion of socket run the mjpgserver main code
-    void onAccept(asio::ip::tcp::socket &);
+    //!Reads profile or w, h and q from a query string
+    bool parseRendition(const std::string &, MjpgRendition &);
+
+    //! Get the profile a stream or snapshot query asks for
+    /*!
+    @param client answered with 404 for an unknown profile, 400 for bad w, h or q and 500 when there are too many profiles
+    @param cam the source the profile belongs to
+    @param query the request's query string
+    @return the source's default profile without any rendition parameters, null after an error was sent
+    */
+    MjpgProfilePtr resolveProfile(session_ptr, source_ptr, const std::string &);
 
-    //!Main loop to pull the user defined methods in seperate buffer free thread
-    void mainPullLoop(void);
+    //!A string map of the query parameters by key and value
+    std::map<std::string, std::string> parsequery(const std::string &);
+
+    //!Escapes request text echoed into an html page
+    static std::string escapehtml(const std::string &);
+
+    //!The source of a name or null
+    source_ptr findSource(const std::string &);
+
+    //!Adds a source of a new name, open sets it up before anyone can find it
+    void createSource(const std::string &, std::function<void(source &)>);
+
+    //!Builds the text/plain /sources table
+    std::string sourceTable(void);
+
+    //!On a complete request from a session run the mjpgserver main code
+    void onAccept(session_ptr, const MjpgHttpRequest &);
+
+    //!Picks the event loop the next accepted client will live on
+    asio::io_service& nextLoop(void);
+
+    //!The timer wheel pacing the clients of an event loop
+    MjpgTimerWheel& wheelOf(asio::io_service &);
+
+    //!The io_uring of an event loop or null when sending through asio
+    MjpgUring* ringOf(asio::io_service &);
+
+    //!Builds the text/plain /clients stats table
+    std::string clientTable(void);
+
+    //!Builds the text/plain /pipeline stats table
+    std::string pipelineTable(void);
+
+    //!Builds the text/plain /pools stats table
+    std::string poolTable(void);
+
+    //!Registers the metrics read from elsewhere when scraped
+    void registerMetrics(void);
+
+    //!One camera with its own capture, settings, profiles and pipeline
+    /*!
+    Pulls, resizes, encodes and publishes on threads of its own so a camera
+    that hangs or fails only stalls its own viewers. A pull that throws or
+    comes back empty is skipped, after maxfailpackets of them in a row the
+    source counts as failing and backs off (reopening its capture if it
+    has one) until a frame comes through again. When no stream viewer was
+    left for the linger the pull thread and, once their queues drained, the
+    other stage threads park until the next viewer joins. Encoders, buffer pools,
+    metrics and the event loops are shared by every source
+    */
+    class source
+    {
+    public:
+        source(MjpgServer *, const std::string &);
+
+        //!Register the source's counters and scraped samples, only once it opened since the registry keeps them for good
+        void registerMetrics(void);
+        //!Start the pipeline threads unless they already run
+        void start(void);
+        //!A stream viewer arrived, starts or wakes up the pipeline
+        void join(void);
+        //!A stream viewer left, the pipeline suspends once none came back for the linger
+        void leave(void);
+        //!Swap the queues between the stages for ones of a new depth, false once the stages run
+        bool setDepth(int);
+        //!Pull from an OpenCV capture of a device number or url
+        void openCapture(const std::string &);
+        //!Pull jpegs from an mjpeg url or files without decoding them
+        void openRelay(const std::string &);
+        //!Pull frames a producer process writes into a shared memory ring
+        void openShm(const std::string &);
+        //!Queue a published frame or jpeg for resizing, false if it was only held because nobody watched
+        bool push(cv::Mat &&, std::vector<unsigned char> &&);
+        //!Copies out what was held while nobody watched, false if nothing was
+        bool held(cv::Mat &, std::vector<unsigned char> &);
+        //!Nothing is attached so frames are published to it instead of pulled
+        bool pushed(void);
+        //!Captures and encodes a frame off the event loop then runs callback on loop with it (null on failure), concurrent snapshots share one capture
+        void snapshot(boost::asio::io_service &, std::function<void(MjpgFramePtr)>);
+        //!Whether a relayed jpeg already is what a rendition asks for
+        bool relays(const std::vector<unsigned char> &, const MjpgRendition &);
+        //!The rendition set through the source's resolution and quality
+        MjpgRendition rendition(void);
+        //!Finds or lazily creates the profile for a rendition, the default one for what the source already encodes, null past the profile limit
+        MjpgProfilePtr acquireProfile(const MjpgRendition &);
+        //!Fills in every profile that still has viewers (plus the default one)
+        void activeProfiles(std::vector<MjpgProfilePtr> &);
+        //!Queue depth and timing of the stages, prefixed with the name unless default
+        std::vector<MjpgStageStats> stats(void);
+        //!Published frames per second
+        float getFPS(void);
+        //!Percent of the compared frames that weren't encoded again
+        int skipRatio(void);
+
+        const std::string name;
+        //!Internal attach method for getting OpenCv Mat
+        std::function<cv::Mat(void)> pullframe;
+        //!Set instead of pullframe by relays and shared memory rings, fills in a mat or an encoded jpeg
+        std::function<bool(cv::Mat&, std::vector<unsigned char>&)> pullinto;
+        //!Internal detach method for releasing cameras
+        std::function<void(void)> unint;
+        int controlfps = -1;
+        int settlefps = -1;
+        int quality = -1;
+        int resized[2] = {-1, -1};
+        int strips = -1;
+        //!Cores the pipeline threads are pinned to, empty for any
+        std::vector<int> cpus;
+        //!Last pulled frame
+        cv::Mat curframe;
+        MjpgProfilePtr defaultprofile;
+        std::atomic<bool> running{false};
+        std::atomic<bool> failing{false};
+        //!The pull thread is parked (or published frames aren't encoded) because nobody watched
+        std::atomic<bool> suspended{false};
+        //!Frames the source's stream clients skipped because they were still busy ( @see registerMetrics() )
+        MjpgCounter *clientdrops = nullptr;
+
+    private:
+        //!Main loop to pull the user defined methods in seperate buffer free thread
+        void mainPullLoop(void);
+        //!Resize stage thread sizing every pulled frame for each live profile
+        void resizeLoop(void);
+        //!Encode stage thread encoding each sized frame
+        void encodeLoop(void);
+        //!Encodes, reuses or wraps one profile's frame of a job and counts the job's latch down
+        void encodeProfile(MjpgPipelineJob *, size_t);
+        //!Runs encodeProfile of the source passed as owner on an encode thread
+        static void encodeTask(void *, void *, size_t);
+        //!Publish stage thread handing encoded frames to the profile channels
+        void publishLoop(void);
+        //!Restrict the calling thread to the pinned cores
+        void pin(void);
+        //!Parks the pull thread while nobody watched for the linger, true when it woke up again
+        bool idle(void);
+        //!Snapshot thread capturing once for everyone waiting on it
+        void snapshotLoop(void);
+        //!Pulls and encodes a single frame outside the pipeline
+        MjpgFramePtr snap(void);
+        //!Suspends or resumes by whether anybody watched without parking, true while suspended
+        bool dormant(void);
+        //!Nobody streamed for the linger (demand_mutex held)
+        bool unwatched(void);
+        //!Marks the source suspended (demand_mutex held)
+        void suspend(void);
+        //!Marks the source running again and wakes the parked stages (demand_mutex held)
+        void resume(void);
+        //!Parks a stage thread on demand while the source is suspended and nothing is queued for it, true if it parked
+        bool park(const MjpgRing<MjpgPipelineJob> &);
+        //!Queues a job for the next stage, waking it if it parked
+        void handoff(MjpgRing<MjpgPipelineJob> &, MjpgPipelineJob *);
+
+        MjpgServer *master;
+        //!Registered once the source opened ( @see registerMetrics() )
+        MjpgCounter *suspends = nullptr;
+        MjpgCounter *resumes = nullptr;
+        MjpgCounter *changedframes = nullptr;
+        MjpgCounter *reusedframes = nullptr;
+        MjpgCounter *throttledframes = nullptr;
+        //!Only used by the resize stage
+        MjpgChangeDetector detector;
+        //!Capture time of the last frame let through while throttling
+        std::chrono::steady_clock::time_point kept;
+        //!Stream viewers and since when there were none
+        int viewers = 0;
+        std::chrono::steady_clock::time_point idlesince;
+        boost::mutex demand_mutex;
+        boost::condition_variable demand;
+        //!When the pull thread woke up (ns since the clock's epoch), 0 once its first frame was published
+        std::atomic<long long> woken{0};
+        //!Sequence of the frames handed to the resize stage, pulled or published
+        std::atomic<unsigned long> captures{0};
+        //!Whether publishing to a pulling source was already reported
+        std::atomic<bool> pushrefused{false};
+        //!Serializes publishers since the resize queue takes one producer, guards what's held
+        boost::mutex publish_mutex;
+        //!The newest frame or jpeg published while suspended
+        cv::Mat heldframe;
+        std::vector<unsigned char> heldjpeg;
+        //!Keeps a snapshot from pulling while the pull thread does
+        boost::mutex pull_mutex;
+        //!Snapshot requests waiting on the capture in flight, one is running while not empty
+        std::vector<std::pair<boost::asio::io_service*, std::function<void(MjpgFramePtr)> > > snapshots;
+        boost::mutex snapshots_mutex;
+        cv::VideoCapture cap;
+        //!What the capture was opened with, reopened when it keeps failing
+        std::string capture;
+        std::unique_ptr<MjpgRelay> relay;
+        //!Views handed out lease shared memory slots so it has to outlive the pipeline
+        std::unique_ptr<MjpgShmConsumer> ring;
+        float fps = 0.0f;
+        boost::mutex fps_mutex;
+        std::map<MjpgRendition, std::weak_ptr<MjpgProfile> > profiles;
+        boost::mutex profiles_mutex;
+        std::unique_ptr<MjpgRing<MjpgPipelineJob> > resizeq;
+        std::unique_ptr<MjpgRing<MjpgPipelineJob> > encodeq;
+        std::unique_ptr<MjpgRing<MjpgPipelineJob> > publishq;
+        MjpgStage capturestage{"capture"};
+        MjpgStage resizestage{"resize"};
+        MjpgStage encodestage{"encode"};
+        MjpgStage publishstage{"publish"};
+    };
 
     //!Async session provider
     /*!
-    On pooled thread accepted socket create a new session thread with client socket
-    When completed cleanup the async socket (Used in a more synchronous method)
+    Every accepted socket gets one session that lives on a single event loop.
+    Nothing in here ever blocks, requests are read and responses and frames
+    are written asynchronously and the session frees itself once its last
+    pending operation completes
     */
-    class session
+    class session : public std::enable_shared_from_this<session>
     {
     public:
-        //!Init session with io service
-        session(boost::asio::io_service& io_service)
-            : socket_(io_service) {}
-        //!Start new mjpg thread
+        //!Init session with the io service of the loop that owns it and the request size limit
+        session(boost::asio::io_service& io_service, size_t requestsize)
+            : loop_(io_service), socket_(io_service), deadline_(io_service), parser_(requestsize) {}
+        //!Drops the stream connection count and viewer hold when a streaming or long-polling client goes away
+        ~session();
+        //!Start reading requests from the client
         void start(MjpgServer *);
         //!The core of mjpgserver the connection
         tcp::socket &socket();
+        //!The event loop this session runs on
+        boost::asio::io_service &loop() { return loop_; }
+        //!Write a full response then read the next request if both sides allow keep-alive or close
+        void respond(const std::string&, bool);
+        //!Write a response with a shared jpeg body then read the next request or close
+        void respond(const std::string&, MjpgFramePtr, bool);
+        //!Write the stream header and start pacing frames of a source's profile to the client at a rate cap (-1 for none)
+        void stream(const std::string&, source_ptr, MjpgProfilePtr, int);
+        //!Wait as a viewer of a source until its profile publishes a frame newer than a capture sequence, then send it as a snapshot
+        void poll(source_ptr, MjpgProfilePtr, unsigned long, const std::string&);
+        //!Write the upgrade response and send frames of a source's profile as WebSocket messages, at most window of them unacknowledged
+        void websocket(const std::string&, source_ptr, MjpgProfilePtr, int, int);
+        //!Cancel anything pending and close the socket
+        void close();
+        //!Current delivery counters (safe from any thread)
+        ClientStats stats();
     private:
+        void readRequest();
+        void onRead(const boost::system::error_code&, size_t);
+        void onRequest(MjpgHttpParser::result);
+        void onIdle(const boost::system::error_code&);
+        //!Takes the deadline down so a handler already on its way knows it's stale
+        void disarm(void);
+        //!Whether the deadline a handler ran for is still the one set
+        bool expired(void);
+        void onResponse(const boost::system::error_code&, bool);
+        void nextFrame(void);
+        //!Counts the frames before seq that were replaced while the client was busy as dropped
+        void countDrops(unsigned long);
+        void onPublish(MjpgFramePtr);
+        void onFrame(const boost::system::error_code&);
+        void watch(void);
+        void onWatch(const boost::system::error_code&);
+        //!Notes a frame write starting, a watch is only armed if none is running
+        void watchWrite(void);
+        //!Arms the deadline for the send timeout after the current write started
+        void watchSend(void);
+        void onDeadline(const boost::system::error_code&);
+        void onPollFrame(MjpgFramePtr);
+        void onPollTimeout(const boost::system::error_code&);
+        void endPoll(void);
+        void wsRead(void);
+        void onWsRead(const boost::system::error_code&, size_t);
+        void wsSend(void);
+        void wsNext(void);
+        void onWsPublish(MjpgFramePtr);
+        void onWsWritten(const boost::system::error_code&);
+        void tune(void);
+        int rate(void);
+        void sendZeroCopy(void);
+        std::shared_ptr<MjpgZeroCopyFrame> zeroCopyPart(void);
+        void onWritable(const boost::system::error_code&);
+        void reapZeroCopy(void);
+        void onCompletion(const boost::system::error_code&);
+        void onRingSent(size_t, int);
+        boost::asio::io_service &loop_;
         tcp::socket socket_;
-        MjpgServer *master;
+        boost::asio::steady_timer deadline_;
+        //!Owns the connection's request buffer, requests are parsed in place
+        MjpgHttpParser parser_;
+        //!Whether the client allows another request after the current one
+        bool keepalive_ = false;
+        //!Keeps response bytes and the shared frame alive during a write
+        std::string outgoing_;
+        MjpgFramePtr inflight_;
+        //!When the frame in flight started going out, empty between frames
+        std::chrono::steady_clock::time_point writing_;
+        //!The deadline watches writes, it is re-armed once per send timeout instead of per frame
+        bool watching_ = false;
+        //!The in flight part's X-Send-Ts line
+        char stamp_[48];
+        size_t stamplength_ = 0;
+        //!MSG_ZEROCOPY sends of the socket, null unless enabled and supported
+        std::unique_ptr<MjpgZeroCopy> zerocopy_;
+        //!The part going out without copying and how much of it the socket took
+        std::shared_ptr<MjpgZeroCopyFrame> zcpart_;
+        size_t zcsent_ = 0;
+        //!Every part holder the session made, one only the list still owns is free to take the next part
+        std::vector<std::shared_ptr<MjpgZeroCopyFrame>> zcparts_;
+        //!Whether the in flight part took the zerocopy path
+        bool zerocopying_ = false;
+        //!Whether a wait for send completions is armed
+        bool zcwaiting_ = false;
+        //!The loop's io_uring frames are sent through, null for asio
+        MjpgUring *ring_ = nullptr;
+        //!The rendition a streaming client watches, held to keep it encoding
+        MjpgProfilePtr profile_;
+        //!The camera the profile belongs to
+        source_ptr source_;
+        //!Sequence of the last frame written to a streaming client
+        unsigned long sent_ = 0;
+        //!Newest sequence published when the client was last ready for a frame, later ones are skipped by the rate cap
+        unsigned long ready_ = 0;
+        //!When the stream was requested, for the time to its first frame
+        std::chrono::steady_clock::time_point requested_;
+        //!Rate the client asked for with ?fps=, -1 follows the server's fps
+        int fps_ = -1;
+        //!Shared per loop timers the client is paced on
+        MjpgTimerWheel *wheel_ = nullptr;
+        //!Spacing of the frames handed to the socket
+        MjpgJitter jitter_;
+        std::atomic<unsigned long> framessent_{0};
+        std::atomic<unsigned long> framesdropped_{0};
+        std::string address_;
+        //!Scratch space to notice a streaming client hanging up
+        char discard_[64];
+        bool streaming = false;
+        //!A long-poll is waiting for a frame after this capture sequence, answered with this If-None-Match
+        bool polling_ = false;
+        unsigned long after_ = 0;
+        std::string etag_;
+        //!Reads the client's acks once upgraded to a WebSocket
+        std::unique_ptr<MjpgWebSocket> ws_;
+        //!Frames the client may have unacknowledged and has
+        int window_ = 1;
+        int unacked_ = 0;
+        //!Parked on the channel (or the pacing wheel) and a write in flight
+        bool wswaiting_ = false;
+        bool wswriting_ = false;
+        //!Closing once the queued close frame went out
+        bool wsclosing_ = false;
+        //!Control frames waiting for the current write and the ones being written
+        std::string wscontrol_;
+        std::string wsout_;
+        //!A published frame waiting for the write in flight to finish
+        MjpgFramePtr wsnext_;
+        //!Header of the binary message in flight
+        unsigned char wshead_[10];
+        size_t wsheadlength_ = 0;
+        MjpgServer *master = nullptr;
     };
 
     //!Init thread of mjpgserver
@@ -363,14 +1268,17 @@ private:
         {
             //Set the init method to the
             this->master = server;
-            start_accept();
+            if(!start_multishot()) start_accept();
         }
 
         void cleanup(void);
     private:
         //This is self explanatory
         void start_accept();
-        void handle_accept(session*, const boost::system::error_code&);
+        void handle_accept(session_ptr, const boost::system::error_code&);
+        //!Accept through the first loop's io_uring if the server uses it
+        bool start_multishot();
+        void handle_fd(int);
         boost::asio::io_service& io_service_;
         tcp::acceptor acceptor_;
         //!Class pointer to main mjpgserver code
@@ -0,0 +1,400 @@
+/**
+    CS-11 Format
+    File: mjpgshm.cpp
+    Purpose: POSIX shared memory frame ring written by other processes and read without copying
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "mjpgshm.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static const uint32_t shmmagic = 0x4d4a5047; //MJPG
+static const uint32_t shmversion = 1;
+//!Slot header bytes in front of every payload
+static const uint32_t shmpayload = 64;
+static const size_t shmpage = 4096;
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Ring atomics have to be plain words another process can share");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Ring atomics have to be lock free to work across processes");
+static_assert(sizeof(MjpgShmSlot) <= shmpayload, "A slot header has to fit in front of its payload");
+static_assert(sizeof(MjpgShmHeader) <= shmpage, "The ring header has to fit in front of the first slot");
+
+static uint64_t monotonic()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static MjpgShmSlot *slotAt(MjpgShmHeader *header, uint32_t index)
+{
+    return (MjpgShmSlot*) ((unsigned char*) header + header->slotoffset + (size_t) index * header->slotstride);
+}
+
+struct MjpgShmConsumer::mapping
+{
+    MjpgShmHeader *header;
+    size_t length;
+    ~mapping() { munmap(this->header, this->length); }
+};
+
+//!What a leased mat's UMatData points to
+struct MjpgShmLease
+{
+    std::shared_ptr<MjpgShmConsumer::mapping> keep;
+    MjpgShmSlot *slot;
+};
+
+MjpgShmProducer::MjpgShmProducer(const std::string &name, size_t slotbytes, int slots) : name("/" + name)
+{
+    if(slots < 2) slots = 2;
+    if(slots > 0xFFFF) slots = 0xFFFF;
+    size_t stride = (shmpayload + slotbytes + shmpage - 1) / shmpage * shmpage;
+    this->length = shmpage + stride * slots;
+    shm_unlink(this->name.c_str()); //A new producer always starts from a fresh ring
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if(fd < 0)
+    {
+        std::cerr << "Couldn't create shared memory ring " << name << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    void *base = MAP_FAILED;
+    struct stat info;
+    if(fstat(fd, &info) == 0) this->inode = info.st_ino;
+    if(ftruncate(fd, this->length) == 0)
+        base = mmap(nullptr, this->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        std::cerr << "Couldn't map shared memory ring " << name << ": " << strerror(errno) << std::endl;
+        shm_unlink(this->name.c_str());
+        return;
+    }
+    MjpgShmHeader *created = new (base) MjpgShmHeader();
+    created->version = shmversion;
+    created->slots = slots;
+    created->payload = shmpayload;
+    created->slotbytes = slotbytes;
+    created->slotoffset = shmpage;
+    created->slotstride = stride;
+    created->published.store(0);
+    created->wake.store(0);
+    created->sleepers.store(0);
+    created->heartbeat.store(monotonic());
+    created->producer.store(getpid());
+    for(int i = 0; i < slots; i++)
+    {
+        MjpgShmSlot *slot = new (slotAt(created, i)) MjpgShmSlot();
+        slot->seq.store(0);
+        slot->readers.store(0);
+    }
+    created->magic.store(shmmagic, std::memory_order_release);
+    this->header = created;
+}
+
+MjpgShmProducer::~MjpgShmProducer()
+{
+    if(!this->header) return;
+    this->header->producer.store(0);
+    munmap(this->header, this->length);
+    int fd = shm_open(this->name.c_str(), O_RDONLY, 0);
+    if(fd < 0) return;
+    struct stat info;
+    bool ours = fstat(fd, &info) == 0 && info.st_ino == this->inode;
+    close(fd);
+    if(ours) shm_unlink(this->name.c_str());
+}
+
+size_t MjpgShmProducer::capacity() const
+{
+    return this->header ? this->header->slotbytes : 0;
+}
+
+unsigned char *MjpgShmProducer::claim()
+{
+    if(!this->header) return nullptr;
+    if(this->claimed >= 0) return (unsigned char*) slotAt(this->header, this->claimed) + shmpayload;
+    uint64_t published = this->header->published.load(std::memory_order_relaxed);
+    for(uint32_t tries = 0; tries < this->header->slots; tries++)
+    {
+        uint32_t index = this->cursor++ % this->header->slots;
+        if(published != 0 && index == (published & 0xFFFF)) continue; //The newest frame stays readable
+        MjpgShmSlot *slot = slotAt(this->header, index);
+        uint64_t was = slot->seq.load(std::memory_order_relaxed);
+        //Marking the slot before looking for leases pairs with the server leasing before checking the mark
+        slot->seq.store(this->next * 2 + 1);
+        if(slot->readers.load() != 0)
+        {
+            slot->seq.store(was);
+            continue;
+        }
+        this->claimed = index;
+        return (unsigned char*) slot + shmpayload;
+    }
+    this->drops++;
+    return nullptr;
+}
+
+bool MjpgShmProducer::commit(MjpgShmFormat format, int width, int height, int stride, size_t bytes)
+{
+    if(this->claimed < 0 || bytes > this->header->slotbytes) return false;
+    MjpgShmSlot *slot = slotAt(this->header, this->claimed);
+    slot->format = format;
+    slot->width = width;
+    slot->height = height;
+    slot->stride = stride;
+    slot->bytes = (uint32_t) bytes;
+    slot->captured = monotonic();
+    slot->seq.store(this->next * 2, std::memory_order_release);
+    this->header->published.store((this->next << 16) | (uint64_t) this->claimed, std::memory_order_release);
+    this->next++;
+    this->claimed = -1;
+    this->alive();
+    this->header->wake.fetch_add(1);
+#ifdef __linux__
+    if(this->header->sleepers.load() != 0)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->header->wake), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    return true;
+}
+
+bool MjpgShmProducer::publish(MjpgShmFormat format, int width, int height, int stride, const void *data, size_t bytes)
+{
+    if(bytes > this->capacity()) return false;
+    unsigned char *payload = this->claim();
+    if(!payload) return false;
+    std::memcpy(payload, data, bytes);
+    return this->commit(format, width, height, stride, bytes);
+}
+
+bool MjpgShmProducer::publish(const cv::Mat &frame)
+{
+    if(frame.empty() || frame.depth() != CV_8U || (frame.channels() != 3 && frame.channels() != 1)) return false;
+    size_t row = (size_t) frame.cols * frame.elemSize();
+    if(row * frame.rows > this->capacity()) return false;
+    unsigned char *payload = this->claim();
+    if(!payload) return false;
+    if(frame.isContinuous()) std::memcpy(payload, frame.ptr(), row * frame.rows);
+    else for(int y = 0; y < frame.rows; y++) std::memcpy(payload + row * y, frame.ptr(y), row);
+    return this->commit(frame.channels() == 3 ? MJPGSHM_BGR : MJPGSHM_GRAY, frame.cols, frame.rows, 0, row * frame.rows);
+}
+
+bool MjpgShmProducer::publish(const std::vector<unsigned char> &jpeg)
+{
+    return this->publish(MJPGSHM_JPEG, 0, 0, 0, jpeg.data(), jpeg.size());
+}
+
+void MjpgShmProducer::alive()
+{
+    if(this->header) this->header->heartbeat.store(monotonic(), std::memory_order_relaxed);
+}
+
+MjpgShmConsumer::MjpgShmConsumer(const std::string &name, int stall) : name("/" + name), stall(stall) {}
+
+bool MjpgShmConsumer::open()
+{
+    int fd = shm_open(this->name.c_str(), O_RDWR, 0);
+    if(fd < 0)
+    {
+        if(!this->reported) std::cerr << "No shared memory ring " << this->name << " yet" << std::endl;
+        this->reported = true;
+        return false;
+    }
+    struct stat info;
+    void *base = MAP_FAILED;
+    if(fstat(fd, &info) == 0 && (size_t) info.st_size >= shmpage)
+        base = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) return false;
+    std::shared_ptr<mapping> opened = std::make_shared<mapping>();
+    opened->header = (MjpgShmHeader*) base;
+    opened->length = info.st_size;
+    MjpgShmHeader *header = opened->header;
+    if(header->magic.load(std::memory_order_acquire) != shmmagic || header->version != shmversion ||
+       header->payload != shmpayload || header->slotoffset + (uint64_t) header->slots * header->slotstride > opened->length)
+        return false; //Not set up yet or not a ring, tried again on the next pull
+    if(header->producer.load() == 0 || monotonic() - header->heartbeat.load() > (uint64_t) this->stall * 1000000ULL)
+        return false; //Left behind by a producer that exited or crashed, its frames are stale
+    //Every producer creates a new object, so the one mapped last is a producer that stalled and came back and
+    //our own mats may still lease its slots. Only a ring this consumer never saw can hold an earlier server's leases
+    if((unsigned long) info.st_ino != this->inode)
+        for(uint32_t i = 0; i < header->slots; i++) slotAt(header, i)->readers.store(0);
+    this->inode = info.st_ino;
+    this->mapped = opened;
+    this->last = 0;
+    return true;
+}
+
+MjpgShmSlot *MjpgShmConsumer::take()
+{
+    MjpgShmHeader *header = this->mapped->header;
+    while(1)
+    {
+        uint64_t packed = header->published.load(std::memory_order_acquire);
+        uint64_t seq = packed >> 16;
+        uint32_t index = packed & 0xFFFF;
+        if(seq == 0 || seq == this->last || index >= header->slots) return nullptr;
+        MjpgShmSlot *slot = slotAt(header, index);
+        slot->readers.fetch_add(1);
+        if(slot->seq.load() == seq * 2)
+        {
+            this->last = seq;
+            return slot;
+        }
+        slot->readers.fetch_sub(1); //Taken over for a newer frame in between, that one is published next
+    }
+}
+
+bool MjpgShmConsumer::next(cv::Mat &frame, std::vector<unsigned char> &jpeg, cv::MatAllocator *converted)
+{
+    frame.release();
+    jpeg.clear();
+    //Without a producer the whole stall interval passes before giving up so the pull loop doesn't spin
+    uint64_t giveup = monotonic() + (uint64_t) this->stall * 1000000ULL;
+    while(1)
+    {
+        if(!this->mapped && !this->open())
+        {
+            if(monotonic() >= giveup) return false;
+            usleep(100000); //Polls for a producer to create the ring
+            continue;
+        }
+        MjpgShmHeader *header = this->mapped->header;
+        uint32_t seen = header->wake.load();
+        MjpgShmSlot *slot = this->take();
+        if(slot)
+        {
+            if(this->reported) std::cout << "Shared memory ring " << this->name << " has a producer again" << std::endl;
+            this->reported = false;
+            return this->view(slot, frame, jpeg, converted);
+        }
+        if(header->producer.load() == 0)
+        {
+            if(!this->reported) std::cerr << "The producer of shared memory ring " << this->name << " is gone" << std::endl;
+            this->reported = true;
+            this->mapped.reset(); //Leased mats keep the old mapping until they're done
+            continue;
+        }
+        if(monotonic() - header->heartbeat.load() > (uint64_t) this->stall * 1000000ULL)
+        {
+            if(!this->reported) std::cerr << "The producer of shared memory ring " << this->name << " stalled" << std::endl;
+            this->reported = true;
+            this->mapped.reset(); //Reopened once a producer is back, a restarted one recreates the ring
+            continue;
+        }
+        this->wait(seen, 100);
+    }
+}
+
+bool MjpgShmConsumer::view(MjpgShmSlot *slot, cv::Mat &frame, std::vector<unsigned char> &jpeg, cv::MatAllocator *converted)
+{
+    unsigned char *payload = (unsigned char*) slot + shmpayload;
+    int width = slot->width;
+    int height = slot->height;
+    size_t bytes = slot->bytes;
+    int type = -1;
+    int rows = height;
+    int conversion = -1;
+    switch(slot->format)
+    {
+    case MJPGSHM_BGR: type = CV_8UC3; break;
+    case MJPGSHM_GRAY: type = CV_8UC1; break;
+    case MJPGSHM_YUYV: type = CV_8UC2; conversion = cv::COLOR_YUV2BGR_YUYV; break;
+    case MJPGSHM_NV12: type = CV_8UC1; rows = height * 3 / 2; conversion = cv::COLOR_YUV2BGR_NV12; break;
+    case MJPGSHM_I420: type = CV_8UC1; rows = height * 3 / 2; conversion = cv::COLOR_YUV2BGR_I420; break;
+    case MJPGSHM_JPEG:
+        if(bytes <= this->mapped->header->slotbytes) jpeg.assign(payload, payload + bytes);
+        slot->readers.fetch_sub(1);
+        return !jpeg.empty();
+    }
+    size_t stride = slot->stride ? slot->stride : (size_t) width * CV_ELEM_SIZE(type);
+    if(type < 0 || width <= 0 || rows <= 0 || stride * rows > bytes || bytes > this->mapped->header->slotbytes)
+    {
+        std::cerr << "Shared memory ring " << this->name << " has a slot of unknown format or size" << std::endl;
+        slot->readers.fetch_sub(1);
+        return false;
+    }
+    //The view owns the lease, every copy of it shares the slot until the last one is released
+    cv::Mat leased(rows, width, type, payload, stride);
+    cv::UMatData *u = new cv::UMatData(this);
+    u->data = u->origdata = payload;
+    u->size = stride * rows;
+    u->refcount = 1;
+    u->userdata = new MjpgShmLease{this->mapped, slot};
+    leased.u = u;
+    leased.allocator = this;
+    if(conversion < 0)
+    {
+        frame = leased;
+        return true;
+    }
+    frame.allocator = converted;
+    cv::cvtColor(leased, frame, conversion); //Encoders take BGR, the slot is free again right after
+    return true;
+}
+
+void MjpgShmConsumer::wait(uint32_t seen, int milliseconds)
+{
+#ifdef __linux__
+    MjpgShmHeader *header = this->mapped->header;
+    timespec timeout;
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_nsec = (long) (milliseconds % 1000) * 1000000L;
+    header->sleepers.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->wake), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+    header->sleepers.fetch_sub(1);
+#else
+    (void) seen;
+    usleep(1000 * (milliseconds < 1 ? 1 : (milliseconds > 5 ? 5 : milliseconds)));
+#endif
+}
+
+cv::UMatData *MjpgShmConsumer::allocate(int dims, const int *sizes, int type, void *data, size_t *step, MjpgAccessFlag flags, cv::UMatUsageFlags usage) const
+{
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage); //Only views are leased, new buffers are plain
+}
+
+bool MjpgShmConsumer::allocate(cv::UMatData *u, MjpgAccessFlag, cv::UMatUsageFlags) const
+{
+    return u != nullptr;
+}
+
+void MjpgShmConsumer::deallocate(cv::UMatData *u) const
+{
+    if(!u) return;
+    MjpgShmLease *lease = (MjpgShmLease*) u->userdata;
+    if(lease)
+    {
+        lease->slot->readers.fetch_sub(1);
+        delete lease;
+    }
+    delete u;
+}
@@ -0,0 +1,229 @@
+/**
+    CS-11 Format
+    File: mjpgshm.h
+    Purpose: POSIX shared memory frame ring written by other processes and read without copying
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MJPGSHM_H_
+#define MJPGSHM_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "mjpgpool.h"
+
+//!What a slot of the ring holds
+enum MjpgShmFormat
+{
+    MJPGSHM_BGR = 1,
+    MJPGSHM_GRAY = 2,
+    //!Packed 4:2:2 luma and chroma pairs
+    MJPGSHM_YUYV = 3,
+    //!Luma plane followed by interleaved chroma at half resolution
+    MJPGSHM_NV12 = 4,
+    //!Luma plane followed by both chroma planes at half resolution
+    MJPGSHM_I420 = 5,
+    //!An encoded jpeg, width and height are informational
+    MJPGSHM_JPEG = 6
+};
+
+//! One preallocated slot, its payload follows at MjpgShmHeader::payload
+struct MjpgShmSlot
+{
+    //!Twice the sequence of the frame it holds, odd while the producer writes it
+    std::atomic<uint64_t> seq;
+    //!Leases the server holds on the payload, the producer never writes a leased slot
+    std::atomic<uint32_t> readers;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    //!Bytes per row of raw formats (0 for packed rows)
+    uint32_t stride;
+    uint32_t bytes;
+    //!CLOCK_MONOTONIC nanoseconds when the frame was captured
+    uint64_t captured;
+};
+
+//! Start of the shared memory object, the slots follow at slotoffset
+struct MjpgShmHeader
+{
+    //!Written last by the producer once the ring is set up
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t payload;
+    uint64_t slotbytes;
+    uint64_t slotoffset;
+    uint64_t slotstride;
+    //!Sequence of the newest complete frame shifted up 16 bits with its slot in the low bits
+    std::atomic<uint64_t> published;
+    //!Futex word bumped on every publish
+    std::atomic<uint32_t> wake;
+    //!Set while the server sleeps on wake so the producer only makes the syscall when needed
+    std::atomic<uint32_t> sleepers;
+    //!CLOCK_MONOTONIC nanoseconds of the producer's last sign of life
+    std::atomic<uint64_t> heartbeat;
+    //!Pid of the producer, cleared when it exits
+    std::atomic<int32_t> producer;
+};
+
+//! Writes frames into a ring another process serves ( @see MjpgShmConsumer )
+/*!
+This and the layout above are all a producer process needs. Creating a
+producer replaces any earlier ring of the same name. Frames are written
+into a slot nobody reads and published with one atomic store, so a
+producer never waits for the server: when every slot is leased the frame
+is dropped. There's one producer per ring. Call alive() while idle so
+the server can tell a quiet producer from a hung one.
+Example: { @code
+MjpgShmProducer ring("camera", 1920 * 1080 * 3);
+cv::Mat frame = ...;
+ring.publish(frame); }
+*/
+class MjpgShmProducer
+{
+public:
+    //! Create the ring
+    /*!
+    @param name the shared memory object (without the leading slash)
+    @param slotbytes the largest payload a slot takes
+    @param slots how many frames the ring holds, at least the server's pipeline depth times 3 plus 2 leave room to write
+    */
+    MjpgShmProducer(const std::string &, size_t, int slots = 8);
+    //!Unlinks the ring unless another producer replaced it, the server notices through the cleared pid
+    ~MjpgShmProducer();
+
+    //!Whether the ring could be created
+    bool ready(void) const { return this->header != nullptr; }
+
+    //!Bytes a slot takes at most
+    size_t capacity(void) const;
+
+    //! Get a free slot to write the next frame into
+    /*!
+    @return the slot's payload or null when every slot is leased
+    */
+    unsigned char *claim(void);
+
+    //! Publish the claimed slot
+    /*!
+    @param format what was written
+    @param width frame width in pixels
+    @param height frame height in pixels
+    @param stride bytes per row or 0 for packed rows
+    @param bytes payload size
+    @return false without a claimed slot or a payload that doesn't fit
+    */
+    bool commit(MjpgShmFormat, int, int, int, size_t);
+
+    //! Copy a frame into the next free slot and publish it
+    /*!
+    @return false when it didn't fit or every slot was leased
+    */
+    bool publish(MjpgShmFormat, int, int, int, const void *, size_t);
+
+    //! Publish a BGR or grayscale mat
+    bool publish(const cv::Mat &);
+
+    //! Publish an encoded jpeg
+    bool publish(const std::vector<unsigned char> &);
+
+    //!Tell the server the producer is still there
+    void alive(void);
+
+    //!Frames dropped because every slot was leased
+    unsigned long dropped(void) const { return this->drops; }
+
+private:
+    std::string name;
+    MjpgShmHeader *header = nullptr;
+    size_t length = 0;
+    //!Identifies the ring so a newer producer's ring of the same name isn't unlinked
+    unsigned long inode = 0;
+    //!Slot claimed for the next frame or -1
+    int claimed = -1;
+    //!Where the search for a free slot starts
+    uint32_t cursor = 0;
+    //!Sequence of the next frame
+    uint64_t next = 1;
+    unsigned long drops = 0;
+};
+
+//! Serves the frames of a producer's ring without copying them
+/*!
+Mats handed out point straight into the shared slot and lease it, the
+producer won't reuse the slot until the last copy of the mat is gone.
+Only YUV frames are converted (into a mat of the given allocator) which
+releases their slot right away. A producer that exited is noticed through
+its cleared pid and one that crashed or stopped publishing and sending
+heartbeats through the stall timeout, either way next() returns after the
+stall timeout instead of blocking and the ring is reopened once a producer
+is back. There's one consumer per
+ring, opening a ring it didn't map before clears leases a previous server left behind
+*/
+class MjpgShmConsumer : public cv::MatAllocator
+{
+public:
+    //! Create a consumer of a ring, nothing is opened yet
+    /*!
+    @param name the producer's ring name
+    @param stall milliseconds without frames or heartbeats before the producer counts as hung
+    */
+    MjpgShmConsumer(const std::string &, int stall = 2000);
+
+    //! Wait for a frame newer than the last one
+    /*!
+    @param frame set to a leased view of raw BGR and GRAY slots or a converted YUV frame
+    @param jpeg filled with the bytes of an encoded slot (frame is left empty)
+    @param converted allocator for converted YUV frames or null for the default
+    @return false when there's no producer or it exited or stalled, not before the stall timeout passed
+    */
+    bool next(cv::Mat &, std::vector<unsigned char> &, cv::MatAllocator *);
+
+    //!Shared memory mapping kept alive by the consumer and every lease
+    struct mapping;
+
+    cv::UMatData *allocate(int, const int *, int, void *, size_t *, MjpgAccessFlag, cv::UMatUsageFlags) const;
+    bool allocate(cv::UMatData *, MjpgAccessFlag, cv::UMatUsageFlags) const;
+    void deallocate(cv::UMatData *) const;
+
+private:
+    bool open(void);
+    //!Leases the newest slot if it's newer than the last one
+    MjpgShmSlot *take(void);
+    //!Hands out a leased slot as a mat or jpeg, releasing the lease unless the mat keeps it
+    bool view(MjpgShmSlot *, cv::Mat &, std::vector<unsigned char> &, cv::MatAllocator *);
+    //!Sleeps until the producer published past seen or the time is up
+    void wait(uint32_t, int);
+
+    const std::string name;
+    const int stall;
+    std::shared_ptr<mapping> mapped;
+    uint64_t last = 0;
+    //!Identifies the ring mapped last, reopening it keeps the leases since mats may still hold some
+    unsigned long inode = 0;
+    //!Whether the missing ring was already reported
+    bool reported = false;
+};
+
+#endif  // MJPGSHM_H_
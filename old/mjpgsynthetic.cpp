@@ -0,0 +1,124 @@
+/**
+    CS-11 Format
+    File: mjpgsynthetic.cpp
+    Purpose: Deterministic generated frames or a looping video to run the server without a camera
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgsynthetic.h"
+#include <cstring>
+#include <cstdint>
+
+//!Side of the square noise texture
+#define MJPGSYNTHETIC_TILE 256
+
+//!Cheap well mixed hash deciding which blocks are noisy in which frame
+static uint32_t mix(uint32_t value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+MjpgSyntheticSource::MjpgSyntheticSource(int width, int height, int complexity)
+    : width(width), height(height), complexity(complexity)
+{
+    if(this->width < 16) this->width = 16;
+    if(this->height < 16) this->height = 16;
+    if(this->complexity < 0) this->complexity = 0;
+    if(this->complexity > 100) this->complexity = 100;
+    this->gradient = cv::Mat(1, this->width * 2, CV_8UC3);
+    unsigned char *row = this->gradient.ptr(0);
+    for(int x = 0; x < this->width * 2; x++)
+    {
+        int phase = (x % this->width) * 510 / this->width; //Up and back down so the wrap is seamless
+        int level = phase > 255 ? 510 - phase : phase;
+        row[x * 3] = (unsigned char) level;
+        row[x * 3 + 1] = (unsigned char) (255 - level);
+        row[x * 3 + 2] = (unsigned char) ((level * 2) & 0xFF);
+    }
+    this->noise = cv::Mat(MJPGSYNTHETIC_TILE, MJPGSYNTHETIC_TILE, CV_8UC3);
+    uint32_t state = 0x9e3779b9U; //Fixed seed, every run renders the same frames
+    for(int y = 0; y < MJPGSYNTHETIC_TILE; y++)
+    {
+        unsigned char *texel = this->noise.ptr(y);
+        for(int x = 0; x < MJPGSYNTHETIC_TILE * 3; x++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            texel[x] = (unsigned char) state;
+        }
+    }
+}
+
+bool MjpgSyntheticSource::openVideo(const std::string &path)
+{
+    this->replay = this->video.open(path) && this->video.isOpened();
+    return this->replay;
+}
+
+void MjpgSyntheticSource::setRate(int fps)
+{
+    this->rate = fps;
+    this->pacer.setRate(fps);
+}
+
+bool MjpgSyntheticSource::next(cv::Mat &frame)
+{
+    if(this->rate > 0) this->pacer.wait();
+    this->index++;
+    if(this->replay)
+    {
+        if(this->video.read(frame)) return true;
+        this->video.set(cv::CAP_PROP_POS_FRAMES, 0); //Loop back to the start
+        return this->video.read(frame);
+    }
+    frame.create(this->height, this->width, CV_8UC3);
+    size_t stride = (size_t) this->width * 3;
+    for(int y = 0; y < this->height; y++)
+    {
+        size_t shift = (size_t) ((this->index * 4 + y) % this->width) * 3;
+        memcpy(frame.ptr(y), this->gradient.ptr(0) + shift, stride);
+    }
+    if(this->complexity > 0)
+    {
+        for(int by = 0; by + 8 <= this->height; by += 8)
+        {
+            for(int bx = 0; bx + 8 <= this->width; bx += 8)
+            {
+                uint32_t hash = mix((uint32_t) (by * 7919 + bx) ^ mix((uint32_t) this->index));
+                if((int) (hash % 100) >= this->complexity) continue;
+                int tx = (int) ((hash >> 8) % (MJPGSYNTHETIC_TILE - 8));
+                int ty = (int) ((hash >> 20) % (MJPGSYNTHETIC_TILE - 8));
+                for(int r = 0; r < 8; r++)
+                    memcpy(frame.ptr(by + r) + bx * 3, this->noise.ptr(ty + r) + tx * 3, 24);
+            }
+        }
+    }
+    int bar = this->width / 32;
+    int tall = this->height < 16 * 8 ? 2 : 16;
+    for(int b = 0; b < 32 && bar > 0; b++)
+    {
+        unsigned char level = ((this->index >> b) & 1) ? 255 : 0;
+        for(int y = 0; y < tall; y++)
+            memset(frame.ptr(y) + b * bar * 3, level, (size_t) bar * 3);
+    }
+    return true;
+}
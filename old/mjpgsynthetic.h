@@ -0,0 +1,99 @@
+/**
+    CS-11 Format
+    File: mjpgsynthetic.h
+    Purpose: Deterministic generated frames or a looping video to run the server without a camera
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGSYNTHETIC_H_
+#define MJPGSYNTHETIC_H_
+
+#pragma once
+
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "mjpgpacer.h"
+
+//! A camera stand in for benchmarks and load tests
+/*!
+Frame n is always the same picture for the same settings: a moving
+diagonal gradient with a share of its 8x8 blocks replaced by noise tiles
+and the frame number as 32 black and white bars along the top. The noise
+share (complexity) is what drives the encoded size and encode time.
+Everything is copied from tables built once so rendering even a 4K frame
+costs about a memcpy. Alternatively a video file is replayed in a loop.
+Only ever use a source from one thread, the server's capture thread
+*/
+class MjpgSyntheticSource
+{
+public:
+    //! Build the tables of a generated source
+    /*!
+    @param width frame width in pixels
+    @param height frame height in pixels
+    @param complexity 0 - 100 percent of the blocks filled with noise
+    */
+    MjpgSyntheticSource(int width, int height, int complexity);
+
+    //! Replay a video file instead of generating frames
+    /*!
+    @param path anything cv::VideoCapture opens, rewound at its end
+    @return false if it couldn't be opened (generated frames are kept)
+    */
+    bool openVideo(const std::string &);
+
+    //! Deliver frames at a fixed rate like a camera would
+    /*!
+    @param fps frames per second or -1 to hand them out as fast as asked
+    */
+    void setRate(int);
+
+    //! Render the next frame
+    /*!
+    Blocks until the frame is due when a rate is set. A frame of the right
+    size and type is drawn into in place so pooled mats stay pooled
+
+    @param frame the mat to draw into (@see MjpgServer::acquireFrame())
+    @return false when a video couldn't be read
+    */
+    bool next(cv::Mat &);
+
+    //!Frames rendered so far
+    unsigned long frames(void) const { return this->index; }
+
+    //!Generated frame width
+    int getWidth(void) const { return this->width; }
+
+    //!Generated frame height
+    int getHeight(void) const { return this->height; }
+
+private:
+    int width;
+    int height;
+    int complexity;
+    unsigned long index = 0;
+    //!Two periods of the gradient so any shifted row is one copy
+    cv::Mat gradient;
+    //!Random texture the noisy blocks are copied from
+    cv::Mat noise;
+    cv::VideoCapture video;
+    bool replay = false;
+    int rate = -1;
+    MjpgPacer pacer;
+};
+
+#endif  // MJPGSYNTHETIC_H_
@@ -0,0 +1,535 @@
+/**
+    CS-11 Format
+    File: mjpguring.cpp
+    Purpose: io_uring ring driven by an event loop batching frame sends and accepts
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpguring.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <cstdlib>
+#if defined(MJPGSERVER_URING) && defined(__linux__)
+#define MJPGURING_SUPPORTED 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+#endif
+
+//User data of the accept, sends use (operation << 2) | segment
+#define MJPGURING_ACCEPT 3
+
+//Registered frame slots hold jpegs up to this size, bigger ones are sent from the frame
+#define MJPGURING_SLOTBYTES (256 * 1024)
+
+//Clients of one loop that can send through the ring at the same time
+#define MJPGURING_FILES 4096
+
+#ifdef MJPGURING_SUPPORTED
+namespace
+{
+    int ringSetup(unsigned entries, struct io_uring_params *params)
+    {
+        return (int) syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    int ringEnter(int fd, unsigned submit, unsigned complete, unsigned flags)
+    {
+        return (int) syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+    }
+
+    int ringRegister(int fd, unsigned opcode, const void *arg, unsigned count)
+    {
+        return (int) syscall(__NR_io_uring_register, fd, opcode, arg, count);
+    }
+
+    unsigned *field(void *ring, unsigned offset)
+    {
+        return (unsigned *) ((char *) ring + offset);
+    }
+}
+#endif
+
+MjpgUring::MjpgUring(boost::asio::io_service &loop, unsigned entries, unsigned slots,
+                     MjpgCounter &submits, MjpgCounter &submitted, MjpgCounter &failures)
+    : loop(loop), notify(loop), submits(submits), entries(submitted), failures(failures)
+{
+#ifdef MJPGURING_SUPPORTED
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    params.cq_entries = entries * 8; //Every part completes three entries, leave room for a few batches
+    int fd = ringSetup(entries, &params);
+    if(fd < 0 && errno == EINVAL)
+    {
+        params.flags &= ~IORING_SETUP_SUBMIT_ALL;
+        fd = ringSetup(entries, &params);
+    }
+    if(fd < 0)
+    {
+        std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+        return;
+    }
+    this->sqringsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    this->cqringsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        this->sqringsize = this->cqringsize = std::max(this->sqringsize, this->cqringsize);
+    this->sqring = mmap(NULL, this->sqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    this->cqring = this->sqring;
+    if(this->sqring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+        this->cqring = mmap(NULL, this->cqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    this->sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+    this->sqes = mmap(NULL, this->sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    int notifier = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(this->sqring == MAP_FAILED || this->cqring == MAP_FAILED || this->sqes == MAP_FAILED || notifier < 0 ||
+       ringRegister(fd, IORING_REGISTER_EVENTFD, &notifier, 1) < 0)
+    {
+        std::cerr << "io_uring ring setup failed: " << strerror(errno) << std::endl;
+        if(notifier >= 0) ::close(notifier);
+        if(this->sqes != MAP_FAILED) munmap(this->sqes, this->sqessize);
+        if(this->cqring != MAP_FAILED && this->cqring != this->sqring) munmap(this->cqring, this->cqringsize);
+        if(this->sqring != MAP_FAILED) munmap(this->sqring, this->sqringsize);
+        this->sqring = this->cqring = this->sqes = nullptr;
+        ::close(fd);
+        return;
+    }
+    this->sqhead = field(this->sqring, params.sq_off.head);
+    this->sqtail = field(this->sqring, params.sq_off.tail);
+    this->sqflags = field(this->sqring, params.sq_off.flags);
+    this->sqmask = *field(this->sqring, params.sq_off.ring_mask);
+    this->sqentries = params.sq_entries;
+    unsigned *array = field(this->sqring, params.sq_off.array);
+    for(unsigned i = 0; i < params.sq_entries; i++) array[i] = i; //Entries are always used in ring order
+    this->cqhead = field(this->cqring, params.cq_off.head);
+    this->cqtail = field(this->cqring, params.cq_off.tail);
+    this->cqmask = *field(this->cqring, params.cq_off.ring_mask);
+    this->cqes = (char *) this->cqring + params.cq_off.cqes;
+    this->tail = this->submitted = *this->sqtail;
+    //Sockets are only ever named through this table so a closed client's number can't reach the next one
+    struct io_uring_rsrc_register table;
+    memset(&table, 0, sizeof(table));
+    table.nr = MJPGURING_FILES;
+    table.flags = IORING_RSRC_REGISTER_SPARSE;
+    if(ringRegister(fd, IORING_REGISTER_FILES2, &table, sizeof(table)) < 0)
+    {
+        std::cerr << "io_uring can't register sockets: " << strerror(errno) << std::endl;
+        ::close(notifier);
+        munmap(this->sqes, this->sqessize);
+        if(this->cqring != this->sqring) munmap(this->cqring, this->cqringsize);
+        munmap(this->sqring, this->sqringsize);
+        this->sqring = this->cqring = this->sqes = nullptr;
+        ::close(fd);
+        return;
+    }
+    this->ringfd = fd;
+    this->eventfd = notifier;
+    this->files.resize(MJPGURING_FILES);
+    for(int i = MJPGURING_FILES - 1; i >= 0; i--) this->freefiles.push_back(i);
+    //Frame slots are registered once, jpegs are copied in and sent from them without copying again
+    struct io_uring_probe *probe = (struct io_uring_probe *) calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    bool zerocopy = probe && ringRegister(fd, IORING_REGISTER_PROBE, probe, 256) >= 0 && probe->ops_len > IORING_OP_SEND_ZC &&
+                    (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    if(slots > 0 && zerocopy)
+    {
+        this->arenasize = (size_t) slots * MJPGURING_SLOTBYTES;
+        this->arena = (unsigned char *) mmap(NULL, this->arenasize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        std::vector<struct iovec> regions(slots);
+        for(unsigned i = 0; this->arena != MAP_FAILED && i < slots; i++)
+        {
+            regions[i].iov_base = this->arena + (size_t) i * MJPGURING_SLOTBYTES;
+            regions[i].iov_len = MJPGURING_SLOTBYTES;
+        }
+        if(this->arena != MAP_FAILED && ringRegister(fd, IORING_REGISTER_BUFFERS, regions.data(), slots) >= 0)
+            this->slots.resize(slots);
+        else
+        {
+            std::cerr << "io_uring can't register frame buffers, sending them unregistered" << std::endl;
+            if(this->arena != MAP_FAILED) munmap(this->arena, this->arenasize);
+            this->arena = nullptr;
+        }
+    }
+    boost::system::error_code ignored;
+    this->notify.assign(notifier, ignored);
+    this->arm();
+#else
+    (void) entries;
+    (void) slots;
+#endif
+}
+
+MjpgUring::~MjpgUring()
+{
+#ifdef MJPGURING_SUPPORTED
+    if(this->ringfd < 0) return;
+    boost::system::error_code ignored;
+    this->notify.close(ignored); //Closes the eventfd
+    munmap(this->sqes, this->sqessize);
+    if(this->cqring != this->sqring) munmap(this->cqring, this->cqringsize);
+    munmap(this->sqring, this->sqringsize);
+    ::close(this->ringfd); //The kernel cancels whatever is still in flight
+    if(this->arena) munmap(this->arena, this->arenasize);
+#endif
+}
+
+bool MjpgUring::room(unsigned count)
+{
+#ifdef MJPGURING_SUPPORTED
+    if(this->tail + count - __atomic_load_n(this->sqhead, __ATOMIC_ACQUIRE) <= this->sqentries) return true;
+    this->submit(); //Full, hand over what we have so the kernel frees the entries
+    return this->tail + count - __atomic_load_n(this->sqhead, __ATOMIC_ACQUIRE) <= this->sqentries;
+#else
+    (void) count;
+    return false;
+#endif
+}
+
+void *MjpgUring::entry(unsigned offset)
+{
+#ifdef MJPGURING_SUPPORTED
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *) this->sqes + ((this->tail + offset) & this->sqmask);
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+#else
+    (void) offset;
+    return nullptr;
+#endif
+}
+
+void MjpgUring::submit()
+{
+#ifdef MJPGURING_SUPPORTED
+    unsigned count = this->tail - this->submitted;
+    if(count == 0) return;
+    __atomic_store_n(this->sqtail, this->tail, __ATOMIC_RELEASE);
+    int taken = ringEnter(this->ringfd, count, 0, 0);
+    if(taken < 0)
+    {
+        this->failures.add();
+        //The kernel is out of completion space (EBUSY) or memory (EAGAIN), no other send may come along to
+        //submit these so try again once the loop reaped what it can
+        if((errno == EBUSY || errno == EAGAIN || errno == EINTR) && !this->flushing)
+        {
+            this->flushing = true;
+            this->loop.post(std::bind(&MjpgUring::flush, this));
+        }
+        return;
+    }
+    this->submitted += taken;
+    this->submits.add();
+    this->entries.add(taken);
+    if((unsigned) taken < count && !this->flushing)
+    {
+        this->flushing = true; //The rest goes with the next flush
+        this->loop.post(std::bind(&MjpgUring::flush, this));
+    }
+#endif
+}
+
+void MjpgUring::flush()
+{
+    this->flushing = false;
+    this->reap(); //Frees completion space a failed submit was waiting for
+    this->submit();
+}
+
+void MjpgUring::send(int fd, MjpgFramePtr frame, boost::asio::const_buffer stamp, sent done)
+{
+#ifdef MJPGURING_SUPPORTED
+    int file = this->room(3) ? this->fileOf(fd) : -1;
+    if(file < 0)
+    {
+        this->loop.post(std::bind(done, 0, 0)); //Nothing written, the caller sends it all
+        return;
+    }
+    size_t index;
+    if(this->spare.empty())
+    {
+        index = this->operations.size();
+        this->operations.push_back(std::unique_ptr<operation>(new operation()));
+    }
+    else
+    {
+        index = this->spare.back();
+        this->spare.pop_back();
+    }
+    operation &op = *this->operations[index];
+    op.frame = frame;
+    op.file = file;
+    this->files[file].users++;
+    op.slot = this->slotOf(frame);
+    op.done = done;
+    op.outstanding = 3;
+    op.notifications = 0;
+    op.head[0].iov_base = (void *) frame->header.data();
+    op.head[0].iov_len = frame->header.size();
+    op.head[1].iov_base = (void *) boost::asio::buffer_cast<const void *>(stamp);
+    op.head[1].iov_len = boost::asio::buffer_size(stamp);
+    memset(&op.message, 0, sizeof(op.message));
+    op.message.msg_iov = op.head;
+    op.message.msg_iovlen = 2;
+    op.lengths[0] = op.head[0].iov_len + op.head[1].iov_len;
+    op.lengths[1] = frame->content().jpeg.size();
+    op.lengths[2] = 2;
+    uint64_t tag = (uint64_t) index << 2;
+    struct io_uring_sqe *sqe[3];
+    for(unsigned i = 0; i < 3; i++) sqe[i] = (struct io_uring_sqe *) this->entry(i);
+
+    sqe[0]->opcode = IORING_OP_SENDMSG;
+    sqe[0]->fd = file;
+    sqe[0]->addr = (uint64_t) (uintptr_t) &op.message;
+    sqe[0]->len = 1;
+    sqe[0]->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    sqe[0]->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe[0]->user_data = tag;
+
+    sqe[1]->fd = file;
+    sqe[1]->len = frame->content().jpeg.size();
+    sqe[1]->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    sqe[1]->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe[1]->user_data = tag | 1;
+    if(op.slot >= 0)
+    {
+        sqe[1]->opcode = IORING_OP_SEND_ZC; //Straight out of the pinned slot
+        sqe[1]->addr = (uint64_t) (uintptr_t) (this->arena + (size_t) op.slot * MJPGURING_SLOTBYTES);
+        sqe[1]->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe[1]->buf_index = op.slot;
+    }
+    else
+    {
+        sqe[1]->opcode = IORING_OP_SEND;
+        sqe[1]->addr = (uint64_t) (uintptr_t) frame->content().jpeg.data();
+    }
+
+    sqe[2]->opcode = IORING_OP_SEND;
+    sqe[2]->fd = file;
+    sqe[2]->addr = (uint64_t) (uintptr_t) "\r\n";
+    sqe[2]->len = 2;
+    sqe[2]->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    sqe[2]->flags = IOSQE_FIXED_FILE;
+    sqe[2]->user_data = tag | 2;
+    this->tail += 3;
+
+    if(!this->flushing)
+    {
+        //Every client woken by the same publish queues before this runs
+        this->flushing = true;
+        this->loop.post(std::bind(&MjpgUring::flush, this));
+    }
+#else
+    (void) fd;
+    (void) frame;
+    (void) stamp;
+    this->loop.post(std::bind(done, 0, 0));
+#endif
+}
+
+void MjpgUring::release(int fd)
+{
+#ifdef MJPGURING_SUPPORTED
+    std::map<int, int>::iterator found = this->filed.find(fd);
+    if(found == this->filed.end()) return;
+    int file = found->second;
+    this->filed.erase(found);
+    //Entries not issued yet fail instead of reaching the socket, issued ones hold their own reference
+    int none = -1;
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = file;
+    update.fds = (uint64_t) (uintptr_t) &none;
+    ringRegister(this->ringfd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    this->files[file].released = true;
+    if(this->files[file].users == 0) this->freeFile(file);
+#else
+    (void) fd;
+#endif
+}
+
+int MjpgUring::fileOf(int fd)
+{
+#ifdef MJPGURING_SUPPORTED
+    std::map<int, int>::iterator found = this->filed.find(fd);
+    if(found != this->filed.end()) return found->second;
+    if(this->freefiles.empty()) return -1;
+    int file = this->freefiles.back();
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = file;
+    update.fds = (uint64_t) (uintptr_t) &fd;
+    if(ringRegister(this->ringfd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 1) return -1;
+    this->freefiles.pop_back();
+    this->files[file].users = 0;
+    this->files[file].released = false;
+    this->filed[fd] = file;
+    return file;
+#else
+    (void) fd;
+    return -1;
+#endif
+}
+
+void MjpgUring::freeFile(int file)
+{
+    this->files[file].released = false;
+    this->freefiles.push_back(file); //Nothing names it anymore, the next client may take it
+}
+
+int MjpgUring::slotOf(const MjpgFramePtr &frame)
+{
+#ifdef MJPGURING_SUPPORTED
+    const MjpgFramePtr &bytes = frame->reuses ? frame->reuses : frame; //A frame sent again shares the slot of its bytes
+    if(bytes->jpeg.empty() || bytes->jpeg.size() > MJPGURING_SLOTBYTES) return -1;
+    int free = -1;
+    for(size_t i = 0; i < this->slots.size(); i++)
+    {
+        if(this->slots[i].frame == bytes)
+        {
+            this->slots[i].users++;
+            return (int) i;
+        }
+        if(free < 0 && !this->slots[i].frame) free = (int) i;
+    }
+    if(free < 0) return -1;
+    //One copy per frame and loop, every client of the loop sends it from the slot
+    memcpy(this->arena + (size_t) free * MJPGURING_SLOTBYTES, bytes->jpeg.data(), bytes->jpeg.size());
+    this->slots[free].frame = bytes;
+    this->slots[free].users = 1;
+    return free;
+#else
+    (void) frame;
+    return -1;
+#endif
+}
+
+void MjpgUring::finish(size_t index)
+{
+    operation &op = *this->operations[index];
+    if(op.outstanding > 0 || op.notifications > 0) return;
+    if(op.slot >= 0 && --this->slots[op.slot].users == 0) this->slots[op.slot].frame.reset();
+    if(--this->files[op.file].users == 0 && this->files[op.file].released) this->freeFile(op.file);
+    op.frame.reset();
+    this->spare.push_back(index);
+}
+
+bool MjpgUring::accept(int fd, accepted handler)
+{
+    this->listenfd = fd;
+    this->onaccept = handler;
+    return this->queueAccept();
+}
+
+bool MjpgUring::queueAccept()
+{
+#ifdef MJPGURING_SUPPORTED
+    if(!this->room(1)) return false;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *) this->entry(0);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = this->listenfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT; //One entry keeps completing with every new connection
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = MJPGURING_ACCEPT;
+    this->tail++;
+    this->submit();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MjpgUring::arm()
+{
+    this->notify.async_read_some(boost::asio::buffer(&this->notified, sizeof(this->notified)),
+                                 std::bind(&MjpgUring::onNotify, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void MjpgUring::onNotify(const boost::system::error_code &error, size_t)
+{
+    if(error) return; //Closed with the ring
+    this->reap();
+    this->arm();
+}
+
+void MjpgUring::reap()
+{
+#ifdef MJPGURING_SUPPORTED
+    for(;;)
+    {
+        unsigned head = *this->cqhead;
+        unsigned last = __atomic_load_n(this->cqtail, __ATOMIC_ACQUIRE);
+        if(head == last)
+        {
+            //Completions that didn't fit the queue wait in the kernel until asked for
+            if(!(__atomic_load_n(this->sqflags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) break;
+            ringEnter(this->ringfd, 0, 0, IORING_ENTER_GETEVENTS);
+            if(__atomic_load_n(this->cqtail, __ATOMIC_ACQUIRE) == head) break;
+            continue;
+        }
+        struct io_uring_cqe cqe = ((struct io_uring_cqe *) this->cqes)[head & this->cqmask];
+        __atomic_store_n(this->cqhead, head + 1, __ATOMIC_RELEASE); //Free the entry before the callback queues more
+        this->complete(cqe.user_data, cqe.res, cqe.flags);
+    }
+#endif
+}
+
+void MjpgUring::complete(uint64_t tag, int result, unsigned flags)
+{
+#ifdef MJPGURING_SUPPORTED
+    if(tag == MJPGURING_ACCEPT)
+    {
+        this->onaccept(result);
+        if(flags & IORING_CQE_F_MORE) return;
+        if(result == -EINVAL || result == -EOPNOTSUPP || result == -EBADF) return; //Not supported, the server accepts another way
+        this->queueAccept(); //The kernel ended the multishot (out of memory or descriptors), start another
+        return;
+    }
+    size_t index = (size_t) (tag >> 2);
+    operation &op = *this->operations[index];
+    if(flags & IORING_CQE_F_NOTIF)
+    {
+        op.notifications--; //The kernel let go of the slot's pages
+        this->finish(index);
+        return;
+    }
+    op.results[tag & 3] = result;
+    if(flags & IORING_CQE_F_MORE) op.notifications++; //A zerocopy send, the slot stays busy until its notification
+    if(--op.outstanding > 0) return;
+    //A short or failed entry cancels the ones linked after it, count only the bytes in order
+    size_t written = 0;
+    int failure = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        int done = op.results[i];
+        if(done < 0)
+        {
+            if(done != -ECANCELED && done != -EAGAIN && done != -EINTR) failure = -done;
+            break;
+        }
+        written += done;
+        if((size_t) done < op.lengths[i]) break;
+    }
+    sent callback;
+    callback.swap(op.done);
+    callback(written, failure);
+    this->finish(index);
+#else
+    (void) tag;
+    (void) result;
+    (void) flags;
+#endif
+}
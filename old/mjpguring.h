@@ -0,0 +1,217 @@
+/**
+    CS-11 Format
+    File: mjpguring.h
+    Purpose: io_uring ring driven by an event loop batching frame sends and accepts
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGURING_H_
+#define MJPGURING_H_
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include "mjpgframe.h"
+#include "mjpgmetrics.h"
+
+//! An io_uring instance living on one event loop
+/*!
+Sends queued while the loop runs its handlers are collected in the
+submission queue and handed to the kernel with a single io_uring_enter
+once those handlers are done, so a publish waking a few hundred clients
+on a loop costs one syscall instead of one per client. Completions raise
+an eventfd the loop waits on like on any socket and their callbacks run
+on the loop.
+
+A part goes out as three linked entries: the header with the client's
+stamp, the jpeg and the closing newline. Sockets are named through a
+table of registered files, a client's entry is cleared when it closes and
+only reused once its last send completed, so entries still queued can't
+reach whoever gets the same descriptor number next. Frame slots are
+registered once, a jpeg is copied into a free slot the first time a
+client of the loop sends it and goes out of it with zerocopy sends, the
+slot is reused once the kernel is done with every send of it. If the
+slots run out, the jpeg is too big or the kernel has no zerocopy sends it
+is sent like the rest. Every entry carries MSG_NOSIGNAL and MSG_DONTWAIT,
+so a socket that fills up ends its entry short (or with EAGAIN) instead
+of having the kernel wait for room, which cancels the entries linked
+after it.
+
+Talks to the kernel through the raw syscalls (Linux 5.19 or newer for
+multishot accept and sparse file tables, 6.0 for zerocopy sends) and is only compiled in with
+MJPGSERVER_URING, otherwise ready() is always false. Used from its loop
+only
+*/
+class MjpgUring
+{
+public:
+    //!Runs with the bytes written and 0 or the errno that stopped the part
+    typedef std::function<void(size_t, int)> sent;
+
+    //!Runs with an accepted socket or a negative errno
+    typedef std::function<void(int)> accepted;
+
+    //! Set up a ring on an event loop
+    /*!
+    @param loop the event loop that submits and completes
+    @param entries submission queue size
+    @param slots registered frame buffers
+    @param submits counts io_uring_enter calls submitting work
+    @param submitted counts entries handed to the kernel
+    @param failures counts io_uring_enter calls that failed, their entries are submitted again from the loop
+    */
+    MjpgUring(boost::asio::io_service &, unsigned, unsigned, MjpgCounter &, MjpgCounter &, MjpgCounter &);
+
+    ~MjpgUring(void);
+
+    //! Whether the kernel gave us a working ring
+    /*!
+    @return false when io_uring is missing, disabled or not compiled in
+    */
+    bool ready(void) const { return this->ringfd >= 0; }
+
+    //! Queue a multipart part write to a socket
+    /*!
+    The write is submitted together with everything else queued before the
+    loop gets idle. A socket that's full fails the part short instead of
+    waiting, the caller finishes the rest its usual way
+
+    @param fd the connected socket
+    @param frame kept alive until the write completed
+    @param stamp the client's send stamp, must stay put until done runs
+    @param done runs on the loop once the part completed
+    */
+    void send(int, MjpgFramePtr, boost::asio::const_buffer, sent);
+
+    //! Forget a socket before it is closed
+    /*!
+    Sends queued for it but not issued yet fail, the descriptor number
+    is free to be reused by the next connection right after
+
+    @param fd the socket about to be closed
+    */
+    void release(int);
+
+    //! Accept every connection of a listening socket with one multishot accept
+    /*!
+    @param fd the listening socket
+    @param handler runs for every accepted socket, a negative errno of
+    EINVAL or EOPNOTSUPP means the kernel can't do it and accepting stopped
+    @return false if the accept couldn't be queued
+    */
+    bool accept(int, accepted);
+
+private:
+    struct operation
+    {
+        MjpgFramePtr frame;
+        int slot;
+        //!Registered file of the socket
+        int file;
+        struct msghdr message;
+        struct iovec head[2];
+        size_t lengths[3];
+        int results[3];
+        unsigned outstanding;
+        //!Zerocopy notifications still to come
+        unsigned notifications;
+        sent done;
+    };
+
+    struct file
+    {
+        unsigned users;
+        //!The socket was released, the entry is free once users drops to 0
+        bool released;
+    };
+
+    struct slot
+    {
+        MjpgFramePtr frame;
+        unsigned users;
+    };
+
+    //!Whether count more entries fit, submits what's queued to make room
+    bool room(unsigned);
+    //!The cleared entry offset places past the queued ones
+    void *entry(unsigned);
+    //!Hand everything queued to the kernel
+    void submit(void);
+    //!Queued from the first send of a batch, runs after the handlers that came before it
+    void flush(void);
+    void arm(void);
+    void onNotify(const boost::system::error_code &, size_t);
+    void reap(void);
+    void complete(uint64_t, int, unsigned);
+    //!Registered slot holding the frame's jpeg or -1
+    int slotOf(const MjpgFramePtr &);
+    //!Registered file of a socket, registering it on its first send, or -1
+    int fileOf(int);
+    void freeFile(int);
+    //!Recycles an operation once its sends and notifications all completed
+    void finish(size_t);
+    bool queueAccept(void);
+
+    boost::asio::io_service &loop;
+    boost::asio::posix::stream_descriptor notify;
+    uint64_t notified = 0;
+    int ringfd = -1;
+    int eventfd = -1;
+    void *sqring = nullptr;
+    void *cqring = nullptr;
+    void *sqes = nullptr;
+    size_t sqringsize = 0;
+    size_t cqringsize = 0;
+    size_t sqessize = 0;
+    unsigned *sqhead = nullptr;
+    unsigned *sqtail = nullptr;
+    unsigned *sqflags = nullptr;
+    unsigned sqmask = 0;
+    unsigned sqentries = 0;
+    unsigned *cqhead = nullptr;
+    unsigned *cqtail = nullptr;
+    unsigned cqmask = 0;
+    void *cqes = nullptr;
+    //!Our copy of the submission tail and how much of it the kernel has seen
+    unsigned tail = 0;
+    unsigned submitted = 0;
+    bool flushing = false;
+    std::vector<std::unique_ptr<operation> > operations;
+    std::vector<size_t> spare;
+    std::vector<slot> slots;
+    //!The registered frame slots, MJPGURING_SLOTBYTES each
+    unsigned char *arena = nullptr;
+    size_t arenasize = 0;
+    std::vector<file> files;
+    std::vector<int> freefiles;
+    //!Registered file of every socket that sent through the ring and wasn't released
+    std::map<int, int> filed;
+    int listenfd = -1;
+    accepted onaccept;
+    MjpgCounter &submits;
+    MjpgCounter &entries;
+    MjpgCounter &failures;
+};
+
+#endif  // MJPGURING_H_
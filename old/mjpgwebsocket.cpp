@@ -0,0 +1,150 @@
+/**
+    CS-11 Format
+    File: mjpgwebsocket.cpp
+    Purpose: Frames server side WebSocket messages and reads the acks coming back
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <openssl/sha.h>
+#include <openssl/evp.h>
+#include "mjpgwebsocket.h"
+
+//!Appended to the client's key before hashing, fixed by the protocol
+static const char *MJPGWEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+//!Longest frame header a client may send (length and mask included)
+#define MJPGWEBSOCKET_MAXHEADER 14
+
+MjpgWebSocket::MjpgWebSocket(size_t maxpayload) : maxpayload(maxpayload) {}
+
+std::string MjpgWebSocket::acceptKey(boost::string_ref key)
+{
+    std::string keyed = key.to_string() + MJPGWEBSOCKET_GUID;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char *) keyed.data(), keyed.size(), digest);
+    unsigned char encoded[(SHA_DIGEST_LENGTH + 2) / 3 * 4 + 1]; //Base64 and its terminator
+    int length = EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+    return std::string((const char *) encoded, length);
+}
+
+size_t MjpgWebSocket::header(unsigned char *out, int opcode, uint64_t length)
+{
+    out[0] = 0x80 | (opcode & 0x0F); //Always final, frames are never split
+    if(length < 126)
+    {
+        out[1] = (unsigned char) length;
+        return 2;
+    }
+    if(length <= 0xFFFF)
+    {
+        out[1] = 126;
+        out[2] = (unsigned char) (length >> 8);
+        out[3] = (unsigned char) length;
+        return 4;
+    }
+    out[1] = 127;
+    for(int i = 0; i < 8; i++) out[2 + i] = (unsigned char) (length >> (56 - i * 8));
+    return 10;
+}
+
+std::string MjpgWebSocket::control(int opcode, boost::string_ref payload)
+{
+    unsigned char head[10];
+    size_t length = payload.size() > 125 ? 125 : payload.size();
+    size_t headlength = MjpgWebSocket::header(head, opcode, length);
+    return std::string((const char *) head, headlength) + std::string(payload.data(), length);
+}
+
+bool MjpgWebSocket::append(const char *data, size_t length)
+{
+    if(this->used > 0)
+    {
+        this->buffer.erase(this->buffer.begin(), this->buffer.begin() + this->used); //Drop what was taken out already
+        this->used = 0;
+    }
+    //Nothing but a single frame that isn't complete yet may be pending
+    if(this->buffer.size() + length > this->maxpayload + MJPGWEBSOCKET_MAXHEADER) return false;
+    this->buffer.insert(this->buffer.end(), (const unsigned char *) data, (const unsigned char *) data + length);
+    return true;
+}
+
+MjpgWebSocket::result MjpgWebSocket::next(message &next)
+{
+    while(true)
+    {
+        const unsigned char *frame = this->buffer.data() + this->used;
+        size_t available = this->buffer.size() - this->used;
+        if(available < 2) return incomplete;
+        bool final = (frame[0] & 0x80) != 0;
+        int opcode = frame[0] & 0x0F;
+        if((frame[0] & 0x70) || !(frame[1] & 0x80)) return invalid; //No extensions were agreed on and clients must mask
+        uint64_t length = frame[1] & 0x7F;
+        size_t headlength = 2;
+        if(length == 126)
+        {
+            if(available < 4) return incomplete;
+            length = ((uint64_t) frame[2] << 8) | frame[3];
+            headlength = 4;
+        }
+        else if(length == 127)
+        {
+            if(available < 10) return incomplete;
+            length = 0;
+            for(int i = 0; i < 8; i++) length = (length << 8) | frame[2 + i];
+            headlength = 10;
+        }
+        bool control = (opcode & 0x08) != 0;
+        if(control && (!final || length > 125)) return invalid;
+        if(length + (this->fragmented ? this->partial.size() : 0) > this->maxpayload) return invalid;
+        if(available < headlength + 4 + length) return incomplete;
+        const unsigned char *mask = frame + headlength;
+        unsigned char *payload = this->buffer.data() + this->used + headlength + 4;
+        for(size_t i = 0; i < length; i++) payload[i] ^= mask[i % 4]; //Unmasked where it was read, the view points there
+        boost::string_ref unmasked((const char *) payload, (size_t) length);
+        this->used += headlength + 4 + length;
+        if(control)
+        {
+            next.opcode = opcode;
+            next.payload = unmasked;
+            return complete;
+        }
+        if(opcode == CONTINUATION)
+        {
+            if(!this->fragmented) return invalid;
+        }
+        else if(opcode == TEXT || opcode == BINARY)
+        {
+            if(this->fragmented) return invalid;
+            if(final)
+            {
+                next.opcode = opcode;
+                next.payload = unmasked; //Unfragmented messages are never copied
+                return complete;
+            }
+            this->partialop = opcode;
+            this->partial.clear();
+        }
+        else return invalid;
+        this->partial.append(unmasked.data(), unmasked.size());
+        this->fragmented = !final;
+        if(final)
+        {
+            next.opcode = this->partialop;
+            next.payload = this->partial; //Cleared when the next fragmented message starts
+            return complete;
+        }
+    }
+}
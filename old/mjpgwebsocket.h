@@ -0,0 +1,129 @@
+/**
+    CS-11 Format
+    File: mjpgwebsocket.h
+    Purpose: Frames server side WebSocket messages and reads the acks coming back
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGWEBSOCKET_H_
+#define MJPGWEBSOCKET_H_
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <boost/utility/string_ref.hpp>
+
+//! The server side of RFC 6455 WebSocket framing
+/*!
+Only what a frame pushing server needs: the handshake answer, headers of
+unmasked server frames (the payload is written right behind them from
+wherever it already is) and a reader for the masked client frames.
+Client messages are expected to be tiny (acks, pings and closes), bigger
+ones are a protocol error. Nothing here touches a socket
+*/
+class MjpgWebSocket
+{
+public:
+    enum opcode
+    {
+        CONTINUATION = 0x0,
+        TEXT = 0x1,
+        BINARY = 0x2,
+        CLOSE = 0x8,
+        PING = 0x9,
+        PONG = 0xA
+    };
+
+    enum result
+    {
+        //!Need more bytes
+        incomplete,
+        //!A whole message was taken out
+        complete,
+        //!Not a frame a client may send
+        invalid
+    };
+
+    //! A message read from the client
+    struct message
+    {
+        int opcode = BINARY;
+        //!Points into the reader, valid until the next append()
+        boost::string_ref payload;
+    };
+
+    //! Create a reader for client messages up to maxpayload bytes
+    MjpgWebSocket(size_t maxpayload = 4096);
+
+    //! Get the Sec-WebSocket-Accept value answering a handshake
+    /*!
+    @param key the client's Sec-WebSocket-Key
+    @return the base64 sha1 of the key and the protocol's guid
+    */
+    static std::string acceptKey(boost::string_ref);
+
+    //! Write the header of an unmasked final server frame
+    /*!
+    @param out at least 10 bytes to write into
+    @param opcode what the frame carries
+    @param length the payload size that follows the header
+    @return how many bytes of out the header took (2 to 10)
+    */
+    static size_t header(unsigned char *, int, uint64_t);
+
+    //! Build a whole control frame (close, ping or pong)
+    /*!
+    @param opcode the control opcode
+    @param payload at most 125 bytes
+    @return the frame's bytes
+    */
+    static std::string control(int, boost::string_ref);
+
+    //! Buffer bytes read from the client
+    /*!
+    Whatever next() took out is dropped first
+
+    @param data what was read
+    @param length how much
+    @return false when more is pending than a single allowed frame, nothing was buffered then
+    */
+    bool append(const char *, size_t);
+
+    //! Take the next whole message out of what was buffered
+    /*!
+    Fragments are put back together, control frames in between them come
+    out on their own
+
+    @param next filled with the message when complete
+    @return whether a message was taken, more bytes are needed or the client broke the protocol
+    */
+    result next(message &);
+
+private:
+    const size_t maxpayload;
+    std::vector<unsigned char> buffer;
+    //!Start of the bytes not taken out yet
+    size_t used = 0;
+    //!A fragmented message being put together
+    std::string partial;
+    int partialop = BINARY;
+    bool fragmented = false;
+};
+
+#endif  // MJPGWEBSOCKET_H_
@@ -0,0 +1,169 @@
+/**
+    CS-11 Format
+    File: mjpgworkers.h
+    Purpose: Encode threads shared by the profile encodes and the strips of every source
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGWORKERS_H_
+#define MJPGWORKERS_H_
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <mutex>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+//! Threads every source hands its per profile encodes and strips to
+/*!
+One pool for the whole server so the encode threads don't multiply with
+the sources or the strips of large frames. A task is a plain function
+with the work item and index it is for, queued in a ring that only grows
+while warming up, so posting one doesn't allocate. A task waiting on
+tasks of its own runs those still queued itself ( @see help() ) so nested
+work can't tie up every thread. The threads start with the first task
+*/
+class MjpgWorkers
+{
+public:
+    //!Runs on a worker with the owner, work item and index it was posted with
+    typedef void (*task)(void *, void *, size_t);
+
+    ~MjpgWorkers()
+    {
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            this->stopping = true;
+        }
+        this->ready.notify_all();
+        this->workers.join_all();
+    }
+
+    //! Set how many threads run tasks, only before the first post
+    /*!
+    @param threads number of threads or -1 for one per cpu core
+    */
+    void setThreads(int threads)
+    {
+        this->threads = threads;
+    }
+
+    //! Queue a task for the next free thread
+    /*!
+    @param run the function to call
+    @param owner passed back to run
+    @param item what the task works on, like a pipeline job
+    @param index the part of the item the task is for
+    */
+    void post(task run, void *owner, void *item, size_t index)
+    {
+        std::call_once(this->started, &MjpgWorkers::start, this);
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            if(this->count == this->ring.size()) this->grow();
+            queued &queuedtask = this->ring[(this->head + this->count++) % this->ring.size()];
+            queuedtask.run = run;
+            queuedtask.owner = owner;
+            queuedtask.item = item;
+            queuedtask.index = index;
+        }
+        this->ready.notify_one();
+    }
+
+    //! Run one of an owner's queued tasks on the calling thread
+    /*!
+    For a thread waiting on the tasks it posted: once this finds none of
+    them queued all of them are already running on some thread, so the
+    wait can't depend on a pool thread that is itself waiting
+
+    @param owner the owner the tasks were posted with
+    @return false if none of its tasks was queued
+    */
+    bool help(void *owner)
+    {
+        queued next;
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            size_t at = 0;
+            while(at < this->count && this->ring[(this->head + at) % this->ring.size()].owner != owner) at++;
+            if(at == this->count) return false;
+            next = this->ring[(this->head + at) % this->ring.size()];
+            for(; at + 1 < this->count; at++) //Close the gap keeping the others in order
+                this->ring[(this->head + at) % this->ring.size()] = this->ring[(this->head + at + 1) % this->ring.size()];
+            this->count--;
+        }
+        next.run(next.owner, next.item, next.index);
+        return true;
+    }
+
+private:
+    struct queued
+    {
+        task run;
+        void *owner;
+        void *item;
+        size_t index;
+    };
+
+    void start()
+    {
+        int count = this->threads;
+        if(count < 1) count = boost::thread::hardware_concurrency();
+        if(count < 1) count = 1;
+        for(int i = 0; i < count; i++)
+            this->workers.create_thread([this]() { this->work(); });
+    }
+
+    //!Doubles the ring keeping the queued tasks in order
+    void grow()
+    {
+        std::vector<queued> larger(this->ring.empty() ? 16 : this->ring.size() * 2);
+        for(size_t i = 0; i < this->count; i++) larger[i] = this->ring[(this->head + i) % this->ring.size()];
+        this->ring.swap(larger);
+        this->head = 0;
+    }
+
+    void work()
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        while(1)
+        {
+            while(this->count == 0 && !this->stopping) this->ready.wait(l);
+            if(this->stopping) return;
+            queued next = this->ring[this->head];
+            this->head = (this->head + 1) % this->ring.size();
+            this->count--;
+            l.unlock();
+            next.run(next.owner, next.item, next.index);
+            l.lock();
+        }
+    }
+
+    int threads = -1;
+    std::once_flag started;
+    boost::mutex mutex;
+    boost::condition_variable ready;
+    std::vector<queued> ring;
+    size_t head = 0;
+    size_t count = 0;
+    bool stopping = false;
+    boost::thread_group workers;
+};
+
+#endif  // MJPGWORKERS_H_
@@ -0,0 +1,101 @@
+/**
+    CS-11 Format
+    File: mjpgzerocopy.cpp
+    Purpose: MSG_ZEROCOPY sends of shared frames with completions read from the error queue
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "mjpgzerocopy.h"
+#include <cerrno>
+#include <netinet/in.h>
+#ifdef MJPGZEROCOPY_SUPPORTED
+#include <linux/errqueue.h>
+#endif
+
+MjpgZeroCopy::MjpgZeroCopy(MjpgCounter &zerocopied, MjpgCounter &copied)
+    : zerocopied(zerocopied), copied(copied) {}
+
+bool MjpgZeroCopy::enable(int fd)
+{
+#ifdef MJPGZEROCOPY_SUPPORTED
+    int on = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+#else
+    (void) fd;
+    return false;
+#endif
+}
+
+long MjpgZeroCopy::send(int fd, const struct iovec *parts, int count, std::shared_ptr<const MjpgZeroCopyFrame> keep)
+{
+#ifdef MJPGZEROCOPY_SUPPORTED
+    struct msghdr message = {};
+    message.msg_iov = const_cast<struct iovec *>(parts);
+    message.msg_iovlen = count;
+    long sent = sendmsg(fd, &message, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(sent < 0) return sent; //Failed sends don't use up an id
+    inflight pinned = { this->next++, (size_t) sent, keep };
+    this->queue.push_back(pinned);
+    return sent;
+#else
+    (void) fd; (void) parts; (void) count; (void) keep;
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+bool MjpgZeroCopy::reap(int fd)
+{
+#ifdef MJPGZEROCOPY_SUPPORTED
+    while(!this->queue.empty())
+    {
+        char control[128];
+        struct msghdr message = {};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if(recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break; //Nothing more finished yet
+        for(struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+        {
+            if(!((header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) ||
+                 (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR))) continue;
+            const struct sock_extended_err *error = (const struct sock_extended_err *) CMSG_DATA(header);
+            if(error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            uint32_t low = error->ee_info;
+            uint32_t high = error->ee_data;
+            bool copiedanyway = (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            for(std::deque<inflight>::iterator it = this->queue.begin(); it != this->queue.end();)
+            {
+                if(it->id - low <= high - low) //Inclusive range that may wrap around
+                {
+                    if(copiedanyway) this->copied.add(it->bytes);
+                    else this->zerocopied.add(it->bytes);
+                    it = this->queue.erase(it); //Done with the pages, the frame may go back to its pool
+                }
+                else ++it;
+            }
+        }
+    }
+#else
+    (void) fd;
+#endif
+    return !this->queue.empty();
+}
+
+void MjpgZeroCopy::pinned(std::vector<MjpgFramePtr> &frames) const
+{
+    for(std::deque<inflight>::const_iterator it = this->queue.begin(); it != this->queue.end(); ++it)
+        frames.push_back(it->keep->frame);
+}
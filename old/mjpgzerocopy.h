@@ -0,0 +1,124 @@
+/**
+    CS-11 Format
+    File: mjpgzerocopy.h
+    Purpose: MSG_ZEROCOPY sends of shared frames with completions read from the error queue
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGZEROCOPY_H_
+#define MJPGZEROCOPY_H_
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "mjpgframe.h"
+#include "mjpgmetrics.h"
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define MJPGZEROCOPY_SUPPORTED 1
+#endif
+
+//! A frame plus its own copy of a client's send stamp
+/*!
+The kernel reads zerocopy sends straight out of these pages until it
+signals completion, so everything handed to it has to stay put until
+then, even the few stamp bytes the session would otherwise overwrite
+with the next frame's
+*/
+struct MjpgZeroCopyFrame
+{
+    MjpgFramePtr frame;
+    char stamp[48];
+    size_t stamplength = 0;
+};
+
+//! MSG_ZEROCOPY sends on one socket and the buffers they pin
+/*!
+Every successful zerocopy send gets the next id of the socket. The
+kernel later reports ranges of finished ids on the socket's error queue,
+only then is what the send pinned let go of, which for an encoded frame
+means it can go back to its pool. A socket closed before that keeps
+sending what it queued, its owner takes the pinned() frames out of the
+pool first. A completion also says whether the
+kernel ended up copying anyway (loopback always does), the bytes are
+counted as zerocopy or copied accordingly. Used from one event loop only
+*/
+class MjpgZeroCopy
+{
+public:
+    //! Track the sends of a socket
+    /*!
+    @param zerocopied bytes the kernel sent without copying
+    @param copied bytes the kernel copied after all
+    */
+    MjpgZeroCopy(MjpgCounter &, MjpgCounter &);
+
+    //! Turn on SO_ZEROCOPY for a socket
+    /*!
+    @param fd the connected socket
+    @return false when the kernel or the build doesn't support it
+    */
+    static bool enable(int);
+
+    //! Send without blocking
+    /*!
+    @param fd the socket
+    @param parts the gather list
+    @param count entries in parts
+    @param keep held until the kernel is done with this send
+    @return bytes sent or -1 with errno set (EAGAIN when the socket is full)
+    */
+    long send(int, const struct iovec *, int, std::shared_ptr<const MjpgZeroCopyFrame>);
+
+    //! Read every completion waiting on the error queue and release what it finished
+    /*!
+    @param fd the socket
+    @return true while sends are still waiting for completion
+    */
+    bool reap(int);
+
+    //!Sends still waiting for completion
+    size_t pending(void) const { return this->queue.size(); }
+
+    //! Get the frames of the sends still waiting for completion
+    /*!
+    Closing the socket doesn't stop the kernel from reading them, whatever
+    is already queued still goes out
+
+    @param frames gets every frame the kernel may still read from
+    */
+    void pinned(std::vector<MjpgFramePtr> &) const;
+
+private:
+    struct inflight
+    {
+        uint32_t id;
+        size_t bytes;
+        std::shared_ptr<const MjpgZeroCopyFrame> keep;
+    };
+
+    std::deque<inflight> queue;
+    uint32_t next = 0;
+    MjpgCounter &zerocopied;
+    MjpgCounter &copied;
+};
+
+#endif  // MJPGZEROCOPY_H_
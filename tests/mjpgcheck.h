@@ -0,0 +1,39 @@
+/**
+    CS-11 Format
+    File: mjpgcheck.h
+    Purpose: Minimal checks shared by the unit tests, a failed one is reported and fails the test
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef MJPGCHECK_H_
+#define MJPGCHECK_H_
+
+#pragma once
+
+#include <iostream>
+
+//!Checks that failed so far, the test's exit code
+static int mjpgfailures = 0;
+
+//!Report a condition that doesn't hold and keep going
+#define MJPGCHECK(condition) \
+    do { if(!(condition)) { std::cerr << __FILE__ << ":" << __LINE__ << ": failed " << #condition << std::endl; mjpgfailures++; } } while(0)
+
+//!Run a test case and name it when it failed
+#define MJPGRUN(test) \
+    do { int before = mjpgfailures; test(); std::cout << (mjpgfailures == before ? "ok   " : "FAIL ") << #test << std::endl; } while(0)
+
+#endif  // MJPGCHECK_H_
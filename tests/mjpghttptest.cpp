@@ -0,0 +1,132 @@
+/**
+    CS-11 Format
+    File: mjpghttptest.cpp
+    Purpose: Unit tests of the incremental request parser (pipelining, partial reads and size limits)
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string>
+#include <cstring>
+#include "mjpghttp.h"
+#include "mjpgcheck.h"
+
+//! Read bytes into the parser the way a connection does
+static MjpgHttpParser::result feed(MjpgHttpParser &parser, const std::string &bytes)
+{
+    boost::asio::mutable_buffer free = parser.prepare();
+    size_t length = bytes.size() < boost::asio::buffer_size(free) ? bytes.size() : boost::asio::buffer_size(free);
+    std::memcpy(boost::asio::buffer_cast<void *>(free), bytes.data(), length);
+    return parser.commit(length);
+}
+
+static void simpleRequest()
+{
+    MjpgHttpParser parser(1024);
+    MJPGCHECK(feed(parser, "GET /cam/side/jpg?w=320&h=240 HTTP/1.1\r\nHost: x\r\nIf-None-Match: \"a\"\r\n\r\n") == MjpgHttpParser::complete);
+    const MjpgHttpRequest &request = parser.request();
+    MJPGCHECK(request.method == "GET");
+    MJPGCHECK(request.path == "/cam/side/jpg");
+    MJPGCHECK(request.query == "w=320&h=240");
+    MJPGCHECK(request.header("host") == "x");
+    MJPGCHECK(request.header("IF-NONE-MATCH") == "\"a\"");
+    MJPGCHECK(request.header("Missing").empty());
+    MJPGCHECK(request.keepalive);
+
+    MjpgHttpParser bare(1024);
+    MJPGCHECK(feed(bare, "GET / HTTP/1.0\r\n\r\n") == MjpgHttpParser::complete); //No headers at all
+    MJPGCHECK(bare.request().version == "HTTP/1.0");
+    MJPGCHECK(bare.request().headercount == 0);
+}
+
+static void partialRequest()
+{
+    MjpgHttpParser parser(1024);
+    std::string whole = "POST /fps HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello";
+    //Every split, including one inside the blank line, has to wait for the rest
+    for(size_t split = 1; split < whole.size(); split++)
+    {
+        parser.consume();
+        MJPGCHECK(feed(parser, whole.substr(0, split)) == MjpgHttpParser::incomplete);
+        MJPGCHECK(feed(parser, whole.substr(split)) == MjpgHttpParser::complete);
+        MJPGCHECK(parser.request().body == "hello");
+        MJPGCHECK(!parser.request().keepalive);
+    }
+    parser.consume();
+    for(size_t i = 0; i + 1 < whole.size(); i++) MJPGCHECK(feed(parser, whole.substr(i, 1)) == MjpgHttpParser::incomplete);
+    MJPGCHECK(feed(parser, whole.substr(whole.size() - 1)) == MjpgHttpParser::complete);
+}
+
+static void pipelinedRequests()
+{
+    MjpgHttpParser parser(1024);
+    MJPGCHECK(feed(parser, "GET /a HTTP/1.1\r\nHost: x\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 2\r\n\r\nokGET /c HTTP/1.0\r\n") == MjpgHttpParser::complete);
+    MJPGCHECK(parser.request().path == "/a");
+    MJPGCHECK(parser.remaining().starts_with("POST /b"));
+    parser.consume();
+    MJPGCHECK(parser.parse() == MjpgHttpParser::complete);
+    MJPGCHECK(parser.request().path == "/b");
+    MJPGCHECK(parser.request().body == "ok");
+    parser.consume();
+    MJPGCHECK(parser.parse() == MjpgHttpParser::incomplete);
+    MJPGCHECK(feed(parser, "\r\n") == MjpgHttpParser::complete);
+    MJPGCHECK(parser.request().path == "/c");
+    MJPGCHECK(!parser.request().keepalive); //HTTP/1.0 without keep-alive
+}
+
+static void badRequests() //Answered with 400
+{
+    const char *bad[] = {
+        "GET\r\n\r\n",
+        "GET / FTP/1.0\r\n\r\n",
+        "GET / HTTP/1.1\r\nNo colon here\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: x\r\n folded: header\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+    };
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        MjpgHttpParser parser(1024);
+        MJPGCHECK(feed(parser, bad[i]) == MjpgHttpParser::invalid);
+    }
+    std::string many = "GET / HTTP/1.1\r\n";
+    for(int i = 0; i <= MJPGHTTP_MAXHEADERS; i++) many += "X-Header: 1\r\n";
+    MjpgHttpParser parser(4096);
+    MJPGCHECK(feed(parser, many + "\r\n") == MjpgHttpParser::invalid);
+}
+
+static void oversizedRequests()
+{
+    MjpgHttpParser headers(256); //Answered with 431
+    MJPGCHECK(feed(headers, "GET / HTTP/1.1\r\nCookie: " + std::string(200, 'c')) == MjpgHttpParser::incomplete);
+    MJPGCHECK(feed(headers, std::string(100, 'c')) == MjpgHttpParser::toolarge);
+
+    MjpgHttpParser body(256); //Answered with 413
+    MJPGCHECK(feed(body, "POST / HTTP/1.1\r\nContent-Length: 250\r\n\r\n") == MjpgHttpParser::bodytoolarge);
+    MjpgHttpParser huge(256);
+    MJPGCHECK(feed(huge, "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n") == MjpgHttpParser::bodytoolarge);
+    MjpgHttpParser fits(256);
+    MJPGCHECK(feed(fits, "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\n0123456789") == MjpgHttpParser::complete);
+}
+
+int main()
+{
+    MJPGRUN(simpleRequest);
+    MJPGRUN(partialRequest);
+    MJPGRUN(pipelinedRequests);
+    MJPGRUN(badRequests);
+    MJPGRUN(oversizedRequests);
+    return mjpgfailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/**
+    CS-11 Format
+    File: mjpgmetricstest.cpp
+    Purpose: Unit tests of the histogram buckets and their Prometheus rendering
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string>
+#include "mjpgmetrics.h"
+#include "mjpgcheck.h"
+
+static void bucketEdges()
+{
+    for(uint64_t value = 0; value < 100000; value++)
+    {
+        int index = MjpgHistogram::bucket(value);
+        MJPGCHECK(MjpgHistogram::upper(index) >= value);
+        if(index > 0) MJPGCHECK(MjpgHistogram::upper(index - 1) < value);
+    }
+}
+
+static void inclusiveBounds()
+{
+    for(int power = 0; power < 40; power++)
+    {
+        uint64_t bound = (uint64_t) 1 << power;
+        MjpgHistogram histogram;
+        histogram.record(bound); //Prometheus counts a value on the edge toward that le
+        MJPGCHECK(histogram.atmost(bound) == 1);
+        MJPGCHECK(histogram.atmost(bound - 1) == 0);
+        histogram.record(bound + 1);
+        MJPGCHECK(histogram.atmost(bound) == 1);
+    }
+}
+
+static void renderedBuckets()
+{
+    MjpgMetrics metrics;
+    MjpgHistogram &sizes = metrics.histogram("sizes_bytes", "Sizes", 1.0, 0, 4);
+    sizes.record(4);
+    sizes.record(5);
+    std::string text = metrics.render();
+    MJPGCHECK(text.find("sizes_bytes_bucket{le=\"2\"} 0\n") != std::string::npos);
+    MJPGCHECK(text.find("sizes_bytes_bucket{le=\"4\"} 1\n") != std::string::npos);
+    MJPGCHECK(text.find("sizes_bytes_bucket{le=\"8\"} 2\n") != std::string::npos);
+    MJPGCHECK(text.find("sizes_bytes_bucket{le=\"+Inf\"} 2\n") != std::string::npos);
+}
+
+static void escapedLabels()
+{
+    MJPGCHECK(MjpgMetrics::label("source", "cam") == "source=\"cam\"");
+    MJPGCHECK(MjpgMetrics::label("source", "a\\b\"c\nd") == "source=\"a\\\\b\\\"c\\nd\"");
+}
+
+int main()
+{
+    MJPGRUN(bucketEdges);
+    MJPGRUN(inclusiveBounds);
+    MJPGRUN(renderedBuckets);
+    MJPGRUN(escapedLabels);
+    return mjpgfailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/**
+    CS-11 Format
+    File: mjpgrelaytest.cpp
+    Purpose: Unit tests of splitting jpegs out of buffers and multipart streams (truncated parts and embedded thumbnails)
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string>
+#include <vector>
+#include <cstring>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "mjpgrelay.h"
+#include "mjpgcheck.h"
+
+typedef std::vector<unsigned char> bytes;
+
+static void segment(bytes &out, unsigned char type, const bytes &payload)
+{
+    out.push_back(0xFF);
+    out.push_back(type);
+    out.push_back((unsigned char) ((payload.size() + 2) >> 8));
+    out.push_back((unsigned char) (payload.size() + 2));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+//! Build a structurally valid baseline jpeg, optionally with an exif thumbnail (a whole jpeg) in an APP1 segment
+static bytes jpeg(int width, int height, bool thumbnail, unsigned char fill = 0x12)
+{
+    bytes out = {0xFF, 0xD8};
+    if(thumbnail)
+    {
+        bytes exif = {'E', 'x', 'i', 'f', 0, 0};
+        bytes small = jpeg(16, 8, false, 0x77);
+        exif.insert(exif.end(), small.begin(), small.end());
+        segment(out, 0xE1, exif);
+    }
+    bytes table(65, 1);
+    table[0] = 0;
+    segment(out, 0xDB, table);
+    bytes frame = {8, (unsigned char) (height >> 8), (unsigned char) height, (unsigned char) (width >> 8), (unsigned char) width, 1, 1, 0x11, 0};
+    segment(out, 0xC0, frame);
+    bytes scan = {1, 1, 0x00, 0, 63, 0};
+    segment(out, 0xDA, scan);
+    //Entropy coded data with a stuffed zero, a restart marker and a fill byte
+    bytes entropy = {fill, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56, 0xFF, 0xFF, 0x00, fill};
+    out.insert(out.end(), entropy.begin(), entropy.end());
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+    return out;
+}
+
+static void findsWholeJpeg()
+{
+    bytes image = jpeg(640, 480, false);
+    size_t start = 1, end = 0;
+    MJPGCHECK(MjpgRelay::find(image.data(), image.size(), start, end));
+    MJPGCHECK(start == 0 && end == image.size());
+    int width = 0, height = 0;
+    MJPGCHECK(MjpgRelay::dimensions(image.data(), image.size(), width, height));
+    MJPGCHECK(width == 640 && height == 480);
+
+    bytes two = image;
+    bytes second = jpeg(320, 240, false);
+    two.insert(two.end(), second.begin(), second.end());
+    MJPGCHECK(MjpgRelay::find(two.data(), two.size(), start, end));
+    MJPGCHECK(start == 0 && end == image.size()); //Only the first one
+}
+
+static void skipsEmbeddedThumbnail()
+{
+    bytes image = jpeg(1920, 1080, true);
+    size_t start = 0, end = 0;
+    MJPGCHECK(MjpgRelay::find(image.data(), image.size(), start, end));
+    MJPGCHECK(start == 0 && end == image.size()); //Not the end of the thumbnail
+    int width = 0, height = 0;
+    MJPGCHECK(MjpgRelay::dimensions(image.data(), image.size(), width, height));
+    MJPGCHECK(width == 1920 && height == 1080);
+}
+
+static void skipsGarbage()
+{
+    const char boundary[] = "--frame\r\nContent-Type: image/jpeg\r\n\r\n";
+    bytes data(boundary, boundary + sizeof(boundary) - 1);
+    bytes fake = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x01, 0xFF}; //A start of image with a broken segment
+    data.insert(data.end(), fake.begin(), fake.end());
+    size_t offset = data.size();
+    bytes image = jpeg(64, 48, true);
+    data.insert(data.end(), image.begin(), image.end());
+    size_t start = 0, end = 0;
+    MJPGCHECK(MjpgRelay::find(data.data(), data.size(), start, end));
+    MJPGCHECK(start == offset && end == offset + image.size());
+}
+
+static void rejectsTruncated()
+{
+    bytes image = jpeg(640, 480, true);
+    for(size_t length = 0; length < image.size(); length++)
+    {
+        size_t start = 0, end = 0;
+        bool found = MjpgRelay::find(image.data(), length, start, end);
+        MJPGCHECK(!found);
+        if(found) std::cerr << "  complete after only " << length << " of " << image.size() << " bytes" << std::endl;
+    }
+}
+
+//! A one connection multipart upstream that sends its parts in two bursts
+struct upstream
+{
+    int listener = -1;
+    int port = 0;
+    bytes first;
+    bytes second;
+    boost::mutex mutex;
+    boost::condition_variable resumed;
+    bool go = false;
+
+    upstream()
+    {
+        this->listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(this->listener, (sockaddr *) &address, sizeof(address));
+        listen(this->listener, 1);
+        getsockname(this->listener, (sockaddr *) &address, &length);
+        this->port = ntohs(address.sin_port);
+    }
+
+    ~upstream() { close(this->listener); }
+
+    void resume()
+    {
+        boost::mutex::scoped_lock l(this->mutex);
+        this->go = true;
+        this->resumed.notify_all();
+    }
+
+    void serve()
+    {
+        int client = accept(this->listener, nullptr, nullptr);
+        if(client < 0) return;
+        char request[4096];
+        std::string received;
+        while(received.find("\r\n\r\n") == std::string::npos)
+        {
+            ssize_t got = recv(client, request, sizeof(request), 0);
+            if(got <= 0) break;
+            received.append(request, got);
+        }
+        send(client, this->first.data(), this->first.size(), MSG_NOSIGNAL);
+        {
+            boost::mutex::scoped_lock l(this->mutex);
+            while(!this->go) this->resumed.wait(l);
+        }
+        send(client, this->second.data(), this->second.size(), MSG_NOSIGNAL);
+        close(client); //Ends in the middle of a part
+    }
+};
+
+static void append(bytes &out, const std::string &text)
+{
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+static void part(bytes &out, const bytes &image, long declared)
+{
+    append(out, "--b\r\nContent-Type: image/jpeg\r\n");
+    if(declared >= 0) append(out, "Content-Length: " + std::to_string(declared) + "\r\n");
+    append(out, "\r\n");
+    out.insert(out.end(), image.begin(), image.end());
+    append(out, "\r\n");
+}
+
+static void relaysMultipartParts()
+{
+    bytes thumbnailed = jpeg(320, 240, true, 0x21);
+    bytes declared = jpeg(320, 240, false, 0x22);
+    bytes lying = jpeg(320, 240, true, 0x23);
+    bytes truncated = jpeg(320, 240, true, 0x24);
+
+    upstream server;
+    append(server.first, "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=b\r\n\r\n");
+    part(server.first, thumbnailed, -1); //Walked to its end, not the thumbnail's
+    part(server.second, declared, declared.size());
+    part(server.second, lying, 20); //A wrong length falls back to walking the jpeg
+    bytes cut(truncated.begin(), truncated.begin() + truncated.size() / 2);
+    part(server.second, cut, truncated.size());
+    boost::thread serving(boost::bind(&upstream::serve, &server));
+
+    MjpgRelay relay("http://127.0.0.1:" + std::to_string(server.port) + "/mjpg");
+    relay.setTimeout(2000);
+    bytes got;
+    MJPGCHECK(relay.next(got));
+    MJPGCHECK(got == thumbnailed);
+    server.resume();
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(100)); //Everything is buffered before the next read
+    MJPGCHECK(relay.next(got));
+    MJPGCHECK(got == lying); //The newest whole part, the one before it is skipped
+    MJPGCHECK(!relay.next(got)); //Only half a part is left before the upstream hung up
+    serving.join();
+}
+
+int main()
+{
+    MJPGRUN(findsWholeJpeg);
+    MJPGRUN(skipsEmbeddedThumbnail);
+    MJPGRUN(skipsGarbage);
+    MJPGRUN(rejectsTruncated);
+    MJPGRUN(relaysMultipartParts);
+    return mjpgfailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+/**
+    CS-11 Format
+    File: mjpgservertest.cpp
+    Purpose: Unit tests of the renditions sources encode their default stream in
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string>
+#include "mjpgserver.h"
+#include "mjpgcheck.h"
+
+//! Reads the servers' private sources, befriended by MjpgServer
+class MjpgServerTest
+{
+public:
+    static MjpgRendition rendition(MjpgServer &server, const std::string &name)
+    {
+        MjpgServer::source_ptr cam = server.findSource(name);
+        return cam ? cam->rendition() : MjpgRendition();
+    }
+};
+
+static void defaultStrips()
+{
+    MjpgServer server(0); //Nothing is bound before run()
+    MJPGCHECK(MjpgServerTest::rendition(server, "default").strips == -1);
+    server.setStrips(4);
+    MJPGCHECK(MjpgServerTest::rendition(server, "default").strips == 4);
+    server.setQuality(70);
+    server.setResolution(640, 360);
+    MjpgRendition rendition = MjpgServerTest::rendition(server, "default");
+    MJPGCHECK(rendition.strips == 4 && rendition.quality == 70 && rendition.width == 640 && rendition.height == 360);
+}
+
+static void sourceStrips()
+{
+    MjpgServer server(0);
+    server.addPushSource("side");
+    server.setStrips(4);
+    MJPGCHECK(MjpgServerTest::rendition(server, "side").strips == -1); //The server's settings are the default source's
+    server.setSourceStrips("side", 3);
+    MJPGCHECK(MjpgServerTest::rendition(server, "side").strips == 3);
+    MJPGCHECK(MjpgServerTest::rendition(server, "default").strips == 4);
+}
+
+int main()
+{
+    MJPGRUN(defaultStrips);
+    MJPGRUN(sourceStrips);
+    return mjpgfailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/**
+    CS-11 Format
+    File: mjpgwebsockettest.cpp
+    Purpose: Unit tests of the WebSocket handshake and client frame reader (masking, sizes and control frames)
+
+    License: MIT License (MIT)
+    Copyright (c) 2026 The Titan MjpegServer contributors
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string>
+#include "mjpgwebsocket.h"
+#include "mjpgcheck.h"
+
+//! Build a client frame, masked unless told otherwise
+static std::string frame(int opcode, const std::string &payload, bool final = true, bool masked = true)
+{
+    std::string out(1, (char) ((final ? 0x80 : 0) | opcode));
+    size_t length = payload.size();
+    unsigned char flag = masked ? 0x80 : 0;
+    if(length < 126) out += (char) (flag | length);
+    else if(length <= 0xFFFF)
+    {
+        out += (char) (flag | 126);
+        out += (char) (length >> 8);
+        out += (char) length;
+    }
+    else
+    {
+        out += (char) (flag | 127);
+        for(int i = 0; i < 8; i++) out += (char) ((uint64_t) length >> (56 - i * 8));
+    }
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    if(masked) out.append(mask, 4);
+    for(size_t i = 0; i < length; i++) out += masked ? (char) (payload[i] ^ mask[i % 4]) : payload[i];
+    return out;
+}
+
+static bool append(MjpgWebSocket &reader, const std::string &bytes)
+{
+    return reader.append(bytes.data(), bytes.size());
+}
+
+static void acceptKey()
+{
+    //The example handshake of RFC 6455 section 1.3
+    MJPGCHECK(MjpgWebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+static void serverHeaders()
+{
+    unsigned char head[10];
+    MJPGCHECK(MjpgWebSocket::header(head, MjpgWebSocket::BINARY, 125) == 2 && head[0] == 0x82 && head[1] == 125);
+    MJPGCHECK(MjpgWebSocket::header(head, MjpgWebSocket::BINARY, 126) == 4 && head[1] == 126 && head[2] == 0 && head[3] == 126);
+    MJPGCHECK(MjpgWebSocket::header(head, MjpgWebSocket::BINARY, 70000) == 10 && head[1] == 127 && head[7] == 0x01 && head[8] == 0x11 && head[9] == 0x70);
+    std::string close = MjpgWebSocket::control(MjpgWebSocket::CLOSE, std::string(200, 'x'));
+    MJPGCHECK(close.size() == 2 + 125); //Control payloads are cut to what the protocol allows
+}
+
+static void maskedMessages()
+{
+    MjpgWebSocket reader;
+    MjpgWebSocket::message message;
+    std::string both = frame(MjpgWebSocket::TEXT, "ack") + frame(MjpgWebSocket::BINARY, std::string(300, 'b'));
+    //Byte by byte nothing comes out before a frame is whole
+    for(size_t i = 0; i < both.size(); i++)
+    {
+        MJPGCHECK(append(reader, both.substr(i, 1)));
+        MjpgWebSocket::result read = reader.next(message);
+        if(i + 1 == both.size() - frame(MjpgWebSocket::BINARY, std::string(300, 'b')).size())
+        {
+            MJPGCHECK(read == MjpgWebSocket::complete);
+            MJPGCHECK(message.opcode == MjpgWebSocket::TEXT && message.payload == "ack");
+        }
+        else if(i + 1 == both.size())
+        {
+            MJPGCHECK(read == MjpgWebSocket::complete);
+            MJPGCHECK(message.opcode == MjpgWebSocket::BINARY && message.payload == std::string(300, 'b'));
+        }
+        else MJPGCHECK(read == MjpgWebSocket::incomplete);
+    }
+
+    MjpgWebSocket unmasked;
+    MJPGCHECK(append(unmasked, frame(MjpgWebSocket::TEXT, "ack", true, false)));
+    MJPGCHECK(unmasked.next(message) == MjpgWebSocket::invalid); //Clients have to mask
+
+    MjpgWebSocket extended;
+    std::string reserved = frame(MjpgWebSocket::TEXT, "ack");
+    reserved[0] = (char) (reserved[0] | 0x40);
+    MJPGCHECK(append(extended, reserved));
+    MJPGCHECK(extended.next(message) == MjpgWebSocket::invalid); //No extension was agreed on
+}
+
+static void oversizedMessages()
+{
+    MjpgWebSocket reader(64);
+    MjpgWebSocket::message message;
+    MJPGCHECK(!append(reader, frame(MjpgWebSocket::BINARY, std::string(100, 'x')))); //More than one allowed frame
+
+    MjpgWebSocket declared(64);
+    std::string big = frame(MjpgWebSocket::BINARY, std::string(70000, 'x'));
+    MJPGCHECK(append(declared, big.substr(0, 14)));
+    MJPGCHECK(declared.next(message) == MjpgWebSocket::invalid); //Known to be too big from the header alone
+
+    MjpgWebSocket fragments(64);
+    MJPGCHECK(append(fragments, frame(MjpgWebSocket::BINARY, std::string(40, 'x'), false)));
+    MJPGCHECK(fragments.next(message) == MjpgWebSocket::incomplete);
+    MJPGCHECK(append(fragments, frame(MjpgWebSocket::CONTINUATION, std::string(40, 'x'))));
+    MJPGCHECK(fragments.next(message) == MjpgWebSocket::invalid); //Together they're too big
+}
+
+static void controlFrames()
+{
+    MjpgWebSocket reader;
+    MjpgWebSocket::message message;
+    //A ping in the middle of a fragmented message comes out on its own, before the message
+    MJPGCHECK(append(reader, frame(MjpgWebSocket::TEXT, "ac", false) + frame(MjpgWebSocket::PING, "hi") +
+                             frame(MjpgWebSocket::CONTINUATION, "k") + frame(MjpgWebSocket::CLOSE, "\x03\xE8")));
+    MJPGCHECK(reader.next(message) == MjpgWebSocket::complete);
+    MJPGCHECK(message.opcode == MjpgWebSocket::PING && message.payload == "hi");
+    MJPGCHECK(reader.next(message) == MjpgWebSocket::complete);
+    MJPGCHECK(message.opcode == MjpgWebSocket::TEXT && message.payload == "ack");
+    MJPGCHECK(reader.next(message) == MjpgWebSocket::complete);
+    MJPGCHECK(message.opcode == MjpgWebSocket::CLOSE && message.payload == "\x03\xE8");
+    MJPGCHECK(reader.next(message) == MjpgWebSocket::incomplete);
+
+    MjpgWebSocket fragmented;
+    MJPGCHECK(append(fragmented, frame(MjpgWebSocket::PING, "hi", false)));
+    MJPGCHECK(fragmented.next(message) == MjpgWebSocket::invalid); //Control frames can't be split
+
+    MjpgWebSocket toolong;
+    MJPGCHECK(append(toolong, frame(MjpgWebSocket::PING, std::string(126, 'p'))));
+    MJPGCHECK(toolong.next(message) == MjpgWebSocket::invalid); //Nor be longer than 125 bytes
+
+    MjpgWebSocket stray;
+    MJPGCHECK(append(stray, frame(MjpgWebSocket::CONTINUATION, "k")));
+    MJPGCHECK(stray.next(message) == MjpgWebSocket::invalid); //Nothing to continue
+
+    MjpgWebSocket unknown;
+    MJPGCHECK(append(unknown, frame(0x3, "?")));
+    MJPGCHECK(unknown.next(message) == MjpgWebSocket::invalid);
+}
+
+int main()
+{
+    MJPGRUN(acceptKey);
+    MJPGRUN(serverHeaders);
+    MJPGRUN(maskedMessages);
+    MJPGRUN(oversizedMessages);
+    MJPGRUN(controlFrames);
+    return mjpgfailures == 0 ? 0 : 1;
+}